@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <radical/vignetting_model.h>
+
+namespace radical {
+
+/** Model of vignetting response as a tensor-product uniform cubic B-spline.
+  *
+  * Vignetting response of each color channel is a smooth surface defined by a coarse grid of control points:
+  * \f[
+  *     V(x, y) = \sum_{j=0}^{3}\sum_{i=0}^{3} B_j(t_y) B_i(t_x) P_{k_y + j, k_x + i},
+  * \f]
+  *
+  * where B are the cubic B-spline basis functions, and (k, t) are the segment and the position within the segment that
+  * contain the pixel. The knots are uniformly spaced so that an image with a grid of M control points along a dimension
+  * is split into M - 3 segments. Unlike the polynomial and radial models, this model does not assume any symmetry and
+  * is able to represent shading caused by tilted sensors or off-axis lenses.
+  *
+  * Model coefficients are the control points (CV_32FC3, at least 4x4, each channel has its own control points). */
+class BSplineVignettingModel : public VignettingModel {
+ public:
+  using Ptr = std::shared_ptr<BSplineVignettingModel>;
+
+  BSplineVignettingModel(cv::InputArray coefficients, cv::Size image_size);
+
+  BSplineVignettingModel(const std::string& filename);
+
+  /** Fit the model to a dense map of attenuation factors in the least-squares sense.
+    * The surface is separable, so the fit amounts to two small linear solves, one along each dimension. This smooths
+    * out noise of the calibration data.
+    * \param[in] response dense vignetting response (CV_32FC3)
+    * \param[in] grid_size number of control points along each dimension (at least 4x4) */
+  static Ptr fromDense(cv::InputArray response, cv::Size grid_size);
+
+  /** Read the model from a file stream positioned after the header (\sa VignettingModel::Reader). */
+  static VignettingModel::Ptr read(const std::string& filename, std::ifstream& file, const std::string& header);
+
+  virtual std::string getName() const override;
+
+  virtual void save(const std::string& filename) const override;
+
+  virtual cv::Vec3f operator()(const cv::Vec2f& p) const override;
+
+  using VignettingModel::operator();
+
+  virtual cv::Size getImageSize() const override;
+
+  virtual bool supportsRowEvaluation() const override {
+    return true;
+  }
+
+  /** Evaluate the model along a row of an image.
+    * Control points are first combined vertically, which only needs to be done once per horizontal segment. */
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const override;
+
+  /** Evaluate the model on a region of the pixel grid of an image.
+    * Evaluation is separable: rows of control points are first evaluated horizontally at every column of the region,
+    * and then image rows are blended from four of these with contiguous, vectorizable loops. */
+  virtual void evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray response) const override;
+
+  using VignettingModel::evaluateGrid;
+
+  virtual cv::Mat getModelCoefficients() const override;
+
+ private:
+  /** Validate coefficients and compute members derived from them. */
+  void setCoefficients(cv::InputArray coefficients, cv::Size image_size);
+
+  cv::Mat coefficients_;
+  cv::Size image_size_;
+  cv::Vec2f knot_scale_;  ///< factor that maps pixel coordinates to spline parameter along x and y
+};
+
+}  // namespace radical
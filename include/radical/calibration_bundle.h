@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <radical/radiometric_response.h>
+#include <radical/vignetting_model.h>
+
+namespace radical {
+
+/** Single-file container for the photometric calibration of a camera.
+  *
+  * The bundle consists of named sections, each holding either a cv::Mat or a string. Radiometric response, vignetting
+  * model (type, coefficients, and image size), and metadata (camera UID, resolution) are stored in sections with
+  * predefined names, arbitrary other sections may be added by the user.
+  *
+  * File layout (all integers are little-endian regardless of the host):
+  *   - 64-byte file header: magic "RADCALIB", format version, number of sections, CRC-32 of the section table;
+  *   - section table with a 64-byte entry per section: name (up to 31 characters), cv::Mat type (-1 for strings),
+  *     rows, cols, CRC-32 of the payload, payload offset and size;
+  *   - payloads, each starting at a multiple of \c ALIGNMENT bytes.
+  *
+  * Matrix elements are stored little-endian as well. Loaded bundles are memory-mapped, and on little-endian hosts the
+  * matrices point directly into the mapping (\sa mapMat()), so their data is aligned for SIMD loads. Checksums of all
+  * sections are verified when the bundle is loaded. */
+class CalibrationBundle {
+ public:
+  using Ptr = std::shared_ptr<CalibrationBundle>;
+
+  /// Version of the file format written by save(). Files with a newer version are rejected.
+  static const uint32_t VERSION = 1;
+
+  /// Alignment (in bytes) of section payloads in the file.
+  static const size_t ALIGNMENT = 64;
+
+  /// Maximum length of section names.
+  static const size_t MAX_NAME_LENGTH = 31;
+
+  /** Create an empty bundle. */
+  CalibrationBundle();
+
+  /** Load a bundle from a file.
+    * SerializationException is thrown if the file is not a valid bundle, was written by a newer version of the
+    * library, or if any of the checksums does not match. */
+  explicit CalibrationBundle(const std::string& filename);
+
+  /** Write the bundle to a file. */
+  void save(const std::string& filename) const;
+
+  /** Check whether the bundle has a section with a given name. */
+  bool has(const std::string& name) const;
+
+  /** Get names of all sections (in lexicographical order). */
+  std::vector<std::string> getSectionNames() const;
+
+  /** Store a matrix in a section with a given name, replacing existing contents.
+    * The matrix should not be empty and have at most 2 dimensions. Its data is shared, not copied (unless it is not
+    * continuous). */
+  void setMat(const std::string& name, cv::InputArray mat);
+
+  /** Get the matrix stored in a section with a given name.
+    * The returned matrix shares data with the bundle. Exception is thrown if there is no such section or it does not
+    * hold a matrix. */
+  cv::Mat getMat(const std::string& name) const;
+
+  /** Store a string in a section with a given name, replacing existing contents. */
+  void setString(const std::string& name, const std::string& value);
+
+  /** Get the string stored in a section with a given name.
+    * Exception is thrown if there is no such section or it does not hold a string. */
+  std::string getString(const std::string& name) const;
+
+  /** Remove a section with a given name (if present). */
+  void remove(const std::string& name);
+
+  /** Set unique identifier of the calibrated camera (e.g. serial number). */
+  void setCameraUID(const std::string& uid);
+
+  /** Get unique identifier of the calibrated camera, empty if not set. */
+  std::string getCameraUID() const;
+
+  /** Set resolution of the calibrated camera. */
+  void setResolution(cv::Size resolution);
+
+  /** Get resolution of the calibrated camera, empty if not set. */
+  cv::Size getResolution() const;
+
+  /** Store radiometric response (its inverse CRF). */
+  void setRadiometricResponse(const RadiometricResponse& response);
+
+  /** Create radiometric response from the stored inverse CRF, \c nullptr if the bundle does not have one.
+    * \param[in] forward_table_size \sa RadiometricResponse::RadiometricResponse() */
+  RadiometricResponse::Ptr getRadiometricResponse(
+      unsigned int forward_table_size = RadiometricResponse::DEFAULT_FORWARD_TABLE_SIZE) const;
+
+  /** Store vignetting model (its type, coefficients, and image size). */
+  void setVignettingModel(const VignettingModel& model);
+
+  /** Create vignetting model from the stored coefficients, \c nullptr if the bundle does not have one.
+    * Exception is thrown if the model type is not supported. */
+  VignettingModel::Ptr getVignettingModel() const;
+
+ private:
+  struct Section {
+    int type;          ///< cv::Mat type, or -1 for strings
+    cv::Mat mat;       ///< contents of matrix sections
+    std::string text;  ///< contents of string sections
+  };
+
+  const Section& find(const std::string& name) const;
+
+  /** Store a size in a section with a given name (as a 1x2 CV_32SC1 matrix). */
+  void setSize(const std::string& name, cv::Size size);
+
+  /** Get the size stored in a section with a given name. */
+  cv::Size getSize(const std::string& name) const;
+
+  std::map<std::string, Section> sections_;
+};
+
+}  // namespace radical
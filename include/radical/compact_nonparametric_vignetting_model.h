@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <radical/vignetting_model.h>
+
+namespace radical {
+
+/** Nonparametric model of vignetting response stored on a coarse grid.
+  *
+  * Vignetting is smooth, so instead of storing the attenuation factors of every pixel (\sa
+  * NonparametricVignettingModel) they are stored at the nodes of a regular grid and bilinearly interpolated in between.
+  * The grid spans the image, i.e. its first and last nodes are at the first and last pixels of each row and column. A
+  * grid with stride 8 is 64 times smaller than the dense model. */
+class CompactNonparametricVignettingModel : public VignettingModel {
+ public:
+  using Ptr = std::shared_ptr<CompactNonparametricVignettingModel>;
+
+  /** Construct the model from grid coefficients.
+    * \param[in] coefficients attenuation factors at grid nodes (CV_32FC3, at least 2x2)
+    * \param[in] image_size image size for which the model is valid */
+  CompactNonparametricVignettingModel(cv::InputArray coefficients, cv::Size image_size);
+
+  /** Load the model from a file. */
+  CompactNonparametricVignettingModel(const std::string& filename);
+
+  /** Create the model by downsampling a dense map of attenuation factors.
+    * The grid has spacing of at most \a stride pixels, and its coefficients are fitted to the map in the least-squares
+    * sense, i.e. the interpolated grid is as close to the map as possible.
+    * \param[in] response dense vignetting response (CV_32FC3, at least 2x2)
+    * \param[in] stride maximum distance between grid nodes (in pixels) */
+  static Ptr fromDense(cv::InputArray response, unsigned int stride);
+
+  /** Read the model from a file stream positioned after the header (\sa VignettingModel::Reader). */
+  static VignettingModel::Ptr read(const std::string& filename, std::ifstream& file, const std::string& header);
+
+  virtual std::string getName() const override;
+
+  virtual void save(const std::string& filename) const override;
+
+  /** Evaluate the model at a given image location with bilinear interpolation between grid nodes. */
+  virtual cv::Vec3f operator()(const cv::Vec2f& p) const override;
+
+  using VignettingModel::operator();
+
+  virtual cv::Size getImageSize() const override;
+
+  virtual bool supportsRowEvaluation() const override {
+    return true;
+  }
+
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const override;
+
+  /** Evaluate the model on a region of the pixel grid of an image.
+    * Interpolation is separable: grid rows are upsampled horizontally (once per grid row), and image rows are blended
+    * from pairs of upsampled grid rows with contiguous, vectorizable loops. */
+  virtual void evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray response) const override;
+
+  using VignettingModel::evaluateGrid;
+
+  virtual cv::Mat getModelCoefficients() const override;
+
+ private:
+  /** Validate coefficients and compute members derived from them. */
+  void setCoefficients(cv::InputArray coefficients, cv::Size image_size);
+
+  cv::Mat coefficients_;
+  cv::Size image_size_;
+  cv::Vec2f spacing_;  ///< distance between grid nodes (in pixels) along x and y
+};
+
+}  // namespace radical
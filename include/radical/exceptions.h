@@ -92,6 +92,15 @@ class MatSizeException : public MatException {
   , expected_size(expected_size)
   , actual_size(actual_size) {}
 
+  /** Version for matrices that may have one of several sizes.
+    * \param[in] accepted description of the accepted sizes, appended to the message
+    * \param[in] expected_size accepted size that is closest to the actual one */
+  explicit MatSizeException(const std::string& mat_name, const std::string& accepted, const cv::Size& expected_size,
+                            const cv::Size& actual_size)
+  : MatException(mat_name + " does not have expected size (" + accepted + ")")
+  , expected_size(expected_size)
+  , actual_size(actual_size) {}
+
   const cv::Size expected_size;
   const cv::Size actual_size;
 };
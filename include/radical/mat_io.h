@@ -38,9 +38,29 @@ void writeMat(const std::string& filename, const cv::Mat& mat);
 
 void writeMat(std::ofstream& file, const cv::Mat& mat);
 
+/// Alignment (in bytes) of cv::Mat data in files written with a text header (\sa writeMat()).
+const size_t MAT_DATA_ALIGNMENT = 64;
+
+/** Write a single-line text header followed by a cv::Mat in binary format.
+  * The header line is padded with spaces so that the data of the cv::Mat is aligned to \c MAT_DATA_ALIGNMENT bytes
+  * in the file. This allows mapMat() to map it without copying. The header should not contain a newline character, it
+  * is appended automatically. */
+void writeMat(std::ofstream& file, const std::string& header, const cv::Mat& mat);
+
 /** Read a cv::Mat from a file. */
 cv::Mat readMat(const std::string& filename);
 
 cv::Mat readMat(std::ifstream& file);
 
+/** Map a cv::Mat stored in a file into memory instead of reading it.
+  * The returned cv::Mat points directly into the memory-mapped file. The mapping is reference counted and is released
+  * together with the last cv::Mat that uses it. Pages are mapped copy-on-write: modifications of the cv::Mat are
+  * private to the process and are never written back to the file, and unmodified pages are shared between processes.
+  * The data is guaranteed to be aligned at least to the size of the element type (\sa CV_ELEM_SIZE1). If the position
+  * of the data in the file does not allow this, or memory mapping is not supported (OpenCV 2), the data is read into a
+  * newly allocated cv::Mat instead.
+  * \param[in] filename path to the file
+  * \param[in] offset position of the serialized cv::Mat in the file (e.g. after a text header) */
+cv::Mat mapMat(const std::string& filename, size_t offset = 0);
+
 }  // namespace radical
@@ -35,8 +35,14 @@ class NonparametricVignettingModel : public VignettingModel {
 
   NonparametricVignettingModel(cv::InputArray coefficients);
 
+  /** Load the model from a file.
+    * The coefficients are memory-mapped rather than read (\sa mapMat()). */
   NonparametricVignettingModel(const std::string& filename);
 
+  /** Read the model from a file stream positioned after the header (\sa VignettingModel::Reader).
+    * The coefficients are memory-mapped rather than read (\sa mapMat()). */
+  static VignettingModel::Ptr read(const std::string& filename, std::ifstream& file, const std::string& header);
+
   virtual std::string getName() const override;
 
   virtual void save(const std::string& filename) const override;
@@ -47,6 +53,14 @@ class NonparametricVignettingModel : public VignettingModel {
 
   virtual cv::Size getImageSize() const override;
 
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const override;
+
+  /** Evaluate the model on a region of the pixel grid of an image.
+    * If the image has the same size as the model, the coefficients are copied directly. */
+  virtual void evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray response) const override;
+
+  using VignettingModel::evaluateGrid;
+
   virtual cv::Mat getModelCoefficients() const override;
 
  private:
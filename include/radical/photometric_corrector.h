@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+namespace radical {
+
+class RadiometricResponse;
+class VignettingResponse;
+
+/** The PhotometricCorrector class removes vignetting effects from images in a single pass.
+  *
+  * The result is equivalent to the following sequence of calls:
+  *
+  *     rr.inverseMap(I, E);
+  *     cv::multiply(E, cv::Scalar::all(scale), E);
+  *     vr.remove(E, L);
+  *     rr.directMap(L, O);
+  *
+  * However, the inverse mapping, exposure scaling, vignetting removal, and direct mapping are fused into a single
+  * per-pixel kernel, so no intermediate irradiance images are created and the frame is streamed through memory once.
+  * The per-pixel gain (reciprocal of the vignetting response) is shared with the response cache of VignettingResponse
+  * and computed once for every image size, or evaluated row by row if on the fly evaluation is enabled in the
+  * vignetting response. */
+class PhotometricCorrector {
+ public:
+  using Ptr = std::shared_ptr<PhotometricCorrector>;
+
+  /** Construct PhotometricCorrector from radiometric and vignetting responses of a camera.
+    * \param[in] radiometric_response radiometric response of the camera
+    * \param[in] vignetting_response vignetting response of the camera
+    * \param[in] scale factor applied to the irradiance before re-applying the camera response function (the end effect
+    * is same as changing the exposure time) */
+  PhotometricCorrector(std::shared_ptr<const RadiometricResponse> radiometric_response,
+                       std::shared_ptr<const VignettingResponse> vignetting_response, float scale = 1.0f);
+
+  virtual ~PhotometricCorrector();
+
+  /** Set the factor applied to the irradiance before re-applying the camera response function. */
+  void setScale(float scale);
+
+  float getScale() const;
+
+  /** Remove vignetting effects from a given image.
+    * \param[in] I image brightness (CV_8UC3 if the bit depth of the radiometric response is 8, CV_16UC3 otherwise)
+    * \param[out] O corrected image brightness (same type as input) */
+  void correct(cv::InputArray I, cv::OutputArray O) const;
+
+  /** Compute irradiance and scene radiance at given locations of an image.
+    * This does not allocate memory (once the gain for the image size has been computed) and is suitable for sparse
+    * samples. The scale of the corrector is not applied. It is the responsibility of the user to make sure that the
+    * locations are within the image.
+    * \param[in] I image brightness (CV_8UC3 if the bit depth of the radiometric response is 8, CV_16UC3 otherwise)
+    * \param[in] points pixel locations
+    * \param[out] E pixel irradiance
+    * \param[out] L scene radiance (optional, may be \c nullptr)
+    * \param[in] n number of pixels */
+  void sample(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, cv::Vec3f* L, size_t n) const;
+
+ private:
+  std::shared_ptr<const RadiometricResponse> radiometric_response_;
+  std::shared_ptr<const VignettingResponse> vignetting_response_;
+  float scale_;
+
+  // Inverse response multiplied by scale, stored channel by channel
+  cv::Mat_<float> inverse_lut_;
+};
+
+}  // namespace radical
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace radical {
+
+class RadiometricResponse;
+class VignettingResponse;
+
+/** A single stage of a Pipeline.
+  * Stages transform tiles of an image. They should be stateless (or otherwise thread-safe), because tiles of the same
+  * image are processed concurrently by several threads. */
+class PipelineStage {
+ public:
+  using Ptr = std::shared_ptr<PipelineStage>;
+  using ConstPtr = std::shared_ptr<const PipelineStage>;
+
+  virtual ~PipelineStage() {}
+
+  /** Get the type of the output produced by this stage for inputs of a given type.
+    * An exception is thrown if the input type is not supported. */
+  virtual int getOutputType(int input_type) const = 0;
+
+  /** Process a tile.
+    * \param[in] in input tile (may be a non-continuous view into a larger image)
+    * \param[out] out output tile, already allocated with the size of the input and the type returned by
+    * getOutputType(), the stage should write into it and not reallocate it (may be non-continuous as well)
+    * \param[in] tile location of the tile in the image
+    * \param[in] image_size size of the whole image */
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size image_size) const = 0;
+};
+
+/** The Pipeline class applies a chain of stages to images tile by tile.
+  *
+  * Running stages one after another over whole images streams every intermediate image through memory. Instead, the
+  * pipeline splits the image into tiles small enough for the intermediate results of all stages to stay in cache
+  * (L2-sized by default) and runs the whole chain on each tile before moving on to the next one. Tiles are processed in
+  * parallel. Stages are composed once, the pipeline may then be run on images of any size from multiple threads.
+  *
+  * A pipeline equivalent to PhotometricCorrector would be:
+  *
+  *     Pipeline pipeline;
+  *     pipeline.addStage(std::make_shared<InverseMapStage>(rr))
+  *             .addStage(std::make_shared<ScaleStage>(scale))
+  *             .addStage(std::make_shared<RemoveVignettingStage>(vr))
+  *             .addStage(std::make_shared<DirectMapStage>(rr));
+  *     pipeline.run(I, O); */
+class Pipeline {
+ public:
+  using Ptr = std::shared_ptr<Pipeline>;
+
+  /// Default size of the working set of a tile, fits into the L2 cache of most CPUs.
+  static const size_t DEFAULT_TILE_BYTES = 256 << 10;
+
+  /** Construct an empty pipeline.
+    * \param[in] tile_bytes approximate memory used by the input and output of a stage for a single tile (bytes) */
+  explicit Pipeline(size_t tile_bytes = DEFAULT_TILE_BYTES);
+
+  virtual ~Pipeline();
+
+  /** Append a stage to the pipeline.
+    * \returns reference to this pipeline to allow chaining */
+  Pipeline& addStage(PipelineStage::ConstPtr stage);
+
+  const std::vector<PipelineStage::ConstPtr>& getStages() const;
+
+  void setTileBytes(size_t bytes);
+
+  size_t getTileBytes() const;
+
+  /** Get the size of tiles that images of a given size and type are split into. */
+  cv::Size getTileSize(cv::Size image_size, int type) const;
+
+  /** Get the type of the output for inputs of a given type.
+    * An exception is thrown if some stage does not support its input type or the pipeline is empty. */
+  int getOutputType(int input_type) const;
+
+  /** Run the pipeline on a given image.
+    * \param[in] I input image
+    * \param[out] O output image (type is defined by the stages, see getOutputType()), should not be the same as \a I
+    * unless input and output types of all stages are the same */
+  void run(cv::InputArray I, cv::OutputArray O) const;
+
+ private:
+  std::vector<PipelineStage::ConstPtr> stages_;
+  size_t tile_bytes_;
+};
+
+/** Built-in stage that maps brightness to irradiance (\sa RadiometricResponse::inverseMap()).
+  * Input type is CV_8UC3 or CV_16UC3 (depending on the bit depth of the response), output type is CV_32FC3. */
+class InverseMapStage : public PipelineStage {
+ public:
+  InverseMapStage(std::shared_ptr<const RadiometricResponse> radiometric_response);
+
+  virtual int getOutputType(int input_type) const override;
+
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size image_size) const override;
+
+ private:
+  std::shared_ptr<const RadiometricResponse> radiometric_response_;
+};
+
+/** Built-in stage that multiplies irradiance by a constant factor (same effect as changing the exposure time).
+  * Input and output types are CV_32FC3. */
+class ScaleStage : public PipelineStage {
+ public:
+  ScaleStage(float scale);
+
+  virtual int getOutputType(int input_type) const override;
+
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size image_size) const override;
+
+ private:
+  float scale_;
+};
+
+/** Built-in stage that removes vignetting effects from irradiance (\sa VignettingResponse::remove()).
+  * The evaluation strategy of the vignetting response is respected: either tiles of the cached full-frame gain are
+  * used, or the model is evaluated on the fly for each tile. Input and output types are CV_32FC3. */
+class RemoveVignettingStage : public PipelineStage {
+ public:
+  RemoveVignettingStage(std::shared_ptr<const VignettingResponse> vignetting_response);
+
+  virtual int getOutputType(int input_type) const override;
+
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size image_size) const override;
+
+ private:
+  std::shared_ptr<const VignettingResponse> vignetting_response_;
+};
+
+/** Built-in stage that maps irradiance to brightness (\sa RadiometricResponse::directMap()).
+  * Input type is CV_32FC3, output type is CV_8UC3 or CV_16UC3 (depending on the bit depth of the response). */
+class DirectMapStage : public PipelineStage {
+ public:
+  DirectMapStage(std::shared_ptr<const RadiometricResponse> radiometric_response);
+
+  virtual int getOutputType(int input_type) const override;
+
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size image_size) const override;
+
+ private:
+  std::shared_ptr<const RadiometricResponse> radiometric_response_;
+};
+
+}  // namespace radical
@@ -39,7 +39,7 @@ namespace radical {
   * two numbers define c, and the remaining are betas.
   *
   * \note The implementation is generic and supports polynomials of different degree. However, the model is explicitly
-  * instantiated only with \c Degree = 3. */
+  * instantiated only with \c Degree from 1 to 6 (\sa readPolynomialVignettingModel()). */
 template <unsigned int Degree>
 class PolynomialVignettingModel : public VignettingModel {
  public:
@@ -59,6 +59,18 @@ class PolynomialVignettingModel : public VignettingModel {
 
   virtual cv::Size getImageSize() const override;
 
+  virtual bool supportsRowEvaluation() const override {
+    return true;
+  }
+
+  /** Evaluate the polynomial along a row of an image.
+    * The squared distance to the center is split into a per-row term and a per-column term, and the polynomial is
+    * evaluated with Horner's scheme in double precision (squared radius at full resolution is too large for floats).
+    * The reciprocal, if requested, is taken in single precision. */
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const override;
+
+  using VignettingModel::evaluateGrid;
+
   virtual cv::Mat getModelCoefficients() const override;
 
  private:
@@ -66,4 +78,15 @@ class PolynomialVignettingModel : public VignettingModel {
   cv::Size image_size_;
 };
 
+/** Create a polynomial vignetting model with a degree that is only known at runtime.
+  * Exception is thrown if the degree is not supported (\sa PolynomialVignettingModel). */
+VignettingModel::Ptr createPolynomialVignettingModel(unsigned int degree, cv::InputArray coefficients,
+                                                     cv::Size image_size);
+
+/** Read a polynomial vignetting model from a file stream positioned after the header (\sa VignettingModel::Reader).
+  * The degree of the polynomial is parsed from the header, and the model is instantiated with the matching template
+  * argument. SerializationException is thrown if the degree is not supported. */
+VignettingModel::Ptr readPolynomialVignettingModel(const std::string& filename, std::ifstream& file,
+                                                   const std::string& header);
+
 }  // namespace radical
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <radical/vignetting_model.h>
+
+namespace radical {
+
+/** Radially symmetric model of vignetting response stored as a lookup table.
+  *
+  * Vignetting response of each color channel is a function of the squared distance to the center of symmetry c:
+  * \f[
+  *     V(\mathbf{x}) = P\left(\frac{(\mathbf{x} - \mathbf{c})^2}{r_{max}^2}\right),
+  * \f]
+  *
+  * where P is a profile sampled at uniformly spaced points on [0, 1] and linearly interpolated in between, and r_max is
+  * the distance from the center to the farthest image corner. Indexing by squared radius avoids a square root and
+  * places more samples towards the image border, where vignetting changes faster.
+  *
+  * Model coefficients are a 1xN matrix (CV_32FC3, each channel has its own coefficients). First two numbers define c,
+  * and the remaining N - 2 (at least 2) are the samples of the profile. */
+class RadialVignettingModel : public VignettingModel {
+ public:
+  using Ptr = std::shared_ptr<RadialVignettingModel>;
+
+  /// Default number of samples in the profile.
+  static const unsigned int DEFAULT_PROFILE_SIZE = 256;
+
+  RadialVignettingModel(cv::InputArray coefficients, cv::Size image_size);
+
+  RadialVignettingModel(const std::string& filename);
+
+  /** Fit the model to a dense map of attenuation factors.
+    * The center of symmetry (shared by all channels) is found with a pattern search that minimizes the residual of the
+    * profile fit on a subset of pixels. Profiles are then fitted to all pixels in the least-squares sense.
+    * \param[in] response dense vignetting response (CV_32FC3)
+    * \param[in] profile_size number of samples in the profile (at least 2) */
+  static Ptr fromDense(cv::InputArray response, unsigned int profile_size = DEFAULT_PROFILE_SIZE);
+
+  /** Read the model from a file stream positioned after the header (\sa VignettingModel::Reader). */
+  static VignettingModel::Ptr read(const std::string& filename, std::ifstream& file, const std::string& header);
+
+  virtual std::string getName() const override;
+
+  virtual void save(const std::string& filename) const override;
+
+  virtual cv::Vec3f operator()(const cv::Vec2f& p) const override;
+
+  using VignettingModel::operator();
+
+  virtual cv::Size getImageSize() const override;
+
+  virtual bool supportsRowEvaluation() const override {
+    return true;
+  }
+
+  /** Evaluate the model along a row of an image.
+    * The squared distance to the center is split into a per-row term and a per-column term, so each pixel takes a
+    * multiply-add and a linear interpolation between two profile samples. */
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const override;
+
+  using VignettingModel::evaluateGrid;
+
+  virtual cv::Mat getModelCoefficients() const override;
+
+ private:
+  /** Validate coefficients and compute members derived from them. */
+  void setCoefficients(cv::InputArray coefficients, cv::Size image_size);
+
+  cv::Mat coefficients_;
+  cv::Size image_size_;
+  cv::Vec3f index_scale_;  ///< factor that maps squared radius to profile index, per channel
+};
+
+}  // namespace radical
@@ -24,66 +24,130 @@
 
 #include <memory>
 #include <string>
-#include <vector>
 
 #include <opencv2/core/core.hpp>
 
 namespace radical {
 
+class ForwardTable;
+
 /** The RadiometricResponse class models camera response function (CRF) and
-  * allows to map from pixel brightness to pixel irradiance and vice versa. */
+  * allows to map from pixel brightness to pixel irradiance and vice versa.
+  *
+  * The bit depth of pixel brightness is defined by the number of elements in the inverse CRF. A response with 256
+  * elements works with 8-bit images (CV_8UC3), whereas a response with 2^N elements (N up to 16) works with 16-bit
+  * images (CV_16UC3) that hold N-bit brightness values, e.g. from 10- or 12-bit machine vision cameras. Only
+  * three-channel images are supported, so single-channel (Mono or raw Bayer) frames need to be converted (e.g.
+  * demosaiced) first. */
 class RadiometricResponse {
  public:
   using Ptr = std::shared_ptr<RadiometricResponse>;
 
+  /** Default number of bins per channel in the lookup table used for direct mapping. */
+  static const unsigned int DEFAULT_FORWARD_TABLE_SIZE = 4096;
+
   /** Construct RadiometricResponse from a cv::Mat with inverse CRF.
-    * \param[in] response inverse CRF (CV_32FC3, 256 elements) */
-  RadiometricResponse(cv::InputArray response);
+    * \param[in] response inverse CRF (CV_32FC3, 2^N elements, where N is the bit depth between 8 and 16)
+    * \param[in] forward_table_size number of bins per channel in the lookup table used for direct mapping (up to
+    * 65536). Larger tables reduce the number of irradiance values that need an additional search. For high bit depths
+    * a table size comparable to the number of brightness levels is advisable. */
+  RadiometricResponse(cv::InputArray response, unsigned int forward_table_size = DEFAULT_FORWARD_TABLE_SIZE);
 
-  RadiometricResponse(const std::string& filename);
+  RadiometricResponse(const std::string& filename, unsigned int forward_table_size = DEFAULT_FORWARD_TABLE_SIZE);
 
   virtual ~RadiometricResponse();
 
   /** Get inverse of the response function (a lookup table that maps pixel brightness to irradiance). */
   cv::Mat getInverseResponse() const;
 
+  /** Get the number of bits in pixel brightness values (8 to 16). */
+  int getBitDepth() const;
+
   /** Write radiometric response to a file. */
   void save(const std::string& filename) const;
 
   /** Compute pixel brightness from pixel irradiance (direct mapping).
     * \param[in] E pixel irradiance
-    * \returns pixel brightness */
+    * \returns pixel brightness (saturated to 255 if the bit depth is above 8) */
   cv::Vec3b directMap(const cv::Vec3f& E) const;
 
+  /** Compute pixel brightness from pixel irradiance (direct mapping), version for any bit depth.
+    * \param[in] E pixel irradiance
+    * \returns pixel brightness */
+  cv::Vec3w directMap16(const cv::Vec3f& E) const;
+
   /** Compute image brightness from image irradiance (direct mapping).
     * \param[in] E image irradiance
-    * \param[out] I image brightness */
+    * \param[out] I image brightness (CV_8UC3 if the bit depth is 8, CV_16UC3 otherwise) */
   void directMap(cv::InputArray E, cv::OutputArray I) const;
 
   /** Compute pixel irradiance from pixel brightness (inverse mapping).
+    * Brightness values above the maximum for the bit depth of the response are clamped.
     * \param[in] I pixel brightness
     * \returns pixel irradiance */
   cv::Vec3f inverseMap(const cv::Vec3b& I) const;
+  cv::Vec3f inverseMap(const cv::Vec3w& I) const;
 
   /** Compute image irradiance from image brightness (inverse mapping).
-    * \param[in] I image brightness
+    * \param[in] I image brightness (CV_8UC3 if the bit depth is 8, CV_16UC3 otherwise)
     * \param[out] E image irradiance */
   void inverseMap(cv::InputArray I, cv::OutputArray E) const;
 
+  /** Compute irradiance of a batch of pixels from their brightness (inverse mapping).
+    * This does not allocate memory and is suitable for sparse samples.
+    * \param[in] I pixel brightness
+    * \param[out] E pixel irradiance
+    * \param[in] n number of pixels */
+  void inverseMap(const cv::Vec3b* I, cv::Vec3f* E, size_t n) const;
+  void inverseMap(const cv::Vec3w* I, cv::Vec3f* E, size_t n) const;
+
+  /** Compute irradiance at given locations of an image (inverse mapping).
+    * This does not allocate memory and is suitable for sparse samples. It is the responsibility of the user to make
+    * sure that the locations are within the image.
+    * \param[in] I image brightness (CV_8UC3 if the bit depth is 8, CV_16UC3 otherwise)
+    * \param[in] points pixel locations
+    * \param[out] E pixel irradiance
+    * \param[in] n number of pixels */
+  void inverseMap(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, size_t n) const;
+
   /** Compute logarithm of pixel irradiance from pixel brightness (inverse mapping).
+    * Brightness values above the maximum for the bit depth of the response are clamped.
     * \param[in] I pixel brightness
     * \returns logarithm of pixel irradiance */
   cv::Vec3f inverseLogMap(const cv::Vec3b& I) const;
+  cv::Vec3f inverseLogMap(const cv::Vec3w& I) const;
 
   /** Compute logarithm of image irradiance from image brightness (inverse mapping).
-    * \param[in] I image brightness
+    * \param[in] I image brightness (CV_8UC3 if the bit depth is 8, CV_16UC3 otherwise)
     * \param[out] E logarithm of image irradiance */
   void inverseLogMap(cv::InputArray I, cv::OutputArray E) const;
 
+  /** Compute logarithm of irradiance of a batch of pixels from their brightness (inverse mapping).
+    * \param[in] I pixel brightness
+    * \param[out] E logarithm of pixel irradiance
+    * \param[in] n number of pixels */
+  void inverseLogMap(const cv::Vec3b* I, cv::Vec3f* E, size_t n) const;
+  void inverseLogMap(const cv::Vec3w* I, cv::Vec3f* E, size_t n) const;
+
+  /** Compute logarithm of irradiance at given locations of an image (inverse mapping).
+    * \param[in] I image brightness (CV_8UC3 if the bit depth is 8, CV_16UC3 otherwise)
+    * \param[in] points pixel locations
+    * \param[out] E logarithm of pixel irradiance
+    * \param[in] n number of pixels */
+  void inverseLogMap(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, size_t n) const;
+
  private:
+  int bit_depth_;
   cv::Mat response_;
-  cv::Mat log_response_;
-  std::vector<cv::Mat> response_channels_;
+  // Inverse response and its logarithm with channels stored one after another (3 x 2^N, single-channel), as needed
+  // by lookup kernels. The forward table shares the former.
+  cv::Mat response_lut_;
+  cv::Mat log_response_lut_;
+  std::shared_ptr<const ForwardTable> forward_table_;
+
+  friend class PhotometricCorrector;
+  friend class InverseMapStage;
+  friend class DirectMapStage;
 };
 
 }  // namespace radical
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <functional>
+#include <iosfwd>
 #include <memory>
 #include <string>
 
@@ -59,13 +61,76 @@ class VignettingModel {
   /** Get image size for which the model is valid. */
   virtual cv::Size getImageSize() const = 0;
 
+  /** Get the factor that maps pixel coordinates of an image of a given size to the coordinates used by the model.
+    * The image may be a scaled version of the image for which the model is valid, but should have the same aspect
+    * ratio, otherwise an exception is thrown. */
+  float getScale(cv::Size image_size) const;
+
+  /** Check whether the model supports cheap evaluation along image rows (\sa evaluateRow()). */
+  virtual bool supportsRowEvaluation() const {
+    return false;
+  }
+
+  /** Evaluate the model (or its reciprocal) along a row of an image.
+    * This is intended for models that are cheaper to compute than to read from a precomputed map. The default
+    * implementation evaluates the model pixel by pixel.
+    * \param[in] row row index
+    * \param[in] col column index of the first pixel
+    * \param[in] width number of pixels
+    * \param[in] scale factor that maps pixel coordinates to the coordinates used by the model (\sa getScale())
+    * \param[out] response model values for each pixel (3 * \a width floats, channels are interleaved)
+    * \param[in] reciprocal whether to output reciprocals of the model values */
+  virtual void evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const;
+
+  /** Evaluate the model on a region of the pixel grid of an image.
+    * The default implementation evaluates rows in parallel with evaluateRow().
+    * \param[in] roi region of the image (in pixel coordinates of the image)
+    * \param[in] scale factor that maps pixel coordinates to the coordinates used by the model (\sa getScale())
+    * \param[out] response model values (CV_32FC3 matrix with the size of \a roi) */
+  virtual void evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray response) const;
+
+  /** Evaluate the model on the pixel grid of an image of a given size. */
+  void evaluateGrid(cv::Size image_size, float scale, cv::OutputArray response) const {
+    evaluateGrid(cv::Rect(cv::Point(0, 0), image_size), scale, response);
+  }
+
   /** Get model coefficients. */
   virtual cv::Mat getModelCoefficients() const = 0;
 
   /** Load the vignetting model stored in a given file.
-    * This function will try to load every implemented vignetting model from the given file. The first one that succeeds
-    * in loading will be returned. If the file does not contain any valid vignetting model, \c nullptr is returned. */
+    * The first token of the file header identifies the model type, and the reader registered for this token is used to
+    * load the model (\sa registerReader()). The file is opened and parsed only once. If the file does not contain any
+    * valid vignetting model, \c nullptr is returned. */
   static Ptr load(const std::string& filename);
+
+  /** Function that reads a vignetting model from a file.
+    * \param[in] filename path to the file (e.g. to memory-map the data)
+    * \param[in] file stream positioned right after the header line
+    * \param[in] header header line (first line of the file) */
+  using Reader = std::function<Ptr(const std::string& filename, std::ifstream& file, const std::string& header)>;
+
+  /** Register a reader for vignetting models whose file header starts with a given token.
+    * Readers for the models implemented in the library are registered automatically. Registering a reader for an
+    * already registered token replaces the previous reader. Readers should throw SerializationException if the file
+    * is malformed. */
+  static void registerReader(const std::string& token, Reader reader);
+
+  /** Create a vignetting model of a given type from its coefficients.
+    * The first token of the name identifies the model type, and the factory registered for this token is used to
+    * create the model (\sa registerFactory()). If no factory is registered for the type, \c nullptr is returned.
+    * \param[in] name name of the model (\sa getName()), e.g. "polynomial 3"
+    * \param[in] coefficients model coefficients (\sa getModelCoefficients())
+    * \param[in] image_size image size for which the model is valid (\sa getImageSize()) */
+  static Ptr create(const std::string& name, cv::InputArray coefficients, cv::Size image_size);
+
+  /** Function that creates a vignetting model from its coefficients (\sa create()). */
+  using Factory = std::function<Ptr(const std::string& name, cv::InputArray coefficients, cv::Size image_size)>;
+
+  /** Register a factory for vignetting models whose name starts with a given token.
+    * Factories for the models implemented in the library are registered automatically. Registering a factory for an
+    * already registered token replaces the previous factory. Factories should throw Exception if the coefficients are
+    * not valid for the model. */
+  static void registerFactory(const std::string& token, Factory factory);
 };
 
 }  // namespace radical
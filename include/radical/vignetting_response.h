@@ -22,8 +22,10 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 
@@ -31,11 +33,63 @@ namespace radical {
 
 class VignettingModel;
 
+/** Readout mode of a camera sensor, i.e. a region of interest and a binning factor.
+  * The region is given in sensor coordinates, which are pixel coordinates of the full-resolution image for which the
+  * vignetting model was calibrated. Image pixel (x, y) covers sensor pixels starting at (roi.x + binning * x,
+  * roi.y + binning * y). */
+struct SensorWindow {
+  cv::Rect roi;     ///< region of the sensor that is read out
+  int binning = 1;  ///< number of sensor pixels combined into one image pixel along each dimension
+
+  SensorWindow() {}
+
+  SensorWindow(const cv::Rect& _roi, int _binning = 1)
+  : roi(_roi), binning(_binning) {}
+
+  /** Size of images captured in this mode. */
+  cv::Size getImageSize() const {
+    return binning > 0 ? cv::Size(roi.width / binning, roi.height / binning) : cv::Size();
+  }
+};
+
+/** Vignetting response of a camera.
+  * Responses for different image sizes are computed on demand and cached. The memory used by the cache is limited by
+  * a byte budget, least recently used responses are evicted when it is exceeded. All methods are thread-safe, so a
+  * single instance may be shared between multiple processing threads. */
 class VignettingResponse {
  public:
   using Ptr = std::shared_ptr<VignettingResponse>;
 
-  VignettingResponse(const std::string& filename);
+  /// Default budget of the response cache. A map of a 4K image takes about 100 MB, so this fits five such maps, e.g.
+  /// reciprocal responses (used by remove()) for five image sizes, or all three maps for one size plus two more.
+  static constexpr size_t DEFAULT_CACHE_BUDGET = 512 << 20;
+
+  /** Statistics of the response cache. */
+  struct CacheStats {
+    size_t budget;                ///< maximum memory used by cached responses (bytes)
+    size_t footprint;             ///< memory currently used by cached responses (bytes)
+    uint64_t hits;                ///< number of requests served from the cache
+    uint64_t misses;              ///< number of requests that required computing a response
+    uint64_t evictions;           ///< number of responses evicted to stay within the budget
+    uint64_t disk_hits;           ///< number of misses served from the cache directory
+    std::vector<cv::Size> sizes;  ///< image sizes (or sensor window sizes) with cached responses
+  };
+
+  /** Strategy for applying the vignetting response to images. */
+  enum class Evaluation {
+    Precomputed,  ///< response is computed once for each image size and cached
+    OnTheFly,     ///< model is evaluated row by row while processing images, no full-frame maps are stored
+  };
+
+  /** Load vignetting model from a file.
+    * \param[in] filename path to the model file
+    * \param[in] cache_budget maximum memory (in bytes) used to cache responses for different image sizes */
+  VignettingResponse(const std::string& filename, size_t cache_budget = DEFAULT_CACHE_BUDGET);
+
+  /** Construct from a given vignetting model (e.g. loaded from a CalibrationBundle).
+    * \param[in] model vignetting model
+    * \param[in] cache_budget maximum memory (in bytes) used to cache responses for different image sizes */
+  VignettingResponse(std::shared_ptr<const VignettingModel> model, size_t cache_budget = DEFAULT_CACHE_BUDGET);
 
   virtual ~VignettingResponse();
 
@@ -49,31 +103,115 @@ class VignettingResponse {
 
   cv::Mat getLogResponse(cv::Size image_size) const;
 
+  /** Get reciprocal of the vignetting response, i.e. the gain that removes vignetting effects. */
+  cv::Mat getReciprocalResponse(cv::Size image_size) const;
+
+  /** Get vignetting response for images captured in a given sensor readout mode.
+    * Only the window is evaluated, the aspect ratio of the resulting image need not match that of the model. Windows
+    * that cover the same pixel grid share cache entries, e.g. the full sensor binned by two and the full frame of half
+    * the model size. An exception is thrown if the window is not inside the sensor, the binning factor is not
+    * positive, or the window origin is not a multiple of the binning factor. */
+  cv::Mat getResponse(const SensorWindow& window) const;
+
+  cv::Mat getLogResponse(const SensorWindow& window) const;
+
+  cv::Mat getReciprocalResponse(const SensorWindow& window) const;
+
+  /** Change the maximum memory (in bytes) used to cache responses.
+    * Least recently used responses are evicted immediately if the new budget is exceeded. Note that a newly computed
+    * response is cached even if it alone exceeds the budget, in which case all other responses are evicted. */
+  void setCacheBudget(size_t bytes);
+
+  /** Enable persistent caching of responses in a given directory.
+    * Responses (and maps derived from them) that are not in memory are looked up in the directory before computing
+    * them, and computed ones are stored there. Files are keyed by a hash of the model contents and the image size, so
+    * a directory may be shared between different models and processes. The stored maps are memory-mapped rather than
+    * read. The directory should exist; failures to write to it are silently ignored. An empty string (default)
+    * disables the persistent cache. */
+  void setCacheDirectory(const std::string& directory);
+
+  std::string getCacheDirectory() const;
+
+  CacheStats getCacheStats() const;
+
+  /** Select how the response is applied in remove() and add() and by PhotometricCorrector.
+    * On the fly evaluation is beneficial for models that are cheaper to compute than to read from memory (e.g.
+    * polynomial). It is not supported by all models, in which case an exception is thrown. The log variants always use
+    * precomputed responses. This should be set before the object is shared between threads.
+    * Default: Evaluation::Precomputed. */
+  void setEvaluation(Evaluation evaluation);
+
+  Evaluation getEvaluation() const;
+
   /** Remove vignetting effects from a given image.
     * \param[in] E image irradiance
     * \param[out] L scene radiance */
   void remove(cv::InputArray E, cv::OutputArray L) const;
 
+  /** Remove vignetting effects from an image captured in a given sensor readout mode.
+    * \param[in] E image irradiance, its size should match the window (\sa SensorWindow::getImageSize())
+    * \param[out] L scene radiance
+    * \param[in] window sensor readout mode */
+  void remove(cv::InputArray E, cv::OutputArray L, const SensorWindow& window) const;
+
+  /** Remove vignetting effects from irradiance of pixels at given image locations.
+    * This does not allocate memory (once the response for the image size has been computed) and is suitable for
+    * sparse samples. It is the responsibility of the user to make sure that the locations are within the image.
+    * \param[in] image_size size of the image the pixels come from
+    * \param[in] points pixel locations
+    * \param[in] E pixel irradiance
+    * \param[out] L scene radiance (may be the same array as \a E)
+    * \param[in] n number of pixels */
+  void remove(cv::Size image_size, const cv::Point* points, const cv::Vec3f* E, cv::Vec3f* L, size_t n) const;
+
   /** Remove vignetting effects from a given log image.
     * \param[in] E logarithm of image irradiance
     * \param[out] L logarithm of scene radiance */
   void removeLog(cv::InputArray E, cv::OutputArray L) const;
 
+  void removeLog(cv::InputArray E, cv::OutputArray L, const SensorWindow& window) const;
+
+  /** Remove vignetting effects from logarithm of irradiance of pixels at given image locations.
+    * \param[in] image_size size of the image the pixels come from
+    * \param[in] points pixel locations
+    * \param[in] E logarithm of pixel irradiance
+    * \param[out] L logarithm of scene radiance (may be the same array as \a E)
+    * \param[in] n number of pixels */
+  void removeLog(cv::Size image_size, const cv::Point* points, const cv::Vec3f* E, cv::Vec3f* L, size_t n) const;
+
   /** Add vignetting effects to a given image.
     * \param[in] L scene radiance
     * \param[out] E image irradiance */
   void add(cv::InputArray L, cv::OutputArray E) const;
 
+  void add(cv::InputArray L, cv::OutputArray E, const SensorWindow& window) const;
+
   /** Add vignetting effects to a given log image.
     * \param[in] L logarithm of scene radiance
     * \param[out] E logarithm of image irradiance */
   void addLog(cv::InputArray L, cv::OutputArray E) const;
 
+  void addLog(cv::InputArray L, cv::OutputArray E, const SensorWindow& window) const;
+
  private:
+  /// Part of the pixel grid of the model image (resampled with a given scale) that an image covers.
+  struct Region;
+
+  Region getRegion(cv::Size image_size) const;
+
+  Region getRegion(const SensorWindow& window) const;
+
+  /// Multiply a given image by the response (or its reciprocal) on a given region, using the selected evaluation.
+  void multiply(cv::InputArray I, cv::OutputArray O, const Region& region, bool reciprocal) const;
+
+  /// Multiply a given image by the response (or its reciprocal) evaluated on the fly.
+  void applyOnTheFly(cv::InputArray I, cv::OutputArray O, const Region& region, bool reciprocal) const;
+
   std::shared_ptr<const VignettingModel> model_;
+  Evaluation evaluation_;
 
   struct ResponseCache;
-  mutable std::unique_ptr<ResponseCache> response_cache_;
+  std::unique_ptr<ResponseCache> response_cache_;
 };
 
 }  // namespace radical
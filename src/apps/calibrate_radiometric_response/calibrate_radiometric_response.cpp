@@ -67,6 +67,10 @@ class Options : public OptionsBase {
   bool interactive = false;
   double smoothing = 50;
   bool print = false;
+  bool concurrent_channels = false;
+  unsigned int subsample = 0;
+  bool no_refine = false;
+  unsigned int anderson = 0;
 
  protected:
   void addOptions(boost::program_options::options_description& desc) override {
@@ -75,7 +79,8 @@ class Options : public OptionsBase {
                        "Output filename with calibrated response function (default: camera model name + \".\" + camera "
                        "serial number + \".crf\" suffix)");
     desc.add_options()("threshold,t", po::value<double>(&convergence_threshold),
-                       "Threshold for energy update after which convergence is declared (default: 1e-5)");
+                       "Threshold for the change of the normalized inverse response after which convergence is "
+                       "declared (only for engel method, default: 1e-5)");
     desc.add_options()("method,m", po::value<std::string>(&calibration_method)->default_value(calibration_method),
                        "Calibration method to use");
     desc.add_options()("min-samples", po::value<unsigned int>(&min_samples)->default_value(min_samples),
@@ -89,6 +94,16 @@ class Options : public OptionsBase {
     desc.add_options()("interactive", po::bool_switch(&interactive),
                        "Wait for a keypress after each optimization iteration");
     desc.add_options()("print", po::bool_switch(&print), "Print calibrated response function to stdout");
+    desc.add_options()("subsample", po::value<unsigned int>(&subsample)->default_value(subsample),
+                       "Calibrate on approximately this many pixels first and refine on all pixels, 0 to disable "
+                       "(only for engel method)");
+    desc.add_options()("no-refine", po::bool_switch(&no_refine),
+                       "Do not refine the calibration on all pixels after subsampling (only for engel method)");
+    desc.add_options()("anderson", po::value<unsigned int>(&anderson)->default_value(anderson),
+                       "Accelerate convergence with Anderson extrapolation over this many previous iterations, 0 to "
+                       "disable (only for engel method)");
+    desc.add_options()("concurrent-channels", po::bool_switch(&concurrent_channels),
+                       "Calibrate color channels concurrently rather than one after another");
 
     boost::program_options::options_description dcopt("Data collection");
     dcopt.add_options()("exposure-min", po::value<int>(&dc.exposure_min),
@@ -253,6 +268,8 @@ int main(int argc, const char** argv) {
   if (options.calibration_method == "engel") {
     auto cal = std::make_shared<EngelCalibration>();
     cal->setConvergenceThreshold(options.convergence_threshold);
+    cal->setSubsampling(options.subsample, !options.no_refine);
+    cal->setAndersonAcceleration(options.anderson);
     calibration = cal;
   } else if (options.calibration_method == "debevec") {
 #if HAVE_CERES
@@ -278,6 +295,8 @@ int main(int argc, const char** argv) {
   calibration->setValidPixelRange(static_cast<unsigned char>(options.dc.valid_intensity_min),
                                   static_cast<unsigned char>(options.dc.valid_intensity_max));
   calibration->setVerbosity(options.verbosity);
+  // Waiting for a keypress after each iteration only makes sense if channels do not progress at the same time
+  calibration->setConcurrentChannels(options.concurrent_channels && !options.interactive);
   if (!options.no_visualization)
     calibration->setVisualizeProgress(limshow);
 
@@ -20,6 +20,8 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
 
 #include <boost/format.hpp>
@@ -36,10 +38,44 @@ cv::Mat Calibration::calibrate(const Dataset& data) {
     std::cout << "Starting " << getMethodName() << " calibration procedure" << std::endl;
 
   auto datasets = data.splitChannels();
+  const int num_channels = static_cast<int>(datasets.size());
+
+  std::vector<cv::Mat> response_channels(num_channels);
+  std::vector<std::exception_ptr> errors(num_channels);
+  caller_ = std::this_thread::get_id();
+  pending_images_.assign(num_channels, cv::Mat());
+  num_finished_ = 0;
+
+  auto calibrate_channel = [&](int channel) {
+    try {
+      response_channels[channel] = calibrateChannel(datasets[channel], channel);
+    } catch (...) {
+      errors[channel] = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_finished_;
+    updated_.notify_one();
+  };
+
+  printHeader();
+  if (concurrent_channels_) {
+    // Channels run in their own threads, this one takes care of visualization (GUI is not thread-safe). Each
+    // channel still parallelizes its own loops on the shared pool, so the gain depends on the core count.
+    std::vector<std::thread> threads;
+    for (int channel = 0; channel < num_channels; ++channel)
+      threads.emplace_back(calibrate_channel, channel);
+    showPendingVisualizations(num_channels);
+    for (auto& thread : threads)
+      thread.join();
+  } else {
+    for (int channel = 0; channel < num_channels; ++channel)
+      calibrate_channel(channel);
+  }
+  printFooter();
 
-  std::vector<cv::Mat> response_channels;
-  for (channel_ = 0; channel_ < static_cast<int>(datasets.size()); ++channel_)
-    response_channels.push_back(calibrateChannel(datasets[channel_]));
+  for (const auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
 
   // Post-process the response:
   //  * rescale such that maximum value is 1
@@ -79,6 +115,10 @@ void Calibration::setVisualizeProgress(const std::function<void(const cv::Mat&)>
   imshow_ = imshow;
 }
 
+void Calibration::setConcurrentChannels(bool concurrent) {
+  concurrent_channels_ = concurrent;
+}
+
 bool Calibration::isPixelValid(unsigned char pixel) const {
   return pixel >= min_valid_ && pixel <= max_valid_;
 }
@@ -97,12 +137,58 @@ void Calibration::printFooter() const {
     std::cout << boost::format("%53T-") << std::endl;
 }
 
-void Calibration::printIteration(unsigned int iteration, double residual, double delta, const char extra) {
+void Calibration::printIteration(int channel, unsigned int iteration, double residual, double delta,
+                                 const char extra) const {
   if (verbosity_) {
+    // Rows of concurrently calibrated channels are interleaved, so each one is labeled
+    std::lock_guard<std::mutex> lock(mutex_);
     if (iteration == 1)
-      std::cout << str(format("| %=7s | %=4d%c | %14.6f | %=14s |\n") % NAMES[channel_] % iteration % extra % residual %
+      std::cout << str(format("| %=7s | %=4d%c | %14.6f | %=14s |\n") % NAMES[channel] % iteration % extra % residual %
                        "");
     else
-      std::cout << str(format("| %=7s | %=4d%c | %14.6f | %14.6f |\n") % "" % iteration % extra % residual % delta);
+      std::cout << str(format("| %=7s | %=4d%c | %14.6f | %14.6f |\n") % NAMES[channel] % iteration % extra % residual %
+                       delta);
+  }
+}
+
+void Calibration::printMessage(int channel, const std::string& message) const {
+  if (verbosity_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::cout << NAMES[channel] << ": " << message << std::endl;
+  }
+}
+
+void Calibration::visualize(int channel, const cv::Mat& image) const {
+  if (!imshow_)
+    return;
+  if (std::this_thread::get_id() == caller_) {
+    imshow_(image);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_images_[channel] = image.clone();
+  updated_.notify_one();
+}
+
+void Calibration::showPendingVisualizations(size_t num_channels) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    updated_.wait(lock, [&] {
+      return num_finished_ == num_channels ||
+             std::any_of(pending_images_.begin(), pending_images_.end(), [](const cv::Mat& m) { return !m.empty(); });
+    });
+    std::vector<cv::Mat> images;
+    for (auto& image : pending_images_)
+      if (!image.empty()) {
+        images.push_back(image);
+        image.release();
+      }
+    if (images.empty() && num_finished_ == num_channels)
+      break;
+    // Channels keep running (and replacing pending images) while the images are shown
+    lock.unlock();
+    for (const auto& image : images)
+      imshow_(image);
+    lock.lock();
   }
 }
@@ -22,8 +22,12 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "dataset.h"
 
@@ -42,32 +46,55 @@ class Calibration {
   void setValidPixelRange(unsigned char min_valid, unsigned char max_valid);
 
   /** Visualize calibration progress.
+    * The function is always called from the thread that runs calibrate(), also when channels are calibrated
+    * concurrently (in which case only the latest pending visualization of each channel is shown).
     *
     * \param[i] imshow a function that can display a given cv::Mat */
   void setVisualizeProgress(const std::function<void(const cv::Mat&)>& imshow);
 
+  /** Calibrate color channels concurrently or one after another (default). */
+  void setConcurrentChannels(bool concurrent);
+
   virtual std::string getMethodName() const = 0;
 
  protected:
   /** Calibrate a single color channel.
-    * This should be implemented by deriving classes. The dataset is guaranteed to have a single color channel. */
-  virtual cv::Mat calibrateChannel(const Dataset& dataset) = 0;
+    * This should be implemented by deriving classes. The dataset is guaranteed to have a single color channel. Several
+    * channels may be calibrated at the same time, therefore the solver state should be local to the call and progress
+    * should only be reported through printIteration() and visualize(). */
+  virtual cv::Mat calibrateChannel(const Dataset& dataset, int channel) const = 0;
 
   bool isPixelValid(unsigned char pixel) const;
 
   bool isPixelValid(const cv::Vec3b& pixel) const;
 
-  void printHeader() const;
+  void printIteration(int channel, unsigned int iteration, double residual, double delta, const char extra = ' ') const;
 
-  void printFooter() const;
+  /** Print a message about calibration of a given channel (thread-safe). */
+  void printMessage(int channel, const std::string& message) const;
 
-  void printIteration(unsigned int iteration, double residual, double delta, const char extra = ' ');
+  /** Show the progress of calibration of a given channel (thread-safe). */
+  void visualize(int channel, const cv::Mat& image) const;
 
   unsigned int max_num_iterations_ = 30;
   unsigned int verbosity_ = 0;
   unsigned char min_valid_ = 1;
   unsigned char max_valid_ = 254;
   std::function<void(const cv::Mat&)> imshow_;
+  bool concurrent_channels_ = false;
+
+ private:
+  void printHeader() const;
+
+  void printFooter() const;
+
+  /** Show pending visualizations on the calling thread until all channels are finished. */
+  void showPendingVisualizations(size_t num_channels);
 
-  int channel_;
+  // Synchronization of reporting from concurrently calibrated channels
+  mutable std::mutex mutex_;
+  mutable std::condition_variable updated_;
+  mutable std::vector<cv::Mat> pending_images_;  // latest visualization of each channel not yet shown
+  size_t num_finished_ = 0;  // guarded by mutex_
+  std::thread::id caller_;
 };
@@ -148,7 +148,7 @@ Dataset::Ptr Dataset::load(const std::string& path) {
       try {
         auto exposure = boost::lexical_cast<int>(stem.substr(0, 6));
         cv::Mat image;
-        image = radical::readMat(iter->path().string());
+        image = radical::mapMat(iter->path().string());
         dataset->insert(exposure, image);
       } catch (boost::bad_lexical_cast&) {
       } catch (radical::SerializationException&) {
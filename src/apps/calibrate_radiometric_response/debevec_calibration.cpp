@@ -61,35 +61,52 @@ struct RegularizationResidual {
   }
 };
 
+/** Solver state of a single channel. */
+struct DebevecCalibration::State {
+  const Dataset* dataset = nullptr;
+  int channel;
+  std::vector<int> locations;
+
+  // Irradiances to optimize
+  std::vector<double> X;
+  // Model parameters to optimize
+  cv::Mat_<double> U;
+};
+
 struct CeresIterationCallback : public ceres::IterationCallback {
-  DebevecCalibration* p;
+  const DebevecCalibration* p;
+  const DebevecCalibration::State* state_;
   bool print_, visualize_;
-  CeresIterationCallback(DebevecCalibration* parent, bool print, bool visualize)
+  CeresIterationCallback(const DebevecCalibration* parent, const DebevecCalibration::State* state, bool print,
+                         bool visualize)
   : p(parent)
+  , state_(state)
   , print_(print)
   , visualize_(visualize) {}
   ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) override {
     if (print_)
-      p->printIteration(summary.iteration + 1, summary.cost, summary.cost_change);
+      p->printIteration(state_->channel, summary.iteration + 1, summary.cost, summary.cost_change);
     if (visualize_)
-      p->visualizeProgress();
+      p->visualizeProgress(*state_);
     return ceres::SOLVER_CONTINUE;
   }
 };
 
-cv::Mat DebevecCalibration::calibrateChannel(const Dataset& dataset) {
-  CeresIterationCallback callback{this, verbosity_ > 0, static_cast<bool>(imshow_)};
-  dataset_ = &dataset;
-  selectPixels();
-
-  X_.resize(locations_.size(), 0);
-  U_.create(256, 1);
+cv::Mat DebevecCalibration::calibrateChannel(const Dataset& dataset, int channel) const {
+  State state;
+  state.dataset = &dataset;
+  state.channel = channel;
+  CeresIterationCallback callback{this, &state, verbosity_ > 0, static_cast<bool>(imshow_)};
+  selectPixels(state);
+
+  const auto& locations = state.locations;
+  auto& X = state.X;
+  X.resize(locations.size(), 0);
+  state.U.create(256, 1);
   for (size_t i = 0; i < 256; ++i)
-    U_(i) = std::log(0.5 + i / 256.0);
+    state.U(i) = std::log(0.5 + i / 256.0);
 
-  auto U = reinterpret_cast<double*>(U_.data);
-
-  printHeader();
+  auto U = reinterpret_cast<double*>(state.U.data);
 
   ceres::Problem problem;
   problem.AddParameterBlock(U, 256);
@@ -100,18 +117,18 @@ cv::Mat DebevecCalibration::calibrateChannel(const Dataset& dataset) {
   auto loss = new ceres::HuberLoss(0.05);
   auto scaling = new ceres::ScaledLoss(nullptr, lambda_ * lambda_, ceres::DO_NOT_TAKE_OWNERSHIP);
 
-  std::vector<unsigned int> c(locations_.size(), 0);
+  std::vector<unsigned int> c(locations.size(), 0);
 
   // Create residual blocks and compute initial irradiance estimates
-  for (const auto& t : dataset_->getExposureTimes()) {
-    for (const auto& image : dataset_->getImages(t)) {
-      for (size_t i = 0; i < locations_.size(); ++i) {
+  for (const auto& t : dataset.getExposureTimes()) {
+    for (const auto& image : dataset.getImages(t)) {
+      for (size_t i = 0; i < locations.size(); ++i) {
         auto lt = std::log(t);
-        auto p = image.at<uint8_t>(locations_[i]);
+        auto p = image.at<uint8_t>(locations[i]);
         if (isPixelValid(p)) {
           problem.AddResidualBlock(new ceres::AutoDiffCostFunction<Residual, 1, 1, 256>(new Residual{lt, p}), loss,
-                                   &X_[i], U);
-          X_[i] += U_(p) - lt;
+                                   &X[i], U);
+          X[i] += state.U(p) - lt;
           c[i] += 1;
         }
       }
@@ -121,8 +138,8 @@ cv::Mat DebevecCalibration::calibrateChannel(const Dataset& dataset) {
   problem.AddResidualBlock(
       new ceres::AutoDiffCostFunction<RegularizationResidual, 254, 256>(new RegularizationResidual), scaling, U);
 
-  for (size_t i = 0; i < locations_.size(); ++i)
-    X_[i] /= c[i];
+  for (size_t i = 0; i < locations.size(); ++i)
+    X[i] /= c[i];
 
   ceres::Solver::Options options;
   options.max_num_iterations = max_num_iterations_;
@@ -137,30 +154,30 @@ cv::Mat DebevecCalibration::calibrateChannel(const Dataset& dataset) {
   ceres::Solver::Summary summary;
   ceres::Solve(options, &problem, &summary);
 
-  printFooter();
-
   if (verbosity_ > 1)
     std::cout << summary.FullReport() << std::endl;
 
   cv::Mat response;
-  U_.convertTo(response, CV_32F);
+  state.U.convertTo(response, CV_32F);
   cv::exp(response, response);
 
   return response;
 }
 
-void DebevecCalibration::selectPixels() {
-  BOOST_ASSERT(dataset_ != nullptr);
+void DebevecCalibration::selectPixels(State& state) const {
+  BOOST_ASSERT(state.dataset != nullptr);
 
-  locations_.clear();
-  auto times = dataset_->getExposureTimes();
+  const auto& dataset = *state.dataset;
+  auto& locations = state.locations;
+  locations.clear();
+  auto times = dataset.getExposureTimes();
 
   const int M = min_samples_;
   std::vector<int> hist(256, 0);
 
   for (size_t i = 0; i < times.size(); ++i) {
     auto t = times[i];
-    auto image = dataset_->getImages(t)[0];
+    auto image = dataset.getImages(t)[0];
 
     cv::Mat indices;
     cv::Mat flat = image.reshape(1, 1);
@@ -179,10 +196,10 @@ void DebevecCalibration::selectPixels() {
           --x;  // to repeat this iteration again
           break;
         }
-        locations_.push_back(index);
+        locations.push_back(index);
         for (size_t j = i; j < times.size(); ++j) {
           auto t = times[j];
-          auto p = dataset_->getImages(t)[0].at<uint8_t>(index);
+          auto p = dataset.getImages(t)[0].at<uint8_t>(index);
           if (!isPixelValid(p))
             continue;
           ++hist[p];
@@ -195,9 +212,9 @@ void DebevecCalibration::selectPixels() {
   }
 }
 
-void DebevecCalibration::visualizeProgress() {
+void DebevecCalibration::visualizeProgress(const State& state) const {
   cv::Mat response;
-  U_.convertTo(response, CV_32F);
+  state.U.convertTo(response, CV_32F);
   cv::exp(response, response);
 
   cv::Mat canvas(512, 512, CV_8UC3);
@@ -212,21 +229,21 @@ void DebevecCalibration::visualizeProgress() {
   float x_scale = static_cast<float>(canvas.size().width) / 256;
   float y_scale = static_cast<float>(canvas.size().height) / 1.0;
 
-  for (const auto& t : dataset_->getExposureTimes()) {
-    for (const auto& image : dataset_->getImages(t)) {
-      for (size_t i = 0; i < locations_.size(); ++i) {
-        auto p = image.at<uint8_t>(locations_[i]);
+  for (const auto& t : state.dataset->getExposureTimes()) {
+    for (const auto& image : state.dataset->getImages(t)) {
+      for (size_t i = 0; i < state.locations.size(); ++i) {
+        auto p = image.at<uint8_t>(state.locations[i]);
         if (isPixelValid(p)) {
-          auto v = std::exp(X_[i]) * t;
+          auto v = std::exp(state.X[i]) * t;
           cv::circle(canvas, cv::Point(p * x_scale, canvas.size().height - (v - min) / (max - min) * y_scale),
-                     std::ceil(x_scale), utils::colors::BGR_LIGHT[channel_], -1);
+                     std::ceil(x_scale), utils::colors::BGR_LIGHT[state.channel], -1);
         }
       }
     }
   }
 
-  utils::plotRadiometricResponse(response, canvas, utils::colors::BGR[channel_]);
-  imshow_(canvas);
+  utils::plotRadiometricResponse(response, canvas, utils::colors::BGR[state.channel]);
+  visualize(state.channel, canvas);
 }
 
 void DebevecCalibration::setMinSamplesPerIntensityLevel(unsigned int min_samples) {
@@ -40,23 +40,17 @@ class DebevecCalibration : public Calibration {
   }
 
  protected:
-  virtual cv::Mat calibrateChannel(const Dataset& data) override;
+  virtual cv::Mat calibrateChannel(const Dataset& data, int channel) const override;
 
  private:
-  void selectPixels();
+  struct State;
 
-  void visualizeProgress();
+  void selectPixels(State& state) const;
+
+  void visualizeProgress(const State& state) const;
 
   unsigned int min_samples_ = 5;
   double lambda_ = 20;
 
-  const Dataset* dataset_ = nullptr;
-  std::vector<int> locations_;
-
-  // Irradiances to optimize
-  std::vector<double> X_;
-  // Model parameters to optimize
-  cv::Mat_<double> U_;
-
   friend struct CeresIterationCallback;
 };
@@ -20,136 +20,373 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <boost/format.hpp>
+
 #include "engel_calibration.h"
+#include "observation_index.h"
 
 #include "utils/colors.h"
 #include "utils/plot_radiometric_response.h"
 
-cv::Mat EngelCalibration::calibrateChannel(const Dataset& dataset) {
-  dataset_ = &dataset;
-  converged_ = false;
-  energy_ = 0;
-  delta_ = 0;
-  scale_ = 1.0;
+namespace {
+
+/** Split \a total work items into contiguous chunks for reductions.
+  * Each chunk accumulates its own partial result and partial results are combined in a fixed order afterwards, so the
+  * outcome does not depend on thread scheduling. A few chunks per thread are used to balance the load. */
+int getNumChunks(size_t total) {
+  return static_cast<int>(std::min<size_t>(total, std::max(1, cv::getNumThreads()) * 4));
+}
+
+cv::Range getChunk(int chunk, int num_chunks, size_t total) {
+  return cv::Range(static_cast<int>(total * chunk / num_chunks), static_cast<int>(total * (chunk + 1) / num_chunks));
+}
+
+/** Parallel loop body that updates irradiance of a range of pixels (Eqn. 8) from their observations. */
+class IrradianceBody : public cv::ParallelLoopBody {
+ public:
+  IrradianceBody(const ObservationIndex& index, const double* U, std::vector<double>& B)
+  : index_(index), U_(U), B_(B) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const auto& offsets = index_.pixel_offsets;
+    const auto intensities = index_.pixel_intensities.data();
+    const auto images = index_.pixel_images.data();
+    const auto times = index_.exposure_times.data();
+    for (int i = range.start; i < range.end; ++i) {
+      double b = 0;
+      for (size_t j = offsets[i]; j < offsets[i + 1]; ++j)
+        b += U_[intensities[j]] * times[images[j]];
+      // Pixels without valid observations get zero irradiance
+      B_[i] = index_.sum_t2[i] > 0 ? b / index_.sum_t2[i] : 0.0;
+    }
+  }
+
+ private:
+  const ObservationIndex& index_;
+  const double* U_;
+  std::vector<double>& B_;
+};
+
+/** Parallel loop body that updates the inverse response at a range of intensities (Eqn. 7) from their observations. */
+class InverseResponseBody : public cv::ParallelLoopBody {
+ public:
+  InverseResponseBody(const ObservationIndex& index, const std::vector<double>& B, double* U)
+  : index_(index), B_(B), U_(U) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const auto& offsets = index_.intensity_offsets;
+    const auto pixels = index_.intensity_pixels.data();
+    const auto images = index_.intensity_images.data();
+    const auto times = index_.exposure_times.data();
+    for (int k = range.start; k < range.end; ++k) {
+      double sum = 0;
+      for (size_t j = offsets[k]; j < offsets[k + 1]; ++j)
+        sum += times[images[j]] * B_[pixels[j]];
+      U_[k] = sum / static_cast<double>(offsets[k + 1] - offsets[k]);
+    }
+  }
+
+ private:
+  const ObservationIndex& index_;
+  const std::vector<double>& B_;
+  double* U_;
+};
+
+/** Parallel loop body that accumulates squared residuals of observations over chunks of pixels. */
+class EnergyBody : public cv::ParallelLoopBody {
+ public:
+  EnergyBody(const ObservationIndex& index, const std::vector<double>& B, const double* U, int num_chunks,
+             std::vector<long double>& energies)
+  : index_(index), B_(B), U_(U), num_chunks_(num_chunks), energies_(energies) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const auto& offsets = index_.pixel_offsets;
+    const auto intensities = index_.pixel_intensities.data();
+    const auto images = index_.pixel_images.data();
+    const auto times = index_.exposure_times.data();
+    for (int chunk = range.start; chunk < range.end; ++chunk) {
+      long double energy = 0;
+      auto pixels = getChunk(chunk, num_chunks_, index_.getNumPixels());
+      for (int i = pixels.start; i < pixels.end; ++i) {
+        double pixel_energy = 0;
+        for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+          const double r = U_[intensities[j]] - times[images[j]] * B_[i];
+          pixel_energy += r * r;
+        }
+        energy += pixel_energy;
+      }
+      energies_[chunk] = energy;
+    }
+  }
+
+ private:
+  const ObservationIndex& index_;
+  const std::vector<double>& B_;
+  const double* U_;
+  int num_chunks_;
+  std::vector<long double>& energies_;
+};
+
+/** Anderson acceleration (type II) of a fixed-point iteration u <- G(u) on vectors stored in cv::Mat.
+  * Keeps differences of the last few residuals f = G(u) - u and of the map values, and extrapolates the next iterate
+  * as an affine combination of the recent map values that minimizes the linearized residual. Elements that are not
+  * finite (e.g. inverse response at intensities without observations) do not take part in the extrapolation, they
+  * keep the values of the map. */
+class AndersonAcceleration {
+ public:
+  explicit AndersonAcceleration(unsigned int memory)
+  : memory_(memory) {}
+
+  /** Compute the next iterate given the current iterate \a u and the map value \a g = G(u) (CV_64F). */
+  cv::Mat extrapolate(const cv::Mat& u, const cv::Mat& g) {
+    cv::Mat f = g - u;
+    zeroNonFinite(f);
+    cv::Mat g_finite = g.clone();
+    zeroNonFinite(g_finite);
+    if (!f_.empty()) {
+      dF_.push_back(f - f_);
+      dG_.push_back(g_finite - g_);
+      if (dF_.size() > memory_) {
+        dF_.pop_front();
+        dG_.pop_front();
+      }
+    }
+    f_ = f;
+    g_ = g_finite;
+    if (dF_.empty())
+      return g.clone();
+
+    // Least squares min ||f - dF * gamma|| through (slightly regularized) normal equations, the system is tiny
+    const int m = static_cast<int>(dF_.size());
+    cv::Mat A(m, m, CV_64FC1), b(m, 1, CV_64FC1), gamma;
+    for (int i = 0; i < m; ++i) {
+      for (int j = i; j < m; ++j)
+        A.at<double>(i, j) = A.at<double>(j, i) = dF_[i].dot(dF_[j]);
+      b.at<double>(i) = dF_[i].dot(f);
+    }
+    const double trace = cv::trace(A)[0];
+    if (trace <= 0)
+      return g.clone();
+    A += cv::Mat::eye(m, m, CV_64FC1) * (1e-10 * trace);
+    if (!cv::solve(A, b, gamma, cv::DECOMP_SVD))
+      return g.clone();
+
+    cv::Mat next = g.clone();
+    for (int i = 0; i < m; ++i)
+      next -= gamma.at<double>(i) * dG_[i];
+    return next;
+  }
+
+  /** Forget the history, e.g. after a rejected extrapolation. */
+  void reset() {
+    dF_.clear();
+    dG_.clear();
+    f_.release();
+    g_.release();
+  }
+
+ private:
+  static void zeroNonFinite(cv::Mat& m) {
+    for (auto it = m.begin<double>(); it != m.end<double>(); ++it)
+      if (!std::isfinite(*it))
+        *it = 0.0;
+  }
+
+  size_t memory_;
+  std::deque<cv::Mat> dF_, dG_;
+  cv::Mat f_, g_;
+};
+
+}  // anonymous namespace
+
+/** Solver state of a single channel. */
+struct EngelCalibration::State {
+  State(const Dataset& dataset, unsigned char min_valid, unsigned char max_valid, int _channel,
+        const std::vector<int>& locations = {})
+  : index(dataset, min_valid, max_valid, locations), channel(_channel), B(index.getNumPixels()) {}
 
-  U_.create(1, 256, CV_64FC1);
+  ObservationIndex index;
+
+  int channel;
+  bool converged = false;
+  std::vector<double> B;  // irradiance of each pixel
+  cv::Mat U;              // inverse response
+
+  double energy = 0, delta = 0;
+  double scale = 1.0;
+};
+
+cv::Mat EngelCalibration::calibrateChannel(const Dataset& dataset, int channel) const {
+  cv::Mat U(1, 256, CV_64FC1);
   for (int i = 0; i < 256; ++i)
-    U_.at<double>(i) = (1.0 / 255.0) * i;
+    U.at<double>(i) = (1.0 / 255.0) * i;
+
+  const auto image_size = dataset.getImageSize();
+  const bool subsample = num_subsampled_pixels_ > 0 && num_subsampled_pixels_ < static_cast<size_t>(image_size.area());
+  if (subsample) {
+    auto locations = ObservationIndex::sampleStratified(image_size, num_subsampled_pixels_, channel);
+    State coarse(dataset, min_valid_, max_valid_, channel, locations);
+    coarse.U = U;
+    solve(coarse);
+    U = coarse.U;
+    if (!refine_) {
+      cv::Mat response;
+      U.convertTo(response, CV_32F);
+      return response;
+    }
+  }
+
+  State state(dataset, min_valid_, max_valid_, channel);
+  state.U = U.clone();
+  solve(state);
+
+  if (subsample) {
+    // Deviation of the subset solution, both curves normalized the same way as the final response
+    double deviation = 0;
+    const double u_max = U.at<double>(max_valid_), full_max = state.U.at<double>(max_valid_);
+    for (int k = min_valid_; k <= max_valid_; ++k)
+      deviation = std::max(deviation, std::abs(U.at<double>(k) / u_max - state.U.at<double>(k) / full_max));
+    printMessage(channel, boost::str(boost::format("subset solution deviates from full solution by %.6f") % deviation));
+  }
 
-  B_.create(dataset_->getImageSize(), CV_64FC1);
+  cv::Mat response;
+  state.U.convertTo(response, CV_32F);
+  return response;
+}
 
-  printHeader();
+void EngelCalibration::solve(State& state) const {
+  std::unique_ptr<AndersonAcceleration> anderson;
+  if (anderson_memory_ > 0)
+    anderson.reset(new AndersonAcceleration(anderson_memory_));
+  cv::Mat plain_U;  // inverse response of the last round before extrapolation
+  unsigned int num_extrapolations = 0, num_rejected = 0;
 
   unsigned int iteration = 0;
   while (iteration < max_num_iterations_) {
-    optimizeIrradiance();
-    auto e = computeEnergy();
-    if (iteration > 0) {
-      delta_ = energy_ - e;
-      if (delta_ < convergence_threshold_)
-        converged_ = true;
+    optimizeIrradiance(state);
+    auto e = computeEnergy(state);
+    if (!plain_U.empty()) {
+      // Safeguard: the plain update would not increase the energy, so neither should the extrapolated one
+      if (!(e <= state.energy)) {
+        state.U = plain_U;
+        anderson->reset();
+        optimizeIrradiance(state);
+        e = computeEnergy(state);
+        ++num_rejected;
+      }
+      plain_U.release();
     }
-    energy_ = e;
-    printIteration(++iteration, energy_, delta_, 'B');
+    if (iteration > 0)
+      state.delta = state.energy - e;
+    state.energy = e;
+    printIteration(state.channel, ++iteration, state.energy, state.delta, 'B');
 
-    optimizeInverseResponse();
-    e = computeEnergy();
-    delta_ = energy_ - e;
-    if (energy_ > 0 && delta_ < convergence_threshold_)
-      converged_ = true;
-    energy_ = e;
-    printIteration(++iteration, energy_, delta_, 'U');
+    cv::Mat U = state.U.clone();
+    optimizeInverseResponse(state);
+    e = computeEnergy(state);
+    state.delta = state.energy - e;
+    state.energy = e;
+    printIteration(state.channel, ++iteration, state.energy, state.delta, 'U');
 
-    rescale();
-    visualizeProgress();
+    rescale(state);
+    visualizeProgress(state);
 
-    if (converged_)
+    // The energy keeps decreasing with the accumulated scale long after the curve has settled, so convergence is
+    // judged by the change of the normalized inverse response over the round
+    if (computeMaxChange(U, state.U) < convergence_threshold_)
+      state.converged = true;
+
+    if (state.converged)
       break;
+
+    if (anderson) {
+      // Both iterates have U(128) = 1 and extrapolation is an affine combination, so the result is normalized too
+      plain_U = state.U;
+      state.U = anderson->extrapolate(U, plain_U);
+      ++num_extrapolations;
+    }
   }
 
-  printFooter();
-  visualizeProgress();
+  if (anderson)
+    printMessage(state.channel, boost::str(boost::format("%u iterations, %u of %u extrapolations rejected") %
+                                           iteration % num_rejected % num_extrapolations));
 
-  cv::Mat response;
-  U_.convertTo(response, CV_32F);
-  return response;
+  visualizeProgress(state);
 }
 
 void EngelCalibration::setConvergenceThreshold(double threshold) {
   convergence_threshold_ = threshold;
 }
 
-void EngelCalibration::optimizeInverseResponse() {
-  // Eqn. 7
-  sum_omega_k_.fill(0);
-  size_omega_k_.fill(0);
-
-  for (const auto& t : dataset_->getExposureTimes())
-    for (const auto& image : dataset_->getImages(t))
-      for (int i = 0; i < image.rows; ++i)
-        for (int j = 0; j < image.cols; ++j) {
-          const auto& p = image.at<uint8_t>(i, j);
-          sum_omega_k_[p] += t * B_.at<double>(i, j);
-          size_omega_k_[p] += 1;
-        }
+void EngelCalibration::setSubsampling(size_t num_pixels, bool refine) {
+  num_subsampled_pixels_ = num_pixels;
+  refine_ = refine;
+}
 
-  U_.setTo(0);
-  for (int k = min_valid_; k <= max_valid_; ++k)
-    U_.at<double>(k) = sum_omega_k_[k] /= size_omega_k_[k];
+void EngelCalibration::setAndersonAcceleration(unsigned int memory) {
+  anderson_memory_ = memory;
+}
+
+void EngelCalibration::optimizeInverseResponse(State& state) const {
+  // Eqn. 7
+  auto& U = state.U;
+  U.setTo(0);
+  cv::parallel_for_(cv::Range(min_valid_, max_valid_ + 1), InverseResponseBody(state.index, state.B, U.ptr<double>()));
 
-  double max = 2 * U_.at<double>(max_valid_) - U_.at<double>(max_valid_ - 1);
+  double max = 2 * U.at<double>(max_valid_) - U.at<double>(max_valid_ - 1);
   for (int k = max_valid_ + 1; k < 256; ++k)
-    U_.at<double>(k) = max;
+    U.at<double>(k) = max;
 }
 
-void EngelCalibration::optimizeIrradiance() {
+void EngelCalibration::optimizeIrradiance(State& state) const {
   // Eqn. 8
-  sum_t2_i_.create(dataset_->getImageSize());
-  sum_t2_i_.setTo(0);
-  B_.setTo(0);
-
-  for (const auto& t : dataset_->getExposureTimes())
-    for (const auto& image : dataset_->getImages(t))
-      for (int i = 0; i < image.rows; ++i)
-        for (int j = 0; j < image.cols; ++j) {
-          const auto& p = image.at<uint8_t>(i, j);
-          if (!isPixelValid(p))
-            continue;
-          B_.at<double>(i, j) += U_.at<double>(p) * t;
-          sum_t2_i_(i, j) += t * t;
-        }
-
-  cv::divide(B_, sum_t2_i_, B_);
+  cv::parallel_for_(cv::Range(0, static_cast<int>(state.index.getNumPixels())),
+                    IrradianceBody(state.index, state.U.ptr<double>(), state.B));
 }
 
-double EngelCalibration::computeEnergy() {
+double EngelCalibration::computeEnergy(const State& state) const {
+  const int num_chunks = getNumChunks(state.index.getNumPixels());
+  std::vector<long double> energies(num_chunks);
+  cv::parallel_for_(cv::Range(0, num_chunks), EnergyBody(state.index, state.B, state.U.ptr<double>(), num_chunks,
+                                                         energies));
   long double energy = 0;
-  long unsigned int num = 0;
-  for (const auto& t : dataset_->getExposureTimes())
-    for (const auto& image : dataset_->getImages(t))
-      for (int i = 0; i < image.rows; ++i)
-        for (int j = 0; j < image.cols; ++j)
-          if (isPixelValid(image.at<uint8_t>(i, j))) {
-            long double r = U_.at<double>(image.at<uint8_t>(i, j)) - t * B_.at<double>(i, j);
-            energy += r * r;
-            num += 1;
-          }
+  for (int chunk = 0; chunk < num_chunks; ++chunk)
+    energy += energies[chunk];
   // Scale the energy to account for all the rescalings that happened along the way
-  return static_cast<double>(std::sqrt(energy / num) / scale_);
+  return static_cast<double>(std::sqrt(energy / state.index.getNumObservations()) / state.scale);
 }
 
-void EngelCalibration::rescale() {
-  auto scale = 1.0 / U_.at<double>(128);
-  cv::multiply(U_, scale, U_);
-  cv::multiply(B_, scale, B_);
+void EngelCalibration::rescale(State& state) const {
+  auto scale = 1.0 / state.U.at<double>(128);
+  cv::multiply(state.U, scale, state.U);
+  for (auto& b : state.B)
+    b *= scale;
   // Remember the total scale relative to the initial energy
-  scale_ *= scale;
+  state.scale *= scale;
+}
+
+double EngelCalibration::computeMaxChange(const cv::Mat& previous, const cv::Mat& current) const {
+  double change = 0;
+  for (int k = min_valid_; k <= max_valid_; ++k) {
+    const double d = std::abs(current.at<double>(k) - previous.at<double>(k));
+    // Intensities without observations have no inverse response
+    if (std::isfinite(d))
+      change = std::max(change, d);
+  }
+  return change;
 }
 
-void EngelCalibration::visualizeProgress() {
+void EngelCalibration::visualizeProgress(const State& state) const {
   if (imshow_) {
     cv::Mat response;
-    U_.convertTo(response, CV_32F);
-    imshow_(utils::plotRadiometricResponse(response, cv::Size(500, 500), utils::colors::BGR[channel_]));
+    state.U.convertTo(response, CV_32F);
+    visualize(state.channel,
+              utils::plotRadiometricResponse(response, cv::Size(500, 500), utils::colors::BGR[state.channel]));
   }
 }
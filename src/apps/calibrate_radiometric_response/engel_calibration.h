@@ -22,44 +22,60 @@
 
 #pragma once
 
-#include <array>
-
 #include "calibration.h"
 
 class EngelCalibration : public Calibration {
  public:
+  /** Set the convergence threshold.
+    * Calibration stops once a round of updates changes no element of the inverse response (normalized so that
+    * U(128) = 1) within the valid intensity range by more than \a threshold. */
   void setConvergenceThreshold(double threshold);
 
+  /** Calibrate on a subset of pixels first (coarse-to-fine calibration).
+    * The subset is selected with stratified random sampling, so that it covers the whole image. If \a refine is set,
+    * the subset solution is used as a warm start for calibration on all pixels and its deviation from the full solution
+    * is reported. Otherwise the subset solution is the result.
+    * \param[in] num_pixels approximate number of pixels in the subset (0 disables subsampling, default)
+    * \param[in] refine whether to refine the subset solution on all pixels */
+  void setSubsampling(size_t num_pixels, bool refine = true);
+
+  /** Accelerate convergence with Anderson extrapolation of the inverse response.
+    * One round of irradiance and inverse response updates is treated as a fixed-point map of the inverse response. The
+    * next inverse response is extrapolated from the last \a memory rounds rather than taken from the last one. An
+    * extrapolation that increases the energy above that of the last plain update is rejected in favor of the plain
+    * update and the history is reset, so the energy is still non-increasing.
+    * \param[in] memory number of previous rounds used for extrapolation (0 disables acceleration, default) */
+  void setAndersonAcceleration(unsigned int memory);
+
   virtual std::string getMethodName() const override {
     return "Engel";
   }
 
  protected:
-  virtual cv::Mat calibrateChannel(const Dataset& dataset) override;
+  virtual cv::Mat calibrateChannel(const Dataset& dataset, int channel) const override;
 
  private:
-  void optimizeInverseResponse();
+  struct State;
 
-  void optimizeIrradiance();
+  /** Alternate irradiance and inverse response updates until convergence, starting from the inverse response in the
+    * state. */
+  void solve(State& state) const;
 
-  double computeEnergy();
+  void optimizeInverseResponse(State& state) const;
 
-  void rescale();
+  void optimizeIrradiance(State& state) const;
 
-  void visualizeProgress();
+  double computeEnergy(const State& state) const;
 
-  const Dataset* dataset_ = nullptr;
+  void rescale(State& state) const;
 
-  bool converged_;
-  cv::Mat B_;  // irradiance
-  cv::Mat U_;  // inverse response
+  /** Largest absolute difference between two inverse responses within the valid intensity range. */
+  double computeMaxChange(const cv::Mat& previous, const cv::Mat& current) const;
 
-  double energy_, delta_;
-  double convergence_threshold_ = 1e-5;
-  double scale_;
+  void visualizeProgress(const State& state) const;
 
-  // Storage for temporary matrices to avoid re-allocation
-  cv::Mat_<double> sum_t2_i_;
-  std::array<double, 256> sum_omega_k_;
-  std::array<int, 256> size_omega_k_;
+  double convergence_threshold_ = 1e-5;
+  size_t num_subsampled_pixels_ = 0;
+  bool refine_ = true;
+  unsigned int anderson_memory_ = 0;
 };
@@ -0,0 +1,146 @@
+/******************************************************************************
+ * Copyright (c) 2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <radical/exceptions.h>
+
+#include "observation_index.h"
+
+namespace {
+
+/** Parallel loop body that counts (or stores) valid observations of a range of index pixels in pixel-major order. */
+class PixelIndexBody : public cv::ParallelLoopBody {
+ public:
+  PixelIndexBody(const std::vector<cv::Mat>& images, unsigned char min_valid, unsigned char max_valid,
+                 ObservationIndex& index, bool fill)
+  : images_(images), min_valid_(min_valid), max_valid_(max_valid), index_(index), fill_(fill) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const int cols = images_[0].cols;
+    for (int i = range.start; i < range.end; ++i) {
+      const int location = index_.locations.empty() ? i : index_.locations[i];
+      const int row = location / cols;
+      const int col = location % cols;
+      size_t offset = index_.pixel_offsets[i];
+      double sum_t2 = 0;
+      for (size_t n = 0; n < images_.size(); ++n) {
+        const auto p = images_[n].ptr<uint8_t>(row)[col];
+        if (p < min_valid_ || p > max_valid_)
+          continue;
+        if (fill_) {
+          index_.pixel_intensities[offset] = p;
+          index_.pixel_images[offset] = static_cast<uint16_t>(n);
+          sum_t2 += index_.exposure_times[n] * index_.exposure_times[n];
+        }
+        ++offset;
+      }
+      if (fill_)
+        index_.sum_t2[i] = sum_t2;
+      else
+        index_.pixel_offsets[i] = offset;  // number of observations, turned into offsets later
+    }
+  }
+
+ private:
+  const std::vector<cv::Mat>& images_;
+  unsigned char min_valid_, max_valid_;
+  ObservationIndex& index_;
+  bool fill_;
+};
+
+}  // anonymous namespace
+
+ObservationIndex::ObservationIndex(const Dataset& dataset, unsigned char min_valid, unsigned char max_valid)
+: ObservationIndex(dataset, min_valid, max_valid, {}) {}
+
+ObservationIndex::ObservationIndex(const Dataset& dataset, unsigned char min_valid, unsigned char max_valid,
+                                   const std::vector<int>& _locations)
+: locations(_locations) {
+  std::vector<cv::Mat> images;
+  for (const auto& t : dataset.getExposureTimes())
+    for (const auto& image : dataset.getImages(t)) {
+      images.push_back(image);
+      exposure_times.push_back(t);
+    }
+  if (images.empty())
+    throw radical::Exception("Dataset does not contain any images");
+  if (images.size() > std::numeric_limits<uint16_t>::max())
+    throw radical::Exception("Dataset contains too many images");
+
+  const size_t num_pixels = locations.empty() ? dataset.getImageSize().area() : locations.size();
+
+  // Pixel-major layout: count observations of each pixel, compute offsets, then store observations
+  const cv::Range pixels(0, static_cast<int>(num_pixels));
+  pixel_offsets.assign(num_pixels + 1, 0);
+  cv::parallel_for_(pixels, PixelIndexBody(images, min_valid, max_valid, *this, false));
+  size_t total = 0;
+  for (size_t i = 0; i <= num_pixels; ++i) {
+    const size_t count = pixel_offsets[i];
+    pixel_offsets[i] = total;
+    total += count;
+  }
+  pixel_intensities.resize(total);
+  pixel_images.resize(total);
+  sum_t2.resize(num_pixels);
+  cv::parallel_for_(pixels, PixelIndexBody(images, min_valid, max_valid, *this, true));
+
+  // Intensity-major layout (counting sort of the above, keeps pixels sorted within each intensity)
+  intensity_offsets.assign(257, 0);
+  for (const auto& p : pixel_intensities)
+    ++intensity_offsets[p + 1];
+  for (int k = 0; k < 256; ++k)
+    intensity_offsets[k + 1] += intensity_offsets[k];
+  std::vector<size_t> cursor(intensity_offsets.begin(), intensity_offsets.end() - 1);
+  intensity_pixels.resize(total);
+  intensity_images.resize(total);
+  for (size_t i = 0; i < num_pixels; ++i)
+    for (size_t j = pixel_offsets[i]; j < pixel_offsets[i + 1]; ++j) {
+      const size_t position = cursor[pixel_intensities[j]]++;
+      intensity_pixels[position] = static_cast<int32_t>(i);
+      intensity_images[position] = pixel_images[j];
+    }
+}
+
+std::vector<int> ObservationIndex::sampleStratified(cv::Size image_size, size_t num_pixels, unsigned int seed) {
+  std::vector<int> locations;
+  if (num_pixels == 0 || image_size.area() == 0)
+    return locations;
+  const double cell = std::max(1.0, std::sqrt(static_cast<double>(image_size.area()) / num_pixels));
+  const int cols = static_cast<int>(std::ceil(image_size.width / cell));
+  const int rows = static_cast<int>(std::ceil(image_size.height / cell));
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> offset(0.0, 1.0);
+  for (int r = 0; r < rows; ++r)
+    for (int c = 0; c < cols; ++c) {
+      const int x = std::min(image_size.width - 1, static_cast<int>((c + offset(rng)) * cell));
+      const int y = std::min(image_size.height - 1, static_cast<int>((r + offset(rng)) * cell));
+      locations.push_back(y * image_size.width + x);
+    }
+  // Clamping at the borders may select the same pixel twice
+  std::sort(locations.begin(), locations.end());
+  locations.erase(std::unique(locations.begin(), locations.end()), locations.end());
+  return locations;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright (c) 2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "dataset.h"
+
+/** Compact index of valid observations in a single-channel dataset, the sufficient statistics of Engel calibration.
+  *
+  * An observation is a pixel with a valid intensity in one of the images. Observations are stored twice in compressed
+  * sparse row (CSR) layout: grouped by pixel (for the irradiance update and the energy) and grouped by intensity (for
+  * the inverse response update). Per-pixel sums of squared exposure times are precomputed. Once the index is built,
+  * iterations only sweep these arrays linearly and their cost scales with the number of valid observations rather than
+  * with the size of the dataset. */
+struct ObservationIndex {
+  /** Build the index from all pixels of a given dataset.
+    * \param[in] dataset single-channel dataset
+    * \param[in] min_valid minimum valid intensity
+    * \param[in] max_valid maximum valid intensity */
+  ObservationIndex(const Dataset& dataset, unsigned char min_valid, unsigned char max_valid);
+
+  /** Build the index from a subset of pixels of a given dataset.
+    * \param[in] dataset single-channel dataset
+    * \param[in] min_valid minimum valid intensity
+    * \param[in] max_valid maximum valid intensity
+    * \param[in] locations linear indices of the pixels to include, pixel i of the index is image pixel locations[i] */
+  ObservationIndex(const Dataset& dataset, unsigned char min_valid, unsigned char max_valid,
+                   const std::vector<int>& locations);
+
+  /** Select pixels with stratified random sampling: the image is divided into a regular grid with approximately
+    * \a num_pixels cells and one random pixel is taken from each cell.
+    * \returns linear indices of the selected pixels in ascending order */
+  static std::vector<int> sampleStratified(cv::Size image_size, size_t num_pixels, unsigned int seed);
+
+  size_t getNumPixels() const {
+    return sum_t2.size();
+  }
+
+  size_t getNumObservations() const {
+    return pixel_intensities.size();
+  }
+
+  std::vector<double> exposure_times;  ///< exposure time of each image
+  std::vector<int> locations;          ///< linear indices of the included image pixels (empty if all are included)
+
+  // Observations grouped by pixel, observations of pixel i are [pixel_offsets[i], pixel_offsets[i + 1])
+  std::vector<size_t> pixel_offsets;
+  std::vector<uint8_t> pixel_intensities;
+  std::vector<uint16_t> pixel_images;
+  std::vector<double> sum_t2;  ///< sum of squared exposure times of valid observations of each pixel
+
+  // Observations grouped by intensity (and sorted by pixel within a group), observations with intensity k are
+  // [intensity_offsets[k], intensity_offsets[k + 1])
+  std::vector<size_t> intensity_offsets;
+  std::vector<int32_t> intensity_pixels;
+  std::vector<uint16_t> intensity_images;
+};
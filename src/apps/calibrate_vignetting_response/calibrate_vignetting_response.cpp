@@ -21,15 +21,19 @@
  ******************************************************************************/
 
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <radical/bspline_vignetting_model.h>
+#include <radical/compact_nonparametric_vignetting_model.h>
 #include <radical/exceptions.h>
 #include <radical/nonparametric_vignetting_model.h>
 #include <radical/polynomial_vignetting_model.h>
+#include <radical/radial_vignetting_model.h>
 #include <radical/radiometric_response.h>
 #include <radical/vignetting_response.h>
 
@@ -56,6 +60,11 @@ class Options : public OptionsBase {
   unsigned int num_samples = 100;
   unsigned int exposure = 20;
   std::string model = "nonparametric";
+  unsigned int degree = 3;
+  unsigned int stride = 8;
+  unsigned int profile_size = radical::RadialVignettingModel::DEFAULT_PROFILE_SIZE;
+  std::string control_grid = "16x12";
+  cv::Size control_grid_size;
   bool fixed_center = false;
 
  protected:
@@ -71,6 +80,14 @@ class Options : public OptionsBase {
                        "Number of samples to collect for each pixel (default: 100)");
     desc.add_options()("exposure,e", po::value<unsigned int>(&exposure), "Initial exposure time (default: 20)");
     desc.add_options()("model,m", po::value<std::string>(&model), "Vignetting model type (default: nonparametric)");
+    desc.add_options()("degree,d", po::value<unsigned int>(&degree),
+                       "Degree of the polynomial vignetting model, from 1 to 6 (default: 3)");
+    desc.add_options()("stride", po::value<unsigned int>(&stride),
+                       "Maximum distance between grid nodes of the compact nonparametric vignetting model (default: 8)");
+    desc.add_options()("profile-size", po::value<unsigned int>(&profile_size),
+                       "Number of samples in the profile of the radial vignetting model (default: 256)");
+    desc.add_options()("control-grid", po::value<std::string>(&control_grid),
+                       "Number of control points of the B-spline vignetting model, COLSxROWS (default: 16x12)");
     desc.add_options()("fixed-center,c", po::bool_switch(&fixed_center),
                        "Fix model center of symmetry to image center (only for polynomial model)");
   }
@@ -85,9 +102,12 @@ class Options : public OptionsBase {
   void printHelp() override {
     std::cout << "Usage: calibrate_vignetting_response [options] <camera>" << std::endl;
     std::cout << "" << std::endl;
-    std::cout << "Calibrate vignetting response of a camera. Two vignetting models are available:" << std::endl;
+    std::cout << "Calibrate vignetting response of a camera. Five vignetting models are available:" << std::endl;
     std::cout << " * nonparametric" << std::endl;
+    std::cout << " * compact (nonparametric, stored on a coarse grid)" << std::endl;
     std::cout << " * polynomial" << std::endl;
+    std::cout << " * radial (radially symmetric, stored as a lookup table)" << std::endl;
+    std::cout << " * bspline (smooth surface defined by a coarse grid of control points)" << std::endl;
     std::cout << "" << std::endl;
   }
 
@@ -97,11 +117,31 @@ class Options : public OptionsBase {
       throw boost::program_options::error(
           "unable to calibrate polynomial vignetting model because the app was compiled without Ceres");
 #endif
-    if (model != "nonparametric" && model != "polynomial")
+    if (model != "nonparametric" && model != "compact" && model != "polynomial" && model != "radial" &&
+        model != "bspline")
       throw boost::program_options::error("unknown vignetting model type " + model);
+    if (degree < 1 || degree > 6)
+      throw boost::program_options::error("degree of polynomial vignetting model should be from 1 to 6");
+    if (stride < 1)
+      throw boost::program_options::error("stride of compact vignetting model should be positive");
+    if (profile_size < 2)
+      throw boost::program_options::error("profile of radial vignetting model should have at least 2 samples");
+    char separator = 0;
+    std::stringstream(control_grid) >> control_grid_size.width >> separator >> control_grid_size.height;
+    if (separator != 'x' || control_grid_size.width < 4 || control_grid_size.height < 4)
+      throw boost::program_options::error("control grid of B-spline vignetting model should be at least 4x4");
   }
 };
 
+#ifdef HAVE_CERES
+template <unsigned int Degree>
+radical::VignettingModel::Ptr fitAndPlotPolynomialModel(const cv::Mat& data, bool fixed_center, cv::Mat& plot) {
+  auto model = fitPolynomialModel<Degree>(data, fixed_center, 50, false);
+  plot = plotPolynomialVignettingModel(*model);
+  return model;
+}
+#endif
+
 int main(int argc, const char** argv) {
   Options options;
   if (!options.parse(argc, argv))
@@ -224,11 +264,34 @@ int main(int argc, const char** argv) {
 
   if (options.model == "nonparametric") {
     model.reset(new radical::NonparametricVignettingModel(data));
+  } else if (options.model == "compact") {
+    model = radical::CompactNonparametricVignettingModel::fromDense(data, options.stride);
+  } else if (options.model == "radial") {
+    model = radical::RadialVignettingModel::fromDense(data, options.profile_size);
+  } else if (options.model == "bspline") {
+    model = radical::BSplineVignettingModel::fromDense(data, options.control_grid_size);
 #ifdef HAVE_CERES
   } else if (options.model == "polynomial") {
-    auto poly_model = fitPolynomialModel(data, options.fixed_center, 50, false);
-    plot = plotPolynomialVignettingModel(*poly_model);
-    model = poly_model;
+    switch (options.degree) {
+      case 1:
+        model = fitAndPlotPolynomialModel<1>(data, options.fixed_center, plot);
+        break;
+      case 2:
+        model = fitAndPlotPolynomialModel<2>(data, options.fixed_center, plot);
+        break;
+      case 3:
+        model = fitAndPlotPolynomialModel<3>(data, options.fixed_center, plot);
+        break;
+      case 4:
+        model = fitAndPlotPolynomialModel<4>(data, options.fixed_center, plot);
+        break;
+      case 5:
+        model = fitAndPlotPolynomialModel<5>(data, options.fixed_center, plot);
+        break;
+      case 6:
+        model = fitAndPlotPolynomialModel<6>(data, options.fixed_center, plot);
+        break;
+    }
 #endif
   }
 
@@ -32,6 +32,7 @@ using ceres::Problem;
 using ceres::Solve;
 using ceres::Solver;
 
+template <unsigned int Degree>
 struct Residual {
   double x_;
   double y_;
@@ -47,39 +48,45 @@ struct Residual {
     auto dx = c[0] - T(x_);
     auto dy = c[1] - T(y_);
     auto r_2 = dx * dx + dy * dy;
-    auto r_4 = r_2 * r_2;
-    auto r_6 = r_4 * r_2;
-    auto v = T(1.0 + b[0] * r_2 + b[1] * r_4 + b[2] * r_6);
+    // Horner's scheme, the loop has a compile-time trip count and is unrolled
+    T p = b[Degree - 1];
+    for (int j = static_cast<int>(Degree) - 2; j >= 0; --j)
+      p = p * r_2 + b[j];
+    auto v = T(1.0) + p * r_2;
     residual[0] = T(i_) - v;
     return true;
   }
 };
 
-radical::PolynomialVignettingModel<3>::Ptr fitPolynomialModel(cv::InputArray _data, bool fixed_center,
-                                                              unsigned int max_num_iterations, bool verbose) {
+template <unsigned int Degree>
+typename radical::PolynomialVignettingModel<Degree>::Ptr fitPolynomialModel(cv::InputArray _data, bool fixed_center,
+                                                                           unsigned int max_num_iterations,
+                                                                           bool verbose) {
   cv::Mat_<cv::Vec3f> data = _data.getMat();
-  cv::Mat coeff(1, 5, CV_64FC3);
+  cv::Mat coeff(1, Degree + 2, CV_64FC3);
   for (size_t i = 0; i < 3; ++i) {
     double c[2];
-    double b[3];
+    double b[Degree];
 
     c[0] = data.cols / 2;
     c[1] = data.rows / 2;
     int W = 640 / data.cols;
-    b[0] = -7.5e-06 * std::pow(W, 2);
-    b[1] = 5e-11 * std::pow(W, 4);
-    b[2] = -2e-16 * std::pow(W, 6);
+    // Initial guess for the first three coefficients is typical for consumer cameras, higher order terms start at zero
+    const double b_init[] = {-7.5e-06 * std::pow(W, 2), 5e-11 * std::pow(W, 4), -2e-16 * std::pow(W, 6)};
+    for (unsigned int j = 0; j < Degree; ++j)
+      b[j] = j < 3 ? b_init[j] : 0.0;
 
     Problem problem;
     auto loss = new CauchyLoss(0.5);
 
     problem.AddParameterBlock(c, 2);
-    problem.AddParameterBlock(b, 3);
+    problem.AddParameterBlock(b, Degree);
 
     for (int y = 0; y < data.rows; ++y)
       for (int x = 0; x < data.cols; ++x)
-        problem.AddResidualBlock(new AutoDiffCostFunction<Residual, 1, 2, 3>(new Residual{x, y, data(y, x)[i]}), loss,
-                                 c, b);
+        problem.AddResidualBlock(
+            new AutoDiffCostFunction<Residual<Degree>, 1, 2, Degree>(new Residual<Degree>{x, y, data(y, x)[i]}), loss,
+            c, b);
 
     problem.SetParameterLowerBound(c, 0, c[0] * 0.9);
     problem.SetParameterUpperBound(c, 0, c[0] * 1.1);
@@ -101,16 +108,28 @@ radical::PolynomialVignettingModel<3>::Ptr fitPolynomialModel(cv::InputArray _da
     else
       std::cout << summary.BriefReport() << std::endl;
 
-    std::cout << "Final cx: " << c[0] << " cy: " << c[1] << " b1: " << b[0] << " b2: " << b[1] << " b3: " << b[2]
-              << "\n";
+    std::cout << "Final cx: " << c[0] << " cy: " << c[1];
+    for (unsigned int j = 0; j < Degree; ++j)
+      std::cout << " b" << j + 1 << ": " << b[j];
+    std::cout << "\n";
     coeff.at<cv::Vec3d>(0, 0)[i] = c[0];
     coeff.at<cv::Vec3d>(0, 1)[i] = c[1];
-    coeff.at<cv::Vec3d>(0, 2)[i] = b[0];
-    coeff.at<cv::Vec3d>(0, 3)[i] = b[1];
-    coeff.at<cv::Vec3d>(0, 4)[i] = b[2];
+    for (unsigned int j = 0; j < Degree; ++j)
+      coeff.at<cv::Vec3d>(0, j + 2)[i] = b[j];
   }
 
-  return std::make_shared<radical::PolynomialVignettingModel<3>>(coeff, data.size());
+  return std::make_shared<radical::PolynomialVignettingModel<Degree>>(coeff, data.size());
 }
 
+#define INSTANTIATE_FIT_POLYNOMIAL_MODEL(Degree)                                                            \
+  template radical::PolynomialVignettingModel<Degree>::Ptr fitPolynomialModel<Degree>(cv::InputArray, bool, \
+                                                                                      unsigned int, bool);
+
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(1)
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(2)
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(3)
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(4)
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(5)
+INSTANTIATE_FIT_POLYNOMIAL_MODEL(6)
+
 #endif
@@ -26,6 +26,10 @@
 
 #include <radical/polynomial_vignetting_model.h>
 
-radical::PolynomialVignettingModel<3>::Ptr fitPolynomialModel(cv::InputArray data, bool fixed_center = false,
-                                                              unsigned int max_num_iterations = 50,
-                                                              bool verbose = false);
+/** Fit polynomial vignetting model of a given degree to dense vignetting data.
+  * Explicitly instantiated for \c Degree from 1 to 6. */
+template <unsigned int Degree>
+typename radical::PolynomialVignettingModel<Degree>::Ptr fitPolynomialModel(cv::InputArray data,
+                                                                           bool fixed_center = false,
+                                                                           unsigned int max_num_iterations = 50,
+                                                                           bool verbose = false);
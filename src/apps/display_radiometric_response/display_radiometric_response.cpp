@@ -69,10 +69,12 @@ int main(int argc, const char** argv) {
     return 1;
 
   radical::RadiometricResponse rr(options.r_response);
-  auto min_radiance = rr.inverseMap(cv::Vec3b(0, 0, 0));
-  auto max_radiance = rr.inverseMap(cv::Vec3b(255, 255, 255));
+  const uint16_t max_level = static_cast<uint16_t>((1 << rr.getBitDepth()) - 1);
+  auto min_radiance = rr.inverseMap(cv::Vec3w(0, 0, 0));
+  auto max_radiance = rr.inverseMap(cv::Vec3w(max_level, max_level, max_level));
 
   std::cout << "Loaded radiometric response from file \"" << options.r_response << "\"" << std::endl;
+  std::cout << "Bit depth: " << rr.getBitDepth() << std::endl;
   std::cout << "Irradiance range: " << min_radiance << " - " << max_radiance << std::endl;
 
   auto plot = utils::plotRadiometricResponse(rr);
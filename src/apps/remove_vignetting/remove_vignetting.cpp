@@ -31,6 +31,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <radical/mat_io.h>
+#include <radical/photometric_corrector.h>
 #include <radical/radiometric_response.h>
 #include <radical/vignetting_response.h>
 
@@ -49,6 +50,7 @@ struct Options : public OptionsBase {
   bool alternate = false;
   float scale = 0.7;
   bool save = false;
+  std::string cache_dir = "";
 
   void addOptions(boost::program_options::options_description& desc) override {
     namespace po = boost::program_options;
@@ -57,6 +59,8 @@ struct Options : public OptionsBase {
     desc.add_options()("scale,s", po::value<float>(&scale)->default_value(scale),
                        "Scale the cleared irradiance map before re-applying camera response function");
     desc.add_options()("save", po::bool_switch(&save), "Save the cleared image");
+    desc.add_options()("cache-dir", po::value<std::string>(&cache_dir),
+                       "Existing directory for persistent caching of vignetting responses");
   }
 
   void addPositional(boost::program_options::options_description& desc,
@@ -133,15 +137,15 @@ int main(int argc, const char** argv) {
   if (!options.parse(argc, argv))
     return 1;
 
-  radical::RadiometricResponse rr(options.crf);
-  radical::VignettingResponse vr(options.vgn);
+  auto rr = std::make_shared<radical::RadiometricResponse>(options.crf);
+  auto vr = std::make_shared<radical::VignettingResponse>(options.vgn);
+  if (!options.cache_dir.empty())
+    vr->setCacheDirectory(options.cache_dir);
+  radical::PhotometricCorrector corrector(rr, vr, options.scale);
 
   auto remove = [&](const cv::Mat& img) {
-    static cv::Mat tmp1, tmp2, img_cleared;
-    rr.inverseMap(img, tmp1);
-    cv::multiply(tmp1, options.scale, tmp1);
-    vr.remove(tmp1, tmp2);
-    rr.directMap(tmp2, img_cleared);
+    static cv::Mat img_cleared;
+    corrector.correct(img, img_cleared);
     return img_cleared;
   };
 
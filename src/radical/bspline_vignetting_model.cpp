@@ -0,0 +1,233 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <radical/bspline_vignetting_model.h>
+#include <radical/check.h>
+#include <radical/exceptions.h>
+
+#include "separable_fit.h"
+#include "vignetting_model_io.h"
+
+namespace {
+
+/// First token of the file header.
+const char* const TOKEN = "BSplineVignettingModel";
+
+/** Find the segment of a uniform cubic B-spline that contains a given parameter and compute the weights of the four
+  * control points that affect it. Parameters outside of the spline are clamped.
+  * \param[in] u spline parameter
+  * \param[in] num_points number of control points (at least 4)
+  * \param[out] index first control point of the segment
+  * \param[out] weights values of the basis functions */
+inline void computeBasis(float u, int num_points, int& index, float weights[4]) {
+  u = std::min(std::max(u, 0.0f), static_cast<float>(num_points - 3));
+  index = std::min(static_cast<int>(u), num_points - 4);
+  const float t = u - index, t2 = t * t, t3 = t2 * t, s = 1.0f - t;
+  weights[0] = s * s * s / 6.0f;
+  weights[1] = (3.0f * t3 - 6.0f * t2 + 4.0f) / 6.0f;
+  weights[2] = (-3.0f * t3 + 3.0f * t2 + 3.0f * t + 1.0f) / 6.0f;
+  weights[3] = t3 / 6.0f;
+}
+
+/** Basis of a range of pixels along one dimension (four control points per pixel). */
+struct Basis : radical::SeparableBasis {
+  Basis(int first, int num_pixels, float knot_scale, int num_points)
+  : SeparableBasis(num_pixels, num_points, 4) {
+    for (int p = 0; p < num_pixels; ++p)
+      computeBasis(knot_scale * (first + p), num_points, indices[p], &weights[4 * p]);
+  }
+};
+
+/** Parallel loop body that evaluates a range of control point rows at given columns (first pass of evaluateGrid). */
+class HorizontalPassBody : public cv::ParallelLoopBody {
+ public:
+  HorizontalPassBody(const cv::Mat& coefficients, const Basis& basis, cv::Mat& horizontal)
+  : coefficients_(coefficients), basis_(basis), horizontal_(horizontal) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    for (int row = range.start; row < range.end; ++row) {
+      auto in = coefficients_.ptr<float>(row);
+      auto out = horizontal_.ptr<float>(row);
+      for (int x = 0; x < horizontal_.cols; ++x) {
+        const float* p = in + 3 * basis_.indices[x];
+        const float* w = &basis_.weights[4 * x];
+        for (int c = 0; c < 3; ++c)
+          out[3 * x + c] = w[0] * p[c] + w[1] * p[3 + c] + w[2] * p[6 + c] + w[3] * p[9 + c];
+      }
+    }
+  }
+
+ private:
+  const cv::Mat& coefficients_;
+  const Basis& basis_;
+  cv::Mat& horizontal_;
+};
+
+/** Parallel loop body that blends image rows from horizontally evaluated control point rows (second pass). */
+class VerticalPassBody : public cv::ParallelLoopBody {
+ public:
+  VerticalPassBody(const cv::Mat& horizontal, const Basis& basis, cv::Mat& response)
+  : horizontal_(horizontal), basis_(basis), response_(response) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const int n = response_.cols * 3;
+    for (int row = range.start; row < range.end; ++row) {
+      const int index = basis_.indices[row];
+      const float* w = &basis_.weights[4 * row];
+      auto p0 = horizontal_.ptr<float>(index);
+      auto p1 = horizontal_.ptr<float>(index + 1);
+      auto p2 = horizontal_.ptr<float>(index + 2);
+      auto p3 = horizontal_.ptr<float>(index + 3);
+      auto out = response_.ptr<float>(row);
+      for (int i = 0; i < n; ++i)
+        out[i] = w[0] * p0[i] + w[1] * p1[i] + w[2] * p2[i] + w[3] * p3[i];
+    }
+  }
+
+ private:
+  const cv::Mat& horizontal_;
+  const Basis& basis_;
+  cv::Mat& response_;
+};
+
+}  // anonymous namespace
+
+namespace radical {
+
+BSplineVignettingModel::BSplineVignettingModel(cv::InputArray _coefficients, cv::Size image_size) {
+  setCoefficients(_coefficients, image_size);
+}
+
+BSplineVignettingModel::BSplineVignettingModel(const std::string& filename)
+: BSplineVignettingModel(static_cast<const BSplineVignettingModel&>(*readModelFile(filename, TOKEN, &read))) {}
+
+BSplineVignettingModel::Ptr BSplineVignettingModel::fromDense(cv::InputArray _response, cv::Size grid_size) {
+  Check("Dense vignetting response", _response).notEmpty().hasType(CV_32FC3);
+  auto response = _response.getMat();
+  if (grid_size.width < 4 || grid_size.height < 4)
+    throw Exception("B-spline vignetting model should have at least 4x4 control points");
+  if (grid_size.width > response.cols || grid_size.height > response.rows)
+    throw Exception("B-spline vignetting model can not have more control points than pixels");
+  const int cols = grid_size.width, rows = grid_size.height;
+  // Control points are the least-squares fit to the dense response (the tensor product spline is separable)
+  const Basis bx(0, response.cols, static_cast<float>(cols - 3) / (response.cols - 1), cols);
+  const Basis by(0, response.rows, static_cast<float>(rows - 3) / (response.rows - 1), rows);
+  auto coefficients = fitSeparable(response, bx, by);
+  return std::make_shared<BSplineVignettingModel>(coefficients, response.size());
+}
+
+VignettingModel::Ptr BSplineVignettingModel::read(const std::string& filename, std::ifstream& file,
+                                                  const std::string& header) {
+  return std::make_shared<BSplineVignettingModel>(mapCoefficients(filename, file), parseImageSize(header));
+}
+
+std::string BSplineVignettingModel::getName() const {
+  return "bspline";
+}
+
+void BSplineVignettingModel::save(const std::string& filename) const {
+  writeModelFile(filename, TOKEN, image_size_, coefficients_);
+}
+
+cv::Vec3f BSplineVignettingModel::operator()(const cv::Vec2f& p) const {
+  int ix, iy;
+  float wx[4], wy[4];
+  computeBasis(knot_scale_[0] * p[0], coefficients_.cols, ix, wx);
+  computeBasis(knot_scale_[1] * p[1], coefficients_.rows, iy, wy);
+  cv::Vec3f result(0, 0, 0);
+  for (int j = 0; j < 4; ++j) {
+    auto row = coefficients_.ptr<cv::Vec3f>(iy + j) + ix;
+    for (int i = 0; i < 4; ++i)
+      for (int c = 0; c < 3; ++c)
+        result[c] += wy[j] * wx[i] * row[i][c];
+  }
+  return result;
+}
+
+void BSplineVignettingModel::evaluateRow(int row, int col, int width, float scale, float* response,
+                                         bool reciprocal) const {
+  int iy;
+  float wy[4];
+  computeBasis(knot_scale_[1] * scale * row, coefficients_.rows, iy, wy);
+  const float* rows[4];
+  for (int j = 0; j < 4; ++j)
+    rows[j] = coefficients_.ptr<float>(iy + j);
+  // Vertically combined control points of the current segment
+  float columns[12];
+  int cached = -1;
+  const float x_scale = knot_scale_[0] * scale;
+  for (int x = 0; x < width; ++x) {
+    int ix;
+    float wx[4];
+    computeBasis(x_scale * (col + x), coefficients_.cols, ix, wx);
+    if (ix != cached) {
+      for (int i = 0; i < 12; ++i) {
+        const int offset = 3 * ix + i;
+        columns[i] = wy[0] * rows[0][offset] + wy[1] * rows[1][offset] + wy[2] * rows[2][offset] +
+                     wy[3] * rows[3][offset];
+      }
+      cached = ix;
+    }
+    for (int c = 0; c < 3; ++c) {
+      const float v = wx[0] * columns[c] + wx[1] * columns[3 + c] + wx[2] * columns[6 + c] + wx[3] * columns[9 + c];
+      response[3 * x + c] = reciprocal ? 1.0f / v : v;
+    }
+  }
+}
+
+void BSplineVignettingModel::evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray _response) const {
+  _response.create(roi.size(), CV_32FC3);
+  auto response = _response.getMat();
+  const Basis bx(roi.x, roi.width, knot_scale_[0] * scale, coefficients_.cols);
+  const Basis by(roi.y, roi.height, knot_scale_[1] * scale, coefficients_.rows);
+  cv::Mat horizontal(coefficients_.rows, roi.width, CV_32FC3);
+  HorizontalPassBody horizontal_pass(coefficients_, bx, horizontal);
+  cv::parallel_for_(cv::Range(0, coefficients_.rows), horizontal_pass);
+  VerticalPassBody vertical_pass(horizontal, by, response);
+  cv::parallel_for_(cv::Range(0, roi.height), vertical_pass);
+}
+
+void BSplineVignettingModel::setCoefficients(cv::InputArray coefficients, cv::Size image_size) {
+  image_size_ = image_size;
+  Check("B-spline vignetting model", coefficients).notEmpty().hasType(CV_32FC3);
+  coefficients_ = coefficients.getMat();
+  if (coefficients_.cols < 4 || coefficients_.rows < 4)
+    throw Exception("B-spline vignetting model should have at least 4x4 control points");
+  if (image_size.width < 2 || image_size.height < 2)
+    throw Exception("B-spline vignetting model should be valid for images of at least 2x2 pixels");
+  knot_scale_[0] = static_cast<float>(coefficients_.cols - 3) / (image_size.width - 1);
+  knot_scale_[1] = static_cast<float>(coefficients_.rows - 3) / (image_size.height - 1);
+}
+
+cv::Size BSplineVignettingModel::getImageSize() const {
+  return image_size_;
+}
+
+cv::Mat BSplineVignettingModel::getModelCoefficients() const {
+  return coefficients_;
+}
+
+}  // namespace radical
@@ -0,0 +1,341 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <radical/calibration_bundle.h>
+#include <radical/check.h>
+#include <radical/exceptions.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+const char MAGIC[8] = {'R', 'A', 'D', 'C', 'A', 'L', 'I', 'B'};
+
+/// Size of the file header and of a section table entry.
+const size_t ENTRY_SIZE = 64;
+
+/// Section type of strings (other sections store cv::Mat type).
+const int STRING_TYPE = -1;
+
+const char* const CAMERA_UID = "camera_uid";
+const char* const RESOLUTION = "resolution";
+const char* const RADIOMETRIC_RESPONSE = "radiometric_response";
+const char* const VIGNETTING_MODEL = "vignetting_model";
+const char* const VIGNETTING_COEFFICIENTS = "vignetting_coefficients";
+const char* const VIGNETTING_IMAGE_SIZE = "vignetting_image_size";
+
+/** Table-driven CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320). */
+class CRC32 {
+ public:
+  static uint32_t compute(const uint8_t* data, size_t size) {
+    static const CRC32 crc;
+    uint32_t c = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i)
+      c = crc.table_[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFF;
+  }
+
+ private:
+  CRC32() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      table_[i] = c;
+    }
+  }
+
+  uint32_t table_[256];
+};
+
+bool isLittleEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t*>(&one) == 1;
+}
+
+/** Reverse byte order of every element in a buffer. */
+void swapBytes(uint8_t* data, size_t size, size_t element_size) {
+  for (size_t i = 0; i + element_size <= size; i += element_size)
+    std::reverse(data + i, data + i + element_size);
+}
+
+void store(uint8_t* p, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i)
+    p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint64_t load(const uint8_t* p, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i)
+    value |= static_cast<uint64_t>(p[i]) << (8 * i);
+  return value;
+}
+
+void checkName(const std::string& name) {
+  if (name.empty() || name.size() > radical::CalibrationBundle::MAX_NAME_LENGTH)
+    throw radical::Exception("Calibration bundle section name should have 1 to 31 characters");
+}
+
+size_t align(size_t offset) {
+  const auto alignment = radical::CalibrationBundle::ALIGNMENT;
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // anonymous namespace
+
+namespace radical {
+
+const uint32_t CalibrationBundle::VERSION;
+const size_t CalibrationBundle::ALIGNMENT;
+const size_t CalibrationBundle::MAX_NAME_LENGTH;
+
+CalibrationBundle::CalibrationBundle() {}
+
+CalibrationBundle::CalibrationBundle(const std::string& filename) {
+  auto file = std::make_shared<MappedFile>(filename);
+  const uint8_t* data = file->data();
+  const size_t size = file->size();
+
+  if (size < ENTRY_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    throw SerializationException("File does not contain a calibration bundle", filename);
+  const auto version = load(data + 8, 4);
+  if (version > VERSION)
+    throw SerializationException("Calibration bundle was written by a newer version of the library", filename);
+  const auto num_sections = load(data + 12, 4);
+  if ((size - ENTRY_SIZE) / ENTRY_SIZE < num_sections)
+    throw SerializationException("Calibration bundle has a truncated section table", filename);
+  const uint8_t* table = data + ENTRY_SIZE;
+  if (CRC32::compute(table, num_sections * ENTRY_SIZE) != load(data + 16, 4))
+    throw SerializationException("Calibration bundle has a corrupted section table", filename);
+
+  for (size_t i = 0; i < num_sections; ++i) {
+    const uint8_t* entry = table + i * ENTRY_SIZE;
+    const char* name_begin = reinterpret_cast<const char*>(entry);
+    const std::string name(name_begin, std::find(name_begin, name_begin + MAX_NAME_LENGTH, '\0'));
+    const int type = static_cast<int32_t>(load(entry + 32, 4));
+    const auto rows = load(entry + 36, 4);
+    const auto cols = load(entry + 40, 4);
+    const auto crc = load(entry + 44, 4);
+    const auto offset = load(entry + 48, 8);
+    const auto payload_size = load(entry + 56, 8);
+    if (offset > size || size - offset < payload_size)
+      throw SerializationException("Calibration bundle has a truncated section \"" + name + "\"", filename);
+    if (CRC32::compute(data + offset, payload_size) != crc)
+      throw SerializationException("Calibration bundle has a corrupted section \"" + name + "\"", filename);
+
+    Section section;
+    section.type = type;
+    if (type == STRING_TYPE) {
+      section.text.assign(reinterpret_cast<const char*>(data + offset), payload_size);
+    } else {
+      const uint64_t max_dimension = std::numeric_limits<int>::max();
+      if (type < 0 || CV_MAT_DEPTH(type) > CV_64F || rows == 0 || cols == 0 || rows > max_dimension ||
+          cols > max_dimension || rows * cols * CV_ELEM_SIZE(type) != payload_size)
+        throw SerializationException("Calibration bundle has an invalid matrix in section \"" + name + "\"",
+                                     filename);
+      // The mapping is private, so byte order can be fixed in place
+      if (!isLittleEndian())
+        swapBytes(file->data() + offset, payload_size, CV_ELEM_SIZE1(type));
+      section.mat = wrapMappedData(file, offset, static_cast<int>(rows), static_cast<int>(cols), type);
+    }
+    sections_[name] = section;
+  }
+}
+
+void CalibrationBundle::save(const std::string& filename) const {
+  ReplacementFile output(filename);
+  auto& file = output.stream();
+  if (!output.is_open())
+    throw SerializationException("Failed to open file for writing calibration bundle", filename);
+
+  const bool swap = !isLittleEndian();
+  std::vector<uint8_t> header(ENTRY_SIZE, 0);
+  std::vector<uint8_t> table(sections_.size() * ENTRY_SIZE, 0);
+  std::vector<std::pair<const uint8_t*, size_t>> payloads;
+  std::vector<cv::Mat> swapped;
+
+  size_t offset = align(header.size() + table.size());
+  uint8_t* entry = table.data();
+  for (const auto& section : sections_) {
+    const auto& name = section.first;
+    const auto& s = section.second;
+    const uint8_t* payload;
+    size_t payload_size, rows, cols;
+    if (s.type == STRING_TYPE) {
+      payload = reinterpret_cast<const uint8_t*>(s.text.data());
+      payload_size = s.text.size();
+      rows = 1;
+      cols = payload_size;
+    } else {
+      payload = s.mat.data;
+      payload_size = s.mat.total() * s.mat.elemSize();
+      rows = s.mat.rows;
+      cols = s.mat.cols;
+      if (swap && s.mat.elemSize1() > 1) {
+        swapped.push_back(s.mat.clone());
+        swapBytes(swapped.back().data, payload_size, s.mat.elemSize1());
+        payload = swapped.back().data;
+      }
+    }
+    std::copy(name.begin(), name.end(), entry);
+    store(entry + 32, static_cast<uint32_t>(s.type), 4);
+    store(entry + 36, rows, 4);
+    store(entry + 40, cols, 4);
+    store(entry + 44, CRC32::compute(payload, payload_size), 4);
+    store(entry + 48, offset, 8);
+    store(entry + 56, payload_size, 8);
+    payloads.emplace_back(payload, payload_size);
+    offset = align(offset + payload_size);
+    entry += ENTRY_SIZE;
+  }
+
+  std::copy(MAGIC, MAGIC + sizeof(MAGIC), header.begin());
+  store(header.data() + 8, VERSION, 4);
+  store(header.data() + 12, sections_.size(), 4);
+  store(header.data() + 16, CRC32::compute(table.data(), table.size()), 4);
+
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  file.write(reinterpret_cast<const char*>(table.data()), table.size());
+  const std::string padding(ALIGNMENT, '\0');
+  for (const auto& payload : payloads) {
+    file.write(padding.data(), align(file.tellp()) - static_cast<size_t>(file.tellp()));
+    file.write(reinterpret_cast<const char*>(payload.first), payload.second);
+  }
+  if (!output.commit())
+    throw SerializationException("Failed to write calibration bundle", filename);
+}
+
+bool CalibrationBundle::has(const std::string& name) const {
+  return sections_.count(name) > 0;
+}
+
+std::vector<std::string> CalibrationBundle::getSectionNames() const {
+  std::vector<std::string> names;
+  for (const auto& section : sections_)
+    names.push_back(section.first);
+  return names;
+}
+
+void CalibrationBundle::setMat(const std::string& name, cv::InputArray _mat) {
+  auto mat = _mat.getMat();
+  checkName(name);
+  Check("Bundle section", mat).notEmpty().hasMaxDimensions(2);
+  Section section;
+  section.type = mat.type();
+  section.mat = mat.isContinuous() ? mat : mat.clone();
+  sections_[name] = section;
+}
+
+cv::Mat CalibrationBundle::getMat(const std::string& name) const {
+  const auto& section = find(name);
+  if (section.type == STRING_TYPE)
+    throw Exception("Calibration bundle section \"" + name + "\" does not hold a matrix");
+  return section.mat;
+}
+
+void CalibrationBundle::setString(const std::string& name, const std::string& value) {
+  checkName(name);
+  Section section;
+  section.type = STRING_TYPE;
+  section.text = value;
+  sections_[name] = section;
+}
+
+std::string CalibrationBundle::getString(const std::string& name) const {
+  const auto& section = find(name);
+  if (section.type != STRING_TYPE)
+    throw Exception("Calibration bundle section \"" + name + "\" does not hold a string");
+  return section.text;
+}
+
+void CalibrationBundle::remove(const std::string& name) {
+  sections_.erase(name);
+}
+
+void CalibrationBundle::setCameraUID(const std::string& uid) {
+  setString(CAMERA_UID, uid);
+}
+
+std::string CalibrationBundle::getCameraUID() const {
+  return has(CAMERA_UID) ? getString(CAMERA_UID) : "";
+}
+
+void CalibrationBundle::setResolution(cv::Size resolution) {
+  setSize(RESOLUTION, resolution);
+}
+
+cv::Size CalibrationBundle::getResolution() const {
+  return has(RESOLUTION) ? getSize(RESOLUTION) : cv::Size();
+}
+
+void CalibrationBundle::setRadiometricResponse(const RadiometricResponse& response) {
+  setMat(RADIOMETRIC_RESPONSE, response.getInverseResponse());
+}
+
+RadiometricResponse::Ptr CalibrationBundle::getRadiometricResponse(unsigned int forward_table_size) const {
+  if (!has(RADIOMETRIC_RESPONSE))
+    return nullptr;
+  return std::make_shared<RadiometricResponse>(getMat(RADIOMETRIC_RESPONSE), forward_table_size);
+}
+
+void CalibrationBundle::setVignettingModel(const VignettingModel& model) {
+  setString(VIGNETTING_MODEL, model.getName());
+  setMat(VIGNETTING_COEFFICIENTS, model.getModelCoefficients());
+  setSize(VIGNETTING_IMAGE_SIZE, model.getImageSize());
+}
+
+VignettingModel::Ptr CalibrationBundle::getVignettingModel() const {
+  if (!has(VIGNETTING_MODEL))
+    return nullptr;
+  const auto name = getString(VIGNETTING_MODEL);
+  auto model = VignettingModel::create(name, getMat(VIGNETTING_COEFFICIENTS), getSize(VIGNETTING_IMAGE_SIZE));
+  if (!model)
+    throw Exception("Calibration bundle has unsupported vignetting model \"" + name + "\"");
+  return model;
+}
+
+void CalibrationBundle::setSize(const std::string& name, cv::Size size) {
+  cv::Mat mat(1, 2, CV_32SC1);
+  mat.at<int>(0) = size.width;
+  mat.at<int>(1) = size.height;
+  setMat(name, mat);
+}
+
+cv::Size CalibrationBundle::getSize(const std::string& name) const {
+  cv::Mat size = getMat(name);
+  Check("Size", size).hasType(CV_32SC1).hasSize(2);
+  return {size.at<int>(0), size.at<int>(1)};
+}
+
+const CalibrationBundle::Section& CalibrationBundle::find(const std::string& name) const {
+  auto section = sections_.find(name);
+  if (section == sections_.end())
+    throw Exception("Calibration bundle does not have section \"" + name + "\"");
+  return section->second;
+}
+
+}  // namespace radical
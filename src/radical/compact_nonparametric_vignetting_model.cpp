@@ -0,0 +1,224 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+#include <radical/check.h>
+#include <radical/compact_nonparametric_vignetting_model.h>
+#include <radical/exceptions.h>
+
+#include "separable_fit.h"
+#include "vignetting_model_io.h"
+
+namespace {
+
+/// First token of the file header.
+const char* const TOKEN = "CompactNonparametricVignettingModel";
+
+/** Find the grid cell that contains a given grid coordinate and the position within the cell.
+  * Coordinates outside of the grid are clamped to its border. */
+inline void locate(float g, int num_nodes, int& index, float& t) {
+  g = std::min(std::max(g, 0.0f), static_cast<float>(num_nodes - 1));
+  index = std::min(static_cast<int>(g), num_nodes - 2);
+  t = g - index;
+}
+
+/** Basis of the linear interpolation of pixels from grid nodes along one dimension (\sa fitSeparable()). */
+radical::SeparableBasis computeInterpolationBasis(int num_pixels, int num_nodes) {
+  radical::SeparableBasis basis(num_pixels, num_nodes, 2);
+  const float spacing = static_cast<float>(num_pixels - 1) / (num_nodes - 1);
+  for (int p = 0; p < num_pixels; ++p) {
+    float t;
+    locate(p / spacing, num_nodes, basis.indices[p], t);
+    basis.weights[2 * p] = 1.0f - t;
+    basis.weights[2 * p + 1] = t;
+  }
+  return basis;
+}
+
+/** Parallel loop body that upsamples grid coefficients to a range of rows of a region of an image. */
+class UpsamplingBody : public cv::ParallelLoopBody {
+ public:
+  UpsamplingBody(const cv::Mat& coefficients, const cv::Rect& roi, float y_factor, const std::vector<int>& indices,
+                 const std::vector<float>& weights, cv::Mat& response)
+  : coefficients_(coefficients)
+  , roi_(roi)
+  , y_factor_(y_factor)
+  , indices_(indices)
+  , weights_(weights)
+  , response_(response) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const int n = roi_.width * 3;
+    std::vector<float> upper(n), lower(n);
+    int cached = -2;
+    for (int row = range.start; row < range.end; ++row) {
+      int index;
+      float t;
+      locate(y_factor_ * (roi_.y + row), coefficients_.rows, index, t);
+      if (index == cached + 1) {
+        upper.swap(lower);
+        upsample(index + 1, lower.data());
+      } else if (index != cached) {
+        upsample(index, upper.data());
+        upsample(index + 1, lower.data());
+      }
+      cached = index;
+      auto out = response_.ptr<float>(row);
+      for (int i = 0; i < n; ++i)
+        out[i] = upper[i] + t * (lower[i] - upper[i]);
+    }
+  }
+
+ private:
+  /** Interpolate a grid row horizontally to the columns of the region. */
+  void upsample(int grid_row, float* out) const {
+    auto in = coefficients_.ptr<float>(grid_row);
+    for (int x = 0; x < roi_.width; ++x) {
+      const float* a = in + 3 * indices_[x];
+      const float t = weights_[x];
+      for (int c = 0; c < 3; ++c)
+        out[3 * x + c] = a[c] + t * (a[3 + c] - a[c]);
+    }
+  }
+
+  const cv::Mat& coefficients_;
+  cv::Rect roi_;
+  float y_factor_;
+  const std::vector<int>& indices_;
+  const std::vector<float>& weights_;
+  cv::Mat& response_;
+};
+
+}  // anonymous namespace
+
+namespace radical {
+
+CompactNonparametricVignettingModel::CompactNonparametricVignettingModel(cv::InputArray _coefficients,
+                                                                         cv::Size image_size) {
+  setCoefficients(_coefficients, image_size);
+}
+
+CompactNonparametricVignettingModel::CompactNonparametricVignettingModel(const std::string& filename)
+: CompactNonparametricVignettingModel(
+      static_cast<const CompactNonparametricVignettingModel&>(*readModelFile(filename, TOKEN, &read))) {}
+
+CompactNonparametricVignettingModel::Ptr CompactNonparametricVignettingModel::fromDense(cv::InputArray _response,
+                                                                                        unsigned int stride) {
+  Check("Dense vignetting response", _response).notEmpty().hasType(CV_32FC3);
+  if (stride < 1)
+    throw Exception("Stride of compact nonparametric vignetting model should be positive");
+  auto response = _response.getMat();
+  if (response.cols < 2 || response.rows < 2)
+    throw Exception("Dense vignetting response should have at least 2x2 pixels");
+  // Enough nodes to have at most stride pixels between them
+  const int cols = std::max<int>((response.cols + stride - 2) / stride + 1, 2);
+  const int rows = std::max<int>((response.rows + stride - 2) / stride + 1, 2);
+  // The grid is the least-squares fit to the dense response (bilinear interpolation is separable)
+  auto coefficients = fitSeparable(response, computeInterpolationBasis(response.cols, cols),
+                                   computeInterpolationBasis(response.rows, rows));
+  return std::make_shared<CompactNonparametricVignettingModel>(coefficients, response.size());
+}
+
+VignettingModel::Ptr CompactNonparametricVignettingModel::read(const std::string& filename, std::ifstream& file,
+                                                               const std::string& header) {
+  return std::make_shared<CompactNonparametricVignettingModel>(mapCoefficients(filename, file),
+                                                               parseImageSize(header));
+}
+
+std::string CompactNonparametricVignettingModel::getName() const {
+  return "compact_nonparametric";
+}
+
+void CompactNonparametricVignettingModel::save(const std::string& filename) const {
+  writeModelFile(filename, TOKEN, image_size_, coefficients_);
+}
+
+cv::Vec3f CompactNonparametricVignettingModel::operator()(const cv::Vec2f& p) const {
+  int x, y;
+  float tx, ty;
+  locate(p[0] / spacing_[0], coefficients_.cols, x, tx);
+  locate(p[1] / spacing_[1], coefficients_.rows, y, ty);
+  auto upper = coefficients_.ptr<cv::Vec3f>(y) + x;
+  auto lower = coefficients_.ptr<cv::Vec3f>(y + 1) + x;
+  return (upper[0] * (1.0f - tx) + upper[1] * tx) * (1.0f - ty) + (lower[0] * (1.0f - tx) + lower[1] * tx) * ty;
+}
+
+void CompactNonparametricVignettingModel::evaluateRow(int row, int col, int width, float scale, float* response,
+                                                      bool reciprocal) const {
+  int y;
+  float ty;
+  locate(scale * row / spacing_[1], coefficients_.rows, y, ty);
+  auto upper = coefficients_.ptr<float>(y);
+  auto lower = coefficients_.ptr<float>(y + 1);
+  const float x_factor = scale / spacing_[0];
+  for (int i = 0; i < width; ++i) {
+    int x;
+    float tx;
+    locate(x_factor * (col + i), coefficients_.cols, x, tx);
+    for (int c = 0; c < 3; ++c) {
+      const float u = upper[3 * x + c] + tx * (upper[3 * x + 3 + c] - upper[3 * x + c]);
+      const float l = lower[3 * x + c] + tx * (lower[3 * x + 3 + c] - lower[3 * x + c]);
+      const float v = u + ty * (l - u);
+      response[3 * i + c] = reciprocal ? 1.0f / v : v;
+    }
+  }
+}
+
+void CompactNonparametricVignettingModel::evaluateGrid(const cv::Rect& roi, float scale,
+                                                       cv::OutputArray _response) const {
+  _response.create(roi.size(), CV_32FC3);
+  auto response = _response.getMat();
+  // Horizontal interpolation is the same for all rows
+  std::vector<int> indices(roi.width);
+  std::vector<float> weights(roi.width);
+  const float x_factor = scale / spacing_[0];
+  for (int x = 0; x < roi.width; ++x)
+    locate(x_factor * (roi.x + x), coefficients_.cols, indices[x], weights[x]);
+  UpsamplingBody body(coefficients_, roi, scale / spacing_[1], indices, weights, response);
+  cv::parallel_for_(cv::Range(0, roi.height), body);
+}
+
+void CompactNonparametricVignettingModel::setCoefficients(cv::InputArray coefficients, cv::Size image_size) {
+  image_size_ = image_size;
+  Check("Compact nonparametric vignetting model", coefficients).notEmpty().hasType(CV_32FC3);
+  coefficients_ = coefficients.getMat();
+  if (coefficients_.cols < 2 || coefficients_.rows < 2)
+    throw Exception("Compact nonparametric vignetting model should have at least 2x2 grid nodes");
+  if (image_size.width < 2 || image_size.height < 2)
+    throw Exception("Compact nonparametric vignetting model should be valid for images of at least 2x2 pixels");
+  spacing_[0] = static_cast<float>(image_size.width - 1) / (coefficients_.cols - 1);
+  spacing_[1] = static_cast<float>(image_size.height - 1) / (coefficients_.rows - 1);
+}
+
+cv::Size CompactNonparametricVignettingModel::getImageSize() const {
+  return image_size_;
+}
+
+cv::Mat CompactNonparametricVignettingModel::getModelCoefficients() const {
+  return coefficients_;
+}
+
+}  // namespace radical
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <radical/exceptions.h>
+
+#include "forward_table.h"
+
+namespace radical {
+
+// Bin boundaries are extended by this fraction of the bin width on both sides when checking whether a bin is exact.
+// This absorbs rounding errors in bin index computation.
+static const double MARGIN = 0.25;
+
+// Number of bins added on each side of the range of inverse response.
+static const int GUARD = 2;
+
+const uint32_t ForwardTable::BRIGHTNESS;
+const uint32_t ForwardTable::INEXACT;
+const uint32_t ForwardTable::STEP;
+
+ForwardTable::ForwardTable(const cv::Mat& response, unsigned int num_bins)
+: num_levels_(response.cols)
+, num_bins_(num_bins + 2 * GUARD)
+, last_bin_(static_cast<float>(num_bins_))
+, bins_(3 * num_bins_)
+, response_(response) {
+  if (num_bins < 1 || num_bins > 65536)
+    throw Exception("Number of bins in forward table should be between 1 and 65536");
+  assert(response.type() == CV_32FC1 && response.rows == 3 && response.isContinuous());
+  assert(num_levels_ >= 2 && num_levels_ <= 65536);
+
+  for (int c = 0; c < 3; ++c) {
+    const float* begin = response_.ptr<float>(c);
+    const float* end = begin + num_levels_ - 1;
+    auto lower_bound = [begin, end](double E) {
+      return static_cast<uint32_t>(std::distance(begin, std::lower_bound(begin, end, static_cast<float>(E))));
+    };
+    double lo = begin[0];
+    double hi = end[-1];
+    uint32_t* bins = &bins_[c * num_bins_];
+    if (!std::isfinite(lo) || !std::isfinite(hi) || !(hi > lo)) {
+      // Degenerate response, every lookup goes through search from zero
+      offset_[c] = 0.0f;
+      scale_[c] = 0.0f;
+      std::fill(bins, bins + num_bins_, INEXACT);
+      continue;
+    }
+    double step = (hi - lo) / num_bins;
+    double offset = lo - GUARD * step;
+    offset_[c] = static_cast<float>(offset);
+    scale_[c] = static_cast<float>(1.0 / step);
+    for (int b = 0; b < num_bins_; ++b) {
+      auto first = lower_bound(offset + (b - MARGIN) * step);
+      auto last = lower_bound(offset + (b + 1 + MARGIN) * step);
+      if (last == first)
+        bins[b] = first;
+      else if (last == first + 1)
+        bins[b] = first | STEP;
+      else
+        bins[b] = first | INEXACT;
+    }
+  }
+}
+
+}  // namespace radical
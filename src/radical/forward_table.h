@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace radical {
+
+/** Dense lookup table for the direct mapping from irradiance to brightness.
+  *
+  * Direct mapping amounts to finding the position of an irradiance value in the (sorted) inverse response, i.e. a
+  * binary search over all brightness levels. This table replaces the search with a single gather. The irradiance range
+  * covered by the inverse response of each channel is split into a given number of equal-width bins. For every bin the
+  * table stores the brightness of the irradiance values at the bin start. If all irradiance values that may fall into
+  * the bin map to the same brightness, the stored value is final. If the bin contains a single step of the response,
+  * the brightness is either the stored value or the next one, which is decided with one comparison against the inverse
+  * response. Otherwise the bin is flagged as inexact and the brightness is refined with a galloping search over the
+  * inverse response that starts from the stored value. Two extra bins on each side of the range absorb irradiance
+  * values that are below or above the range (and NaN), so that those map to brightness without a search as well.
+  *
+  * The result is identical to std::lower_bound() over all but the last element of the inverse response. */
+class ForwardTable {
+ public:
+  /** Mask of the brightness part of table entries. */
+  static const uint32_t BRIGHTNESS = 0xFFFF;
+
+  /** Flag set on table entries that need refinement. */
+  static const uint32_t INEXACT = 0x10000;
+
+  /** Flag set on table entries whose brightness may need to be incremented by one. */
+  static const uint32_t STEP = 0x20000;
+
+  /** Build table for a given inverse response.
+    * \param[in] response inverse CRF with channels stored one after another (CV_32FC1, 3 rows with up to 65536
+    * elements). The table keeps a reference to this matrix.
+    * \param[in] num_bins number of bins per channel covering the range of the inverse response */
+  ForwardTable(const cv::Mat& response, unsigned int num_bins);
+
+  /** Map irradiance to brightness in a given channel. */
+  int operator()(int channel, float E) const {
+    return resolve(channel, E, bins_[channel * num_bins_ + getBin(channel, E)]);
+  }
+
+  /** Get bin index for a given irradiance in a given channel. */
+  int getBin(int channel, float E) const {
+    float t = (E - offset_[channel]) * scale_[channel];
+    // Negated comparisons ensure that NaN ends up in the first bin
+    if (!(t > 0.0f))
+      return 0;
+    if (!(t < last_bin_))
+      return num_bins_ - 1;
+    return static_cast<int>(t);
+  }
+
+  /** Get final brightness of a given irradiance from the table entry of its bin. */
+  int resolve(int channel, float E, uint32_t entry) const {
+    int k = entry & BRIGHTNESS;
+    if (entry & INEXACT)
+      return refine(channel, E, k);
+    if ((entry & STEP) && response_.ptr<float>(channel)[k] < E)
+      ++k;
+    return k;
+  }
+
+  /** Find brightness of a given irradiance by galloping search starting from a given brightness. */
+  int refine(int channel, float E, int start) const {
+    const float* r = response_.ptr<float>(channel);
+    const int last = num_levels_ - 1;
+    // Expand the [lo, hi] interval in exponentially growing steps until it is guaranteed to contain the result
+    int lo = start, hi = start, step = 1;
+    while (lo > 0 && !(r[lo - 1] < E)) {
+      hi = lo - 1;
+      lo = std::max(0, lo - step);
+      step *= 2;
+    }
+    while (hi < last && r[hi] < E) {
+      lo = hi + 1;
+      hi = std::min(last, hi + step);
+      step *= 2;
+    }
+    return static_cast<int>(std::lower_bound(r + lo, r + hi, E) - r);
+  }
+
+  /** Get the number of brightness levels. */
+  int getNumLevels() const {
+    return num_levels_;
+  }
+
+  /** Get the total number of bins per channel (including the bins outside of the range of the inverse response). */
+  int getNumBins() const {
+    return num_bins_;
+  }
+
+  /** Raw access to the table entries (channel by channel). */
+  const uint32_t* getBins() const {
+    return bins_.data();
+  }
+
+  /** Raw access to the inverse response (getNumLevels() elements per channel, channel by channel). */
+  const float* getResponse() const {
+    return response_.ptr<float>();
+  }
+
+  /** Get irradiance that corresponds to the start of the first bin in a given channel (for bin index computation). */
+  float getOffset(int channel) const {
+    return offset_[channel];
+  }
+
+  /** Get the number of bins per unit of irradiance in a given channel. */
+  float getScale(int channel) const {
+    return scale_[channel];
+  }
+
+ private:
+  int num_levels_;
+  int num_bins_;
+  float last_bin_;
+  float offset_[3];
+  float scale_[3];
+  std::vector<uint32_t> bins_;
+  cv::Mat response_;
+};
+
+}  // namespace radical
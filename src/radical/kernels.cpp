@@ -0,0 +1,255 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "forward_table.h"
+#include "kernels.h"
+
+// Values of RADICAL_SIMD_FORCE (set by CMake when a particular instruction set is forced)
+#define RADICAL_SIMD_SCALAR 0
+#define RADICAL_SIMD_SSE4_1 1
+#define RADICAL_SIMD_AVX2 2
+#define RADICAL_SIMD_AVX512 3
+
+namespace radical {
+
+namespace kernels {
+
+namespace scalar {
+
+namespace {
+
+template <typename T>
+void inverseMapImpl(const T* src, float* dst, size_t n, const float* lut, int num_levels) {
+  const int max_level = num_levels - 1;
+  for (size_t i = 0; i < n; i += 3) {
+    dst[i + 0] = lut[std::min<int>(src[i + 0], max_level)];
+    dst[i + 1] = lut[std::min<int>(src[i + 1], max_level) + num_levels];
+    dst[i + 2] = lut[std::min<int>(src[i + 2], max_level) + 2 * num_levels];
+  }
+}
+
+/** Saturate brightness to the range of the output type (same as packing with unsigned saturation in vector code). */
+template <typename T>
+inline T saturate(int value) {
+  return static_cast<T>(std::min<int>(value, std::numeric_limits<T>::max()));
+}
+
+template <typename T>
+void directMapImpl(const float* src, T* dst, size_t n, const ForwardTable& table) {
+  for (size_t i = 0; i < n; i += 3) {
+    dst[i + 0] = saturate<T>(table(0, src[i + 0]));
+    dst[i + 1] = saturate<T>(table(1, src[i + 1]));
+    dst[i + 2] = saturate<T>(table(2, src[i + 2]));
+  }
+}
+
+}  // anonymous namespace
+
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+}  // namespace scalar
+
+namespace {
+
+/** Check if the CPU (and the OS) supports a given instruction set. */
+bool isSupported(ISA isa) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  switch (isa) {
+    case ISA::SSE4_1:
+      return __builtin_cpu_supports("sse4.1");
+    case ISA::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case ISA::AVX512:
+      return __builtin_cpu_supports("avx512f");
+    default:
+      return true;
+  }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+  __cpuid(info, 1);
+  bool sse41 = (info[2] & (1 << 19)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+  bool avx2 = false, avx512f = false;
+  if (max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    // YMM state should be enabled by the OS for AVX2, and additionally opmask and ZMM state for AVX-512
+    avx2 = (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;
+    avx512f = (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+  }
+  switch (isa) {
+    case ISA::SSE4_1:
+      return sse41;
+    case ISA::AVX2:
+      return avx2;
+    case ISA::AVX512:
+      return avx512f;
+    default:
+      return true;
+  }
+#else
+  return isa == ISA::Scalar;
+#endif
+}
+
+/** Check if kernels for a given instruction set were compiled in. */
+bool isCompiled(ISA isa) {
+  switch (isa) {
+#ifdef RADICAL_HAVE_SSE4_1
+    case ISA::SSE4_1:
+      return true;
+#endif
+#ifdef RADICAL_HAVE_AVX2
+    case ISA::AVX2:
+      return true;
+#endif
+#ifdef RADICAL_HAVE_AVX512
+    case ISA::AVX512:
+      return true;
+#endif
+    case ISA::Scalar:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // anonymous namespace
+
+bool isAvailable(ISA isa) {
+  return isCompiled(isa) && isSupported(isa);
+}
+
+namespace {
+
+using InverseMap8 = void (*)(const uint8_t*, float*, size_t, const float*, int);
+using InverseMap16 = void (*)(const uint16_t*, float*, size_t, const float*, int);
+using DirectMap8 = void (*)(const float*, uint8_t*, size_t, const ForwardTable&);
+using DirectMap16 = void (*)(const float*, uint16_t*, size_t, const ForwardTable&);
+
+struct Dispatch {
+  InverseMap8 inverse_map_8 = &scalar::inverseMap;
+  InverseMap16 inverse_map_16 = &scalar::inverseMap;
+  DirectMap8 direct_map_8 = &scalar::directMap;
+  DirectMap16 direct_map_16 = &scalar::directMap;
+
+  Dispatch() {
+#if defined(RADICAL_SIMD_FORCE)
+    // Instruction set was forced at configuration time, use it without checking CPU support
+#if RADICAL_SIMD_FORCE == RADICAL_SIMD_SSE4_1
+    use(ISA::SSE4_1);
+#elif RADICAL_SIMD_FORCE == RADICAL_SIMD_AVX2
+    use(ISA::AVX2);
+#elif RADICAL_SIMD_FORCE == RADICAL_SIMD_AVX512
+    use(ISA::AVX512);
+#endif
+#else
+    for (auto isa : {ISA::AVX512, ISA::AVX2, ISA::SSE4_1})
+      if (isAvailable(isa)) {
+        use(isa);
+        break;
+      }
+#endif
+  }
+
+  void use(ISA isa) {
+    switch (isa) {
+#ifdef RADICAL_HAVE_SSE4_1
+      case ISA::SSE4_1:
+        inverse_map_8 = &sse41::inverseMap;
+        inverse_map_16 = &sse41::inverseMap;
+        direct_map_8 = &sse41::directMap;
+        direct_map_16 = &sse41::directMap;
+        break;
+#endif
+#ifdef RADICAL_HAVE_AVX2
+      case ISA::AVX2:
+        inverse_map_8 = &avx2::inverseMap;
+        inverse_map_16 = &avx2::inverseMap;
+        direct_map_8 = &avx2::directMap;
+        direct_map_16 = &avx2::directMap;
+        break;
+#endif
+#ifdef RADICAL_HAVE_AVX512
+      case ISA::AVX512:
+        inverse_map_8 = &avx512::inverseMap;
+        inverse_map_16 = &avx512::inverseMap;
+        direct_map_8 = &avx512::directMap;
+        direct_map_16 = &avx512::directMap;
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+};
+
+const Dispatch& getDispatch() {
+  static const Dispatch dispatch;
+  return dispatch;
+}
+
+}  // anonymous namespace
+
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  getDispatch().inverse_map_8(src, dst, n, lut, num_levels);
+}
+
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  getDispatch().inverse_map_16(src, dst, n, lut, num_levels);
+}
+
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table) {
+  getDispatch().direct_map_8(src, dst, n, table);
+}
+
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table) {
+  getDispatch().direct_map_16(src, dst, n, table);
+}
+
+}  // namespace kernels
+
+}  // namespace radical
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace radical {
+
+class ForwardTable;
+
+/** Low-level lookup kernels used by RadiometricResponse and PhotometricCorrector.
+  *
+  * All kernels operate on interleaved 3-channel data. The number of elements \c n is the number of pixels times three.
+  * Several implementations of each kernel exist (scalar, SSE4.1, AVX2, AVX-512). The best one supported by the CPU is
+  * selected at runtime on first use, unless a particular instruction set was forced at configuration time with the
+  * RADICAL_SIMD CMake option. */
+namespace kernels {
+
+/** Map brightness to irradiance using a lookup table.
+  * \param[in] src brightness values (8- or 16-bit), values beyond the last table element are clamped
+  * \param[out] dst irradiance values
+  * \param[in] n number of elements
+  * \param[in] lut lookup table with \c num_levels elements per channel, stored channel by channel
+  * \param[in] num_levels number of elements per channel in the lookup table */
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels);
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels);
+
+/** Map irradiance to 8-bit brightness using forward table.
+  * Brightness above 255 (forward table with more than 256 levels) saturates to 255 in all implementations.
+  * \param[in] src irradiance values
+  * \param[out] dst brightness values
+  * \param[in] n number of elements
+  * \param[in] table forward table */
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table);
+
+/** Map irradiance to 16-bit brightness using forward table.
+  * \param[in] src irradiance values
+  * \param[out] dst brightness values
+  * \param[in] n number of elements
+  * \param[in] table forward table */
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table);
+
+/** Instruction sets with dedicated kernel implementations. */
+enum class ISA { Scalar, SSE4_1, AVX2, AVX512 };
+
+/** Check if kernels for a given instruction set are compiled in and supported by the CPU (and the OS). */
+bool isAvailable(ISA isa);
+
+// Implementations for specific instruction sets, these should not be called directly (except in tests).
+
+#define RADICAL_DECLARE_KERNELS(isa)                                                            \
+  namespace isa {                                                                               \
+  void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels);  \
+  void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels); \
+  void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table);          \
+  void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table);         \
+  }
+
+RADICAL_DECLARE_KERNELS(scalar)
+RADICAL_DECLARE_KERNELS(sse41)
+RADICAL_DECLARE_KERNELS(avx2)
+RADICAL_DECLARE_KERNELS(avx512)
+
+#undef RADICAL_DECLARE_KERNELS
+
+}  // namespace kernels
+
+}  // namespace radical
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include <immintrin.h>
+
+#include "forward_table.h"
+#include "kernels.h"
+
+namespace radical {
+
+namespace kernels {
+
+namespace avx2 {
+
+namespace {
+
+/** Channel pattern repeats every 24 elements (3 vectors). Get a vector with channel index of each lane in a given
+  * vector of the block multiplied by a given factor. */
+inline __m256i channelOffset(int v, int factor) {
+  alignas(32) int o[8];
+  for (int j = 0; j < 8; ++j)
+    o[j] = ((v * 8 + j) % 3) * factor;
+  return _mm256_load_si256(reinterpret_cast<const __m256i*>(o));
+}
+
+/** Get a vector with per-channel values for each lane in a given vector of the block. */
+inline __m256 channelValue(int v, const float (&values)[3]) {
+  alignas(32) float o[8];
+  for (int j = 0; j < 8; ++j)
+    o[j] = values[(v * 8 + j) % 3];
+  return _mm256_load_ps(o);
+}
+
+/** Load 8 bytes and zero-extend them to 32-bit elements. */
+inline __m256i load(const uint8_t* src) {
+  return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+}
+
+/** Load 8 words and zero-extend them to 32-bit elements. */
+inline __m256i load(const uint16_t* src) {
+  return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+/** Store 32-bit elements of a vector as bytes with unsigned saturation. */
+inline void store(uint8_t* dst, __m256i v) {
+  // Words above 32767 would be negative for the signed 16-bit pack, so clamp to the byte range first
+  v = _mm256_min_epi32(v, _mm256_set1_epi32(255));
+  __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(packed, packed));
+}
+
+/** Store 32-bit elements of a vector as words with unsigned saturation. */
+inline void store(uint16_t* dst, __m256i v) {
+  __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+}
+
+template <typename T>
+void inverseMapImpl(const T* src, float* dst, size_t n, const float* lut, int num_levels) {
+  const __m256i offset[3] = {channelOffset(0, num_levels), channelOffset(1, num_levels), channelOffset(2, num_levels)};
+  const __m256i max_level = _mm256_set1_epi32(num_levels - 1);
+  size_t i = 0;
+  for (; i + 24 <= n; i += 24)
+    for (int v = 0; v < 3; ++v) {
+      __m256i index = _mm256_add_epi32(_mm256_min_epi32(load(src + i + v * 8), max_level), offset[v]);
+      _mm256_storeu_ps(dst + i + v * 8, _mm256_i32gather_ps(lut, index, 4));
+    }
+  for (; i < n; ++i)
+    dst[i] = lut[std::min<int>(src[i], num_levels - 1) + (i % 3) * num_levels];
+}
+
+template <typename T>
+void directMapImpl(const float* src, T* dst, size_t n, const ForwardTable& table) {
+  const int* bins = reinterpret_cast<const int*>(table.getBins());
+  const float* response = table.getResponse();
+  const float offsets[3] = {table.getOffset(0), table.getOffset(1), table.getOffset(2)};
+  const float scales[3] = {table.getScale(0), table.getScale(1), table.getScale(2)};
+  // Per-lane constants for each of the 3 vectors in a block of 24 elements
+  __m256 offset[3], scale[3];
+  __m256i base[3], response_base[3];
+  for (int v = 0; v < 3; ++v) {
+    offset[v] = channelValue(v, offsets);
+    scale[v] = channelValue(v, scales);
+    base[v] = channelOffset(v, table.getNumBins());
+    response_base[v] = channelOffset(v, table.getNumLevels());
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 last_bin = _mm256_set1_ps(static_cast<float>(table.getNumBins() - 1));
+  const __m256i brightness = _mm256_set1_epi32(ForwardTable::BRIGHTNESS);
+  const __m256i inexact = _mm256_set1_epi32(ForwardTable::INEXACT);
+  const __m256i step = _mm256_set1_epi32(ForwardTable::STEP);
+
+  size_t i = 0;
+  for (; i + 24 <= n; i += 24) {
+    __m256i entry[3], value[3];
+    __m256i flags = _mm256_setzero_si256();
+    for (int v = 0; v < 3; ++v) {
+      __m256 E = _mm256_loadu_ps(src + i + v * 8);
+      // Maximum goes first so that NaN is replaced with zero
+      __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(E, offset[v]), scale[v]), zero), last_bin);
+      __m256i index = _mm256_add_epi32(_mm256_cvttps_epi32(t), base[v]);
+      entry[v] = _mm256_i32gather_epi32(bins, index, 4);
+      flags = _mm256_or_si256(flags, entry[v]);
+      value[v] = _mm256_and_si256(entry[v], brightness);
+      // Entries with a single step are incremented if the irradiance is above the response at the stored brightness
+      __m256 threshold = _mm256_i32gather_ps(response, _mm256_add_epi32(value[v], response_base[v]), 4);
+      __m256i above = _mm256_castps_si256(_mm256_cmp_ps(threshold, E, _CMP_LT_OQ));
+      __m256i is_step = _mm256_cmpeq_epi32(_mm256_and_si256(entry[v], step), step);
+      value[v] = _mm256_sub_epi32(value[v], _mm256_and_si256(above, is_step));
+    }
+    if (!_mm256_testz_si256(flags, inexact)) {
+      // Rare case (only happens in the dense part of the response), fall back to search
+      alignas(32) int r[24], e[24];
+      for (int v = 0; v < 3; ++v) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(r + v * 8), value[v]);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(e + v * 8), entry[v]);
+      }
+      for (int j = 0; j < 24; ++j)
+        if (e[j] & ForwardTable::INEXACT)
+          r[j] = table.refine(j % 3, src[i + j], r[j]);
+      for (int v = 0; v < 3; ++v)
+        value[v] = _mm256_load_si256(reinterpret_cast<const __m256i*>(r + v * 8));
+    }
+    for (int v = 0; v < 3; ++v)
+      store(dst + i + v * 8, value[v]);
+  }
+  scalar::directMap(src + i, dst + i, n - i, table);
+}
+
+}  // anonymous namespace
+
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+}  // namespace avx2
+
+}  // namespace kernels
+
+}  // namespace radical
@@ -0,0 +1,167 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include <immintrin.h>
+
+#include "forward_table.h"
+#include "kernels.h"
+
+namespace radical {
+
+namespace kernels {
+
+namespace avx512 {
+
+namespace {
+
+/** Channel pattern repeats every 48 elements (3 vectors). Get a vector with channel index of each lane in a given
+  * vector of the block multiplied by a given factor. */
+inline __m512i channelOffset(int v, int factor) {
+  alignas(64) int o[16];
+  for (int j = 0; j < 16; ++j)
+    o[j] = ((v * 16 + j) % 3) * factor;
+  return _mm512_load_si512(o);
+}
+
+/** Get a vector with per-channel values for each lane in a given vector of the block. */
+inline __m512 channelValue(int v, const float (&values)[3]) {
+  alignas(64) float o[16];
+  for (int j = 0; j < 16; ++j)
+    o[j] = values[(v * 16 + j) % 3];
+  return _mm512_load_ps(o);
+}
+
+/** Load 16 bytes and zero-extend them to 32-bit elements. */
+inline __m512i load(const uint8_t* src) {
+  return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+/** Load 16 words and zero-extend them to 32-bit elements. */
+inline __m512i load(const uint16_t* src) {
+  return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+}
+
+/** Store 32-bit elements of a vector as bytes with unsigned saturation. */
+inline void store(uint8_t* dst, __m512i v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm512_cvtusepi32_epi8(v));
+}
+
+/** Store 32-bit elements of a vector as words with unsigned saturation. */
+inline void store(uint16_t* dst, __m512i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm512_cvtusepi32_epi16(v));
+}
+
+template <typename T>
+void inverseMapImpl(const T* src, float* dst, size_t n, const float* lut, int num_levels) {
+  const __m512i offset[3] = {channelOffset(0, num_levels), channelOffset(1, num_levels), channelOffset(2, num_levels)};
+  const __m512i max_level = _mm512_set1_epi32(num_levels - 1);
+  size_t i = 0;
+  for (; i + 48 <= n; i += 48)
+    for (int v = 0; v < 3; ++v) {
+      __m512i index = _mm512_add_epi32(_mm512_min_epi32(load(src + i + v * 16), max_level), offset[v]);
+      _mm512_storeu_ps(dst + i + v * 16, _mm512_i32gather_ps(index, lut, 4));
+    }
+  for (; i < n; ++i)
+    dst[i] = lut[std::min<int>(src[i], num_levels - 1) + (i % 3) * num_levels];
+}
+
+template <typename T>
+void directMapImpl(const float* src, T* dst, size_t n, const ForwardTable& table) {
+  const int* bins = reinterpret_cast<const int*>(table.getBins());
+  const float* response = table.getResponse();
+  const float offsets[3] = {table.getOffset(0), table.getOffset(1), table.getOffset(2)};
+  const float scales[3] = {table.getScale(0), table.getScale(1), table.getScale(2)};
+  // Per-lane constants for each of the 3 vectors in a block of 48 elements
+  __m512 offset[3], scale[3];
+  __m512i base[3], response_base[3];
+  for (int v = 0; v < 3; ++v) {
+    offset[v] = channelValue(v, offsets);
+    scale[v] = channelValue(v, scales);
+    base[v] = channelOffset(v, table.getNumBins());
+    response_base[v] = channelOffset(v, table.getNumLevels());
+  }
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 last_bin = _mm512_set1_ps(static_cast<float>(table.getNumBins() - 1));
+  const __m512i brightness = _mm512_set1_epi32(ForwardTable::BRIGHTNESS);
+  const __m512i inexact = _mm512_set1_epi32(ForwardTable::INEXACT);
+  const __m512i step = _mm512_set1_epi32(ForwardTable::STEP);
+  const __m512i one = _mm512_set1_epi32(1);
+
+  size_t i = 0;
+  for (; i + 48 <= n; i += 48) {
+    __m512i value[3];
+    __mmask16 flags[3];
+    for (int v = 0; v < 3; ++v) {
+      __m512 E = _mm512_loadu_ps(src + i + v * 16);
+      // Maximum goes first so that NaN is replaced with zero
+      __m512 t = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_sub_ps(E, offset[v]), scale[v]), zero), last_bin);
+      __m512i index = _mm512_add_epi32(_mm512_cvttps_epi32(t), base[v]);
+      __m512i entry = _mm512_i32gather_epi32(index, bins, 4);
+      flags[v] = _mm512_test_epi32_mask(entry, inexact);
+      value[v] = _mm512_and_si512(entry, brightness);
+      // Entries with a single step are incremented if the irradiance is above the response at the stored brightness
+      __m512 threshold = _mm512_i32gather_ps(_mm512_add_epi32(value[v], response_base[v]), response, 4);
+      __mmask16 above = _mm512_cmp_ps_mask(threshold, E, _CMP_LT_OQ) & _mm512_test_epi32_mask(entry, step);
+      value[v] = _mm512_mask_add_epi32(value[v], above, value[v], one);
+    }
+    if (flags[0] | flags[1] | flags[2]) {
+      // Rare case (only happens in the dense part of the response), fall back to search
+      alignas(64) int r[48];
+      for (int v = 0; v < 3; ++v)
+        _mm512_store_si512(r + v * 16, value[v]);
+      for (int j = 0; j < 48; ++j)
+        if (flags[j / 16] & (1 << (j % 16)))
+          r[j] = table.refine(j % 3, src[i + j], r[j]);
+      for (int v = 0; v < 3; ++v)
+        value[v] = _mm512_load_si512(r + v * 16);
+    }
+    for (int v = 0; v < 3; ++v)
+      store(dst + i + v * 16, value[v]);
+  }
+  scalar::directMap(src + i, dst + i, n - i, table);
+}
+
+}  // anonymous namespace
+
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+}  // namespace avx512
+
+}  // namespace kernels
+
+}  // namespace radical
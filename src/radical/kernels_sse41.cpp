@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include <immintrin.h>
+
+#include "forward_table.h"
+#include "kernels.h"
+
+// SSE4.1 has no gather instructions, so table lookups are done one element at a time. Vector instructions are used to
+// compute bin indices for the forward table and to pack the results.
+
+namespace radical {
+
+namespace kernels {
+
+namespace sse41 {
+
+namespace {
+
+/** Fill per-lane values for a given vector of a block of 12 elements from per-channel values. */
+template <typename T>
+inline void channelValue(int v, const T (&values)[3], T (&out)[4]) {
+  for (int j = 0; j < 4; ++j)
+    out[j] = values[(v * 4 + j) % 3];
+}
+
+/** Store 12 elements (each vector holds 4 of them in 32-bit lanes) with unsigned saturation. */
+inline void store(uint8_t* dst, const __m128i (&value)[3]) {
+  // Words above 32767 would be negative for the signed 16-bit pack, so clamp to the byte range first
+  const __m128i max = _mm_set1_epi32(255);
+  __m128i v[3] = {_mm_min_epi32(value[0], max), _mm_min_epi32(value[1], max), _mm_min_epi32(value[2], max)};
+  __m128i packed = _mm_packus_epi16(_mm_packus_epi32(v[0], v[1]), _mm_packus_epi32(v[2], v[2]));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+  int tail = _mm_extract_epi32(packed, 2);
+  std::memcpy(dst + 8, &tail, 4);
+}
+
+inline void store(uint16_t* dst, const __m128i (&value)[3]) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi32(value[0], value[1]));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 8), _mm_packus_epi32(value[2], value[2]));
+}
+
+template <typename T>
+void inverseMapImpl(const T* src, float* dst, size_t n, const float* lut, int num_levels) {
+  // Channel pattern repeats every 12 elements (3 vectors)
+  const float* r = lut;
+  const float* g = lut + num_levels;
+  const float* b = lut + 2 * num_levels;
+  const int m = num_levels - 1;
+  size_t i = 0;
+  for (; i + 12 <= n; i += 12) {
+    int s[12];
+    for (int j = 0; j < 12; ++j)
+      s[j] = std::min<int>(src[i + j], m);
+    _mm_storeu_ps(dst + i + 0, _mm_setr_ps(r[s[0]], g[s[1]], b[s[2]], r[s[3]]));
+    _mm_storeu_ps(dst + i + 4, _mm_setr_ps(g[s[4]], b[s[5]], r[s[6]], g[s[7]]));
+    _mm_storeu_ps(dst + i + 8, _mm_setr_ps(b[s[8]], r[s[9]], g[s[10]], b[s[11]]));
+  }
+  for (; i < n; ++i)
+    dst[i] = lut[std::min<int>(src[i], m) + (i % 3) * num_levels];
+}
+
+template <typename T>
+void directMapImpl(const float* src, T* dst, size_t n, const ForwardTable& table) {
+  const uint32_t* bins = table.getBins();
+  const float offsets[3] = {table.getOffset(0), table.getOffset(1), table.getOffset(2)};
+  const float scales[3] = {table.getScale(0), table.getScale(1), table.getScale(2)};
+  const int bases[3] = {0, table.getNumBins(), 2 * table.getNumBins()};
+  // Per-lane constants for each of the 3 vectors in a block of 12 elements
+  __m128 offset[3], scale[3];
+  __m128i base[3];
+  for (int v = 0; v < 3; ++v) {
+    float o[4], s[4];
+    int b[4];
+    channelValue(v, offsets, o);
+    channelValue(v, scales, s);
+    channelValue(v, bases, b);
+    offset[v] = _mm_loadu_ps(o);
+    scale[v] = _mm_loadu_ps(s);
+    base[v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+  }
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 last_bin = _mm_set1_ps(static_cast<float>(table.getNumBins() - 1));
+
+  size_t i = 0;
+  for (; i + 12 <= n; i += 12) {
+    __m128i value[3];
+    for (int v = 0; v < 3; ++v) {
+      __m128 E = _mm_loadu_ps(src + i + v * 4);
+      // Maximum goes first so that NaN is replaced with zero
+      __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(E, offset[v]), scale[v]), zero), last_bin);
+      alignas(16) int index[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_add_epi32(_mm_cvttps_epi32(t), base[v]));
+      alignas(16) int r[4];
+      for (int j = 0; j < 4; ++j)
+        r[j] = table.resolve((v * 4 + j) % 3, src[i + v * 4 + j], bins[index[j]]);
+      value[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(r));
+    }
+    store(dst + i, value);
+  }
+  scalar::directMap(src + i, dst + i, n - i, table);
+}
+
+}  // anonymous namespace
+
+void inverseMap(const uint8_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void inverseMap(const uint16_t* src, float* dst, size_t n, const float* lut, int num_levels) {
+  inverseMapImpl(src, dst, n, lut, num_levels);
+}
+
+void directMap(const float* src, uint8_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+void directMap(const float* src, uint16_t* dst, size_t n, const ForwardTable& table) {
+  directMapImpl(src, dst, n, table);
+}
+
+}  // namespace sse41
+
+}  // namespace kernels
+
+}  // namespace radical
@@ -0,0 +1,235 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <radical/exceptions.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+#if CV_MAJOR_VERSION > 2
+
+#if CV_MAJOR_VERSION > 3
+using AccessFlag = cv::AccessFlag;
+#else
+using AccessFlag = int;
+#endif
+
+/** Allocator that owns memory-mapped files backing cv::Mat data.
+  * It is only used to release the mapping once the reference count of the cv::Mat data drops to zero. New allocations
+  * (e.g. when a mapped cv::Mat is re-created with a different size) are delegated to the standard allocator. */
+class MappedFileAllocator : public cv::MatAllocator {
+ public:
+  static MappedFileAllocator* get() {
+    static MappedFileAllocator allocator;
+    return &allocator;
+  }
+
+  cv::UMatData* wrap(const std::shared_ptr<radical::MappedFile>& file, uint8_t* data, size_t size) const {
+    auto u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = size;
+    u->refcount = 1;
+    u->userdata = new std::shared_ptr<radical::MappedFile>(file);
+    return u;
+  }
+
+  virtual cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags,
+                                 cv::UMatUsageFlags usage_flags) const override {
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+  }
+
+  virtual bool allocate(cv::UMatData* data, AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override {
+    return cv::Mat::getStdAllocator()->allocate(data, access_flags, usage_flags);
+  }
+
+  virtual void deallocate(cv::UMatData* u) const override {
+    if (!u)
+      return;
+    delete static_cast<std::shared_ptr<radical::MappedFile>*>(u->userdata);
+    delete u;
+  }
+};
+
+#endif
+
+#if defined(_WIN32)
+
+/** Rename a file over another one that may be open or mapped (with FILE_SHARE_DELETE).
+  * MoveFileEx() fails if the target is mapped. With POSIX semantics the name of the replaced file is released
+  * immediately, while its data stays valid for existing handles and mappings. On systems or file systems that do not
+  * support POSIX semantics this falls back to the regular rename, which only succeeds if the target is not in use. */
+bool replaceFile(const std::string& source, const std::string& target) {
+  wchar_t path[MAX_PATH];
+  int length = MultiByteToWideChar(CP_ACP, 0, target.c_str(), -1, path, MAX_PATH);
+  if (length == 0)
+    return false;
+  wchar_t full_path[MAX_PATH];
+  length = static_cast<int>(GetFullPathNameW(path, MAX_PATH, full_path, nullptr));
+  if (length == 0 || length >= MAX_PATH)
+    return false;
+  HANDLE file = CreateFileA(source.c_str(), DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  std::vector<char> buffer(sizeof(FILE_RENAME_INFO) + length * sizeof(wchar_t));
+  auto info = reinterpret_cast<FILE_RENAME_INFO*>(buffer.data());
+  info->RootDirectory = nullptr;
+  info->FileNameLength = static_cast<DWORD>(length * sizeof(wchar_t));
+  std::memcpy(info->FileName, full_path, length * sizeof(wchar_t));
+  bool renamed = false;
+#if defined(FILE_RENAME_FLAG_POSIX_SEMANTICS)
+  info->Flags = FILE_RENAME_FLAG_REPLACE_IF_EXISTS | FILE_RENAME_FLAG_POSIX_SEMANTICS;
+  renamed = SetFileInformationByHandle(file, FileRenameInfoEx, info, static_cast<DWORD>(buffer.size())) != 0;
+#endif
+  if (!renamed) {
+    info->ReplaceIfExists = TRUE;
+    renamed = SetFileInformationByHandle(file, FileRenameInfo, info, static_cast<DWORD>(buffer.size())) != 0;
+  }
+  CloseHandle(file);
+  return renamed;
+}
+
+#endif
+
+}  // anonymous namespace
+
+namespace radical {
+
+MappedFile::MappedFile(const std::string& filename) {
+#if defined(_WIN32)
+  // Sharing delete access allows ReplacementFile to rename another file over this one while it is mapped
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    throw SerializationException("Failed to open file for mapping", filename);
+  file_ = file;
+  LARGE_INTEGER size;
+  GetFileSizeEx(file, &size);
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (size_ > 0) {
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (mapping_)
+      data_ = static_cast<uint8_t*>(MapViewOfFile(static_cast<HANDLE>(mapping_), FILE_MAP_COPY, 0, 0, 0));
+    if (!data_) {
+      close();
+      throw SerializationException("Failed to map file", filename);
+    }
+  }
+#else
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw SerializationException("Failed to open file for mapping", filename);
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    // Mapping stays valid after the descriptor is closed
+    void* data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+      data_ = static_cast<uint8_t*>(data);
+  }
+  ::close(fd);
+  if (size_ > 0 && !data_)
+    throw SerializationException("Failed to map file", filename);
+#endif
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void MappedFile::close() {
+#if defined(_WIN32)
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_)
+    CloseHandle(static_cast<HANDLE>(mapping_));
+  if (file_)
+    CloseHandle(static_cast<HANDLE>(file_));
+  mapping_ = file_ = nullptr;
+#else
+  if (data_)
+    munmap(data_, size_);
+#endif
+  data_ = nullptr;
+}
+
+cv::Mat wrapMappedData(const std::shared_ptr<MappedFile>& file, size_t offset, int rows, int cols, int type) {
+  auto data = file->data() + offset;
+  cv::Mat mat(rows, cols, type, data);
+#if CV_MAJOR_VERSION > 2
+  // The mapping starts at a page boundary, so alignment of the data is determined by its offset in the file
+  if (offset % CV_ELEM_SIZE1(type) == 0) {
+    mat.u = MappedFileAllocator::get()->wrap(file, data, mat.total() * mat.elemSize());
+    return mat;
+  }
+#endif
+  return mat.clone();
+}
+
+ReplacementFile::ReplacementFile(const std::string& filename)
+: filename_(filename) {
+  std::stringstream temporary;
+  temporary << filename << "." << std::hex << std::random_device()() << ".tmp";
+  temporary_ = temporary.str();
+  stream_.open(temporary_, std::ios::out | std::ios::binary);
+}
+
+ReplacementFile::~ReplacementFile() {
+  if (stream_.is_open())
+    stream_.close();
+  if (!committed_)
+    std::remove(temporary_.c_str());
+}
+
+bool ReplacementFile::commit() {
+  if (!stream_.is_open())
+    return false;
+  stream_.close();
+  if (!stream_)
+    return false;
+#if defined(_WIN32)
+  committed_ = replaceFile(temporary_, filename_);
+#else
+  committed_ = std::rename(temporary_.c_str(), filename_.c_str()) == 0;
+#endif
+  return committed_;
+}
+
+}  // namespace radical
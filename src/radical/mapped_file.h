@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+namespace radical {
+
+/** Read-only file mapped into memory with copy-on-write semantics.
+  * Modifications of the mapped memory are private to the process and are never written back to the file. */
+class MappedFile {
+ public:
+  /** Map a given file, throws SerializationException if the file can not be opened or mapped. */
+  explicit MappedFile(const std::string& filename);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  uint8_t* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  void close();
+
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+/** Create a cv::Mat that points to data in a memory-mapped file.
+  * The cv::Mat shares ownership of the mapping, which is released together with the last cv::Mat that uses it. If the
+  * data is not aligned to the size of the element type, or memory mapping is not supported (OpenCV 2), the data is
+  * copied into a newly allocated cv::Mat instead. It is the responsibility of the caller to make sure that the data is
+  * within the file. */
+cv::Mat wrapMappedData(const std::shared_ptr<MappedFile>& file, size_t offset, int rows, int cols, int type);
+
+/** Output file that replaces a given file only once it has been completely written.
+  * Data is written to a temporary file next to the target, which is renamed over the target by commit(). Unlike
+  * truncating the target in place, this keeps existing memory mappings of the target valid, including the ones that
+  * back the data being written (e.g. saving a model to the file it was loaded from). If commit() is not called or
+  * fails, the temporary file is removed.
+  *
+  * On Windows replacing a mapped file requires a rename with POSIX semantics (Windows 10 version 1709 or later on
+  * NTFS). Where it is not available, commit() fails if the target is mapped and the target is left untouched. */
+class ReplacementFile {
+ public:
+  explicit ReplacementFile(const std::string& filename);
+
+  ~ReplacementFile();
+
+  ReplacementFile(const ReplacementFile&) = delete;
+  ReplacementFile& operator=(const ReplacementFile&) = delete;
+
+  bool is_open() const {
+    return stream_.is_open();
+  }
+
+  std::ofstream& stream() {
+    return stream_;
+  }
+
+  /** Close the temporary file and rename it to the target.
+    * \returns false if writing or renaming failed, in which case the target is left untouched */
+  bool commit();
+
+ private:
+  std::string filename_;
+  std::string temporary_;
+  std::ofstream stream_;
+  bool committed_ = false;
+};
+
+}  // namespace radical
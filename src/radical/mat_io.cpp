@@ -21,16 +21,22 @@
  ******************************************************************************/
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #include <radical/check.h>
 #include <radical/exceptions.h>
 #include <radical/mat_io.h>
 
+#include "mapped_file.h"
+
 namespace radical {
 
 static const uint32_t MAGIC = 0xC4A1FDD9;
 
+/// Size of the header that precedes the data of a serialized cv::Mat (magic, type, dims, rows, cols).
+static const size_t HEADER_SIZE = 5 * sizeof(uint32_t);
+
 void writeMat(const std::string& filename, const cv::Mat& mat) {
   std::ofstream file(filename, std::ios::out | std::ios::binary);
   if (!file.is_open())
@@ -51,6 +57,14 @@ void writeMat(std::ofstream& file, const cv::Mat& mat) {
   file.write((const char*)(mat.data), mat.elemSize() * mat.total());
 }
 
+void writeMat(std::ofstream& file, const std::string& header, const cv::Mat& mat) {
+  assert(header.find('\n') == std::string::npos);
+  const size_t data_offset = static_cast<size_t>(file.tellp()) + header.size() + 1 + HEADER_SIZE;
+  const size_t padding = (MAT_DATA_ALIGNMENT - data_offset % MAT_DATA_ALIGNMENT) % MAT_DATA_ALIGNMENT;
+  file << header << std::string(padding, ' ') << '\n';
+  writeMat(file, mat);
+}
+
 cv::Mat readMat(const std::string& filename) {
   std::ifstream file(filename, std::ios::in | std::ios::binary);
   if (!file.is_open())
@@ -59,7 +73,7 @@ cv::Mat readMat(const std::string& filename) {
 }
 
 cv::Mat readMat(std::ifstream& file) {
-  uint32_t magic, type, dims, rows, cols;
+  uint32_t magic = 0, type, dims, rows, cols;
   file.read((char*)(&magic), sizeof(uint32_t));
   if (magic != MAGIC)
     throw SerializationException("File does not contain a cv::Mat");
@@ -76,4 +90,22 @@ cv::Mat readMat(std::ifstream& file) {
   return mat;
 }
 
+cv::Mat mapMat(const std::string& filename, size_t offset) {
+  auto file = std::make_shared<MappedFile>(filename);
+  if (file->size() < offset + HEADER_SIZE)
+    throw SerializationException("File does not contain a cv::Mat", filename);
+  uint32_t header[5];
+  std::memcpy(header, file->data() + offset, HEADER_SIZE);
+  const uint32_t magic = header[0], type = header[1], dims = header[2], rows = header[3], cols = header[4];
+  if (magic != MAGIC)
+    throw SerializationException("File does not contain a cv::Mat", filename);
+  if (dims > 2)
+    throw SerializationException("File contains a cv::Mat that is not 1- or 2-dimensional", filename);
+  const size_t data_offset = offset + HEADER_SIZE;
+  const size_t data_size = static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+  if (file->size() - data_offset < data_size)
+    throw SerializationException("File contains a truncated cv::Mat", filename);
+  return wrapMappedData(file, data_offset, rows, cols, type);
+}
+
 }  // namespace radical
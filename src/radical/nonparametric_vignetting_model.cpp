@@ -29,6 +29,15 @@
 #include <radical/check.h>
 #include <radical/mat_io.h>
 
+#include "vignetting_model_io.h"
+
+namespace {
+
+/// First token of the file header.
+const char* const TOKEN = "NonparametricVignettingModel";
+
+}  // anonymous namespace
+
 namespace radical {
 
 NonparametricVignettingModel::NonparametricVignettingModel(cv::InputArray _coefficients) {
@@ -36,21 +45,13 @@ NonparametricVignettingModel::NonparametricVignettingModel(cv::InputArray _coeff
   coefficients_ = _coefficients.getMat();
 }
 
-NonparametricVignettingModel::NonparametricVignettingModel(const std::string& filename) {
-  std::ifstream file(filename, std::ios::in | std::ios::binary);
-  if (file.is_open()) {
-    std::string line, name;
-    {
-      std::getline(file, line);
-      std::stringstream(line) >> name;
-      if (name != "NonparametricVignettingModel")
-        throw SerializationException("Vignetting model stored in the file is not nonparametric", filename);
-    }
-    coefficients_ = readMat(file);
-    file.close();
-  } else {
-    throw SerializationException("Unable to open vignetting model file", filename);
-  }
+NonparametricVignettingModel::NonparametricVignettingModel(const std::string& filename)
+: NonparametricVignettingModel(
+      static_cast<const NonparametricVignettingModel&>(*readModelFile(filename, TOKEN, &read))) {}
+
+VignettingModel::Ptr NonparametricVignettingModel::read(const std::string& filename, std::ifstream& file,
+                                                        const std::string&) {
+  return std::make_shared<NonparametricVignettingModel>(mapCoefficients(filename, file));
 }
 
 std::string NonparametricVignettingModel::getName() const {
@@ -58,20 +59,30 @@ std::string NonparametricVignettingModel::getName() const {
 }
 
 void NonparametricVignettingModel::save(const std::string& filename) const {
-  std::ofstream file(filename, std::ios::out | std::ios::binary);
-  if (file.is_open()) {
-    file << "NonparametricVignettingModel\n";
-    writeMat(file, coefficients_);
-    file.close();
-  } else {
-    throw SerializationException("Unable to open file to save vignetting model", filename);
-  }
+  writeModelFile(filename, TOKEN, cv::Size(), coefficients_);
 }
 
 cv::Vec3f NonparametricVignettingModel::operator()(const cv::Vec2f& p) const {
   return coefficients_.at<cv::Vec3f>(static_cast<int>(std::floor(p[1])), static_cast<int>(std::floor(p[0])));
 }
 
+void NonparametricVignettingModel::evaluateRow(int row, int col, int width, float scale, float* response,
+                                               bool reciprocal) const {
+  auto in = coefficients_.ptr<cv::Vec3f>(static_cast<int>(std::floor(scale * row)));
+  auto out = reinterpret_cast<cv::Vec3f*>(response);
+  for (int x = 0; x < width; ++x) {
+    const auto& v = in[static_cast<int>(std::floor(scale * (col + x)))];
+    out[x] = reciprocal ? cv::Vec3f(1.0f / v[0], 1.0f / v[1], 1.0f / v[2]) : v;
+  }
+}
+
+void NonparametricVignettingModel::evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray response) const {
+  if (scale == 1.0f)
+    coefficients_(roi).copyTo(response);
+  else
+    VignettingModel::evaluateGrid(roi, scale, response);
+}
+
 cv::Size NonparametricVignettingModel::getImageSize() const {
   return coefficients_.size();
 }
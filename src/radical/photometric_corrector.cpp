@@ -0,0 +1,143 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+
+#include <radical/check.h>
+#include <radical/exceptions.h>
+#include <radical/photometric_corrector.h>
+#include <radical/radiometric_response.h>
+#include <radical/vignetting_model.h>
+#include <radical/vignetting_response.h>
+
+#include "forward_table.h"
+#include "kernels.h"
+
+namespace {
+
+/** Parallel loop body that runs the fused correction kernel on a range of image rows.
+  * The gain is either read from a precomputed map, or (if \a model is not \c nullptr) evaluated row by row. */
+template <typename T>
+class CorrectionBody : public cv::ParallelLoopBody {
+ public:
+  CorrectionBody(const cv::Mat& I, const cv::Mat& gain, const radical::VignettingModel* model, float model_scale,
+                 const cv::Mat_<float>& inverse_lut, const radical::ForwardTable& forward_table, cv::Mat& O)
+  : I_(I)
+  , gain_(gain)
+  , model_(model)
+  , model_scale_(model_scale)
+  , inverse_lut_(inverse_lut)
+  , forward_table_(forward_table)
+  , O_(O) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    // Irradiance of a single row, it stays in cache between the three stages
+    const int n = I_.cols * 3;
+    std::vector<float> E(n);
+    std::vector<float> gain_row(model_ ? n : 0);
+    for (int row = range.start; row < range.end; ++row) {
+      const float* gain;
+      if (model_) {
+        model_->evaluateRow(row, 0, I_.cols, model_scale_, gain_row.data(), true);
+        gain = gain_row.data();
+      } else {
+        gain = gain_.ptr<float>(row);
+      }
+      radical::kernels::inverseMap(I_.ptr<T>(row), E.data(), n, inverse_lut_.ptr<float>(), inverse_lut_.cols);
+      for (int i = 0; i < n; ++i)
+        E[i] *= gain[i];
+      radical::kernels::directMap(E.data(), O_.ptr<T>(row), n, forward_table_);
+    }
+  }
+
+ private:
+  const cv::Mat& I_;
+  const cv::Mat& gain_;
+  const radical::VignettingModel* model_;
+  float model_scale_;
+  const cv::Mat_<float>& inverse_lut_;
+  const radical::ForwardTable& forward_table_;
+  cv::Mat& O_;
+};
+
+}  // anonymous namespace
+
+namespace radical {
+
+PhotometricCorrector::PhotometricCorrector(std::shared_ptr<const RadiometricResponse> radiometric_response,
+                                           std::shared_ptr<const VignettingResponse> vignetting_response, float scale)
+: radiometric_response_(radiometric_response)
+, vignetting_response_(vignetting_response) {
+  if (!radiometric_response_ || !vignetting_response_)
+    throw Exception("Photometric corrector requires both radiometric and vignetting responses");
+  setScale(scale);
+}
+
+PhotometricCorrector::~PhotometricCorrector() = default;
+
+void PhotometricCorrector::setScale(float scale) {
+  scale_ = scale;
+  inverse_lut_ = radiometric_response_->response_lut_ * scale_;
+}
+
+float PhotometricCorrector::getScale() const {
+  return scale_;
+}
+
+void PhotometricCorrector::correct(cv::InputArray _I, cv::OutputArray _O) const {
+  if (_I.empty()) {
+    _O.clear();
+    return;
+  }
+  const int type = radiometric_response_->getBitDepth() == 8 ? CV_8UC3 : CV_16UC3;
+  Check("Brightness image", _I).hasType(type);
+  auto I = _I.getMat();
+  cv::Mat gain;
+  const VignettingModel* model = nullptr;
+  float model_scale = 1.0f;
+  if (vignetting_response_->getEvaluation() == VignettingResponse::Evaluation::OnTheFly) {
+    model = vignetting_response_->getModel().get();
+    model_scale = model->getScale(I.size());
+  } else {
+    gain = vignetting_response_->getReciprocalResponse(I.size());
+  }
+  _O.create(I.size(), type);
+  auto O = _O.getMat();
+  const auto& table = *radiometric_response_->forward_table_;
+  if (type == CV_8UC3)
+    cv::parallel_for_(cv::Range(0, I.rows),
+                      CorrectionBody<uint8_t>(I, gain, model, model_scale, inverse_lut_, table, O));
+  else
+    cv::parallel_for_(cv::Range(0, I.rows),
+                      CorrectionBody<uint16_t>(I, gain, model, model_scale, inverse_lut_, table, O));
+}
+
+void PhotometricCorrector::sample(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, cv::Vec3f* L,
+                                  size_t n) const {
+  if (n == 0)
+    return;
+  radiometric_response_->inverseMap(I, points, E, n);
+  if (L)
+    vignetting_response_->remove(I.size(), points, E, L, n);
+}
+
+}  // namespace radical
@@ -0,0 +1,260 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include <radical/check.h>
+#include <radical/exceptions.h>
+#include <radical/pipeline.h>
+#include <radical/radiometric_response.h>
+#include <radical/vignetting_model.h>
+#include <radical/vignetting_response.h>
+
+#include "forward_table.h"
+#include "kernels.h"
+
+namespace {
+
+/** Parallel loop body that runs all stages of a pipeline on a range of tiles.
+  * Intermediate results are stored in two buffers (one for the input and one for the output of a stage) that are
+  * allocated once per range and reused for all tiles, so they stay in cache. The first stage reads from the input
+  * image and the last stage writes to the output image directly. */
+class TileBody : public cv::ParallelLoopBody {
+ public:
+  TileBody(const cv::Mat& I, const std::vector<radical::PipelineStage::ConstPtr>& stages, const std::vector<int>& types,
+           cv::Size tile_size, cv::Mat& O)
+  : I_(I), stages_(stages), types_(types), tile_size_(tile_size), O_(O) {
+    tiles_per_row_ = (I_.cols + tile_size_.width - 1) / tile_size_.width;
+    buffer_bytes_ = 0;
+    for (size_t i = 1; i + 1 < types_.size(); ++i)
+      buffer_bytes_ = std::max(buffer_bytes_, static_cast<size_t>(tile_size_.area() * CV_ELEM_SIZE(types_[i])));
+  }
+
+  virtual void operator()(const cv::Range& range) const override {
+    std::vector<uint8_t> buffers[2];
+    for (auto& buffer : buffers)
+      buffer.resize(buffer_bytes_);
+    for (int t = range.start; t < range.end; ++t) {
+      cv::Rect tile((t % tiles_per_row_) * tile_size_.width, (t / tiles_per_row_) * tile_size_.height, 0, 0);
+      tile.width = std::min(tile_size_.width, I_.cols - tile.x);
+      tile.height = std::min(tile_size_.height, I_.rows - tile.y);
+      cv::Mat in = I_(tile);
+      for (size_t s = 0; s < stages_.size(); ++s) {
+        cv::Mat out;
+        if (s + 1 == stages_.size())
+          out = O_(tile);
+        else
+          out = cv::Mat(tile.size(), types_[s + 1], buffers[s % 2].data());
+        stages_[s]->process(in, out, tile, I_.size());
+        in = out;
+      }
+    }
+  }
+
+ private:
+  const cv::Mat& I_;
+  const std::vector<radical::PipelineStage::ConstPtr>& stages_;
+  const std::vector<int>& types_;
+  cv::Size tile_size_;
+  cv::Mat& O_;
+  int tiles_per_row_;
+  size_t buffer_bytes_;
+};
+
+}  // anonymous namespace
+
+namespace radical {
+
+const size_t Pipeline::DEFAULT_TILE_BYTES;
+
+Pipeline::Pipeline(size_t tile_bytes)
+: tile_bytes_(tile_bytes) {}
+
+Pipeline::~Pipeline() = default;
+
+Pipeline& Pipeline::addStage(PipelineStage::ConstPtr stage) {
+  if (!stage)
+    throw Exception("Pipeline stage is not set");
+  stages_.push_back(stage);
+  return *this;
+}
+
+const std::vector<PipelineStage::ConstPtr>& Pipeline::getStages() const {
+  return stages_;
+}
+
+void Pipeline::setTileBytes(size_t bytes) {
+  tile_bytes_ = bytes;
+}
+
+size_t Pipeline::getTileBytes() const {
+  return tile_bytes_;
+}
+
+cv::Size Pipeline::getTileSize(cv::Size image_size, int type) const {
+  if (image_size.area() == 0)
+    return cv::Size();
+  // Working set of a stage is its input and output
+  size_t pixel_bytes = 0;
+  for (const auto& stage : stages_) {
+    int output_type = stage->getOutputType(type);
+    pixel_bytes = std::max(pixel_bytes, static_cast<size_t>(CV_ELEM_SIZE(type) + CV_ELEM_SIZE(output_type)));
+    type = output_type;
+  }
+  const size_t pixels = std::max<size_t>(1, tile_bytes_ / std::max<size_t>(1, pixel_bytes));
+  // Prefer full-width tiles (contiguous in memory), split rows only if a single one does not fit
+  if (pixels >= static_cast<size_t>(image_size.width))
+    return {image_size.width, static_cast<int>(std::min<size_t>(image_size.height, pixels / image_size.width))};
+  return {static_cast<int>(pixels), 1};
+}
+
+int Pipeline::getOutputType(int input_type) const {
+  if (stages_.empty())
+    throw Exception("Pipeline does not have any stages");
+  for (const auto& stage : stages_)
+    input_type = stage->getOutputType(input_type);
+  return input_type;
+}
+
+void Pipeline::run(cv::InputArray _I, cv::OutputArray _O) const {
+  if (_I.empty()) {
+    _O.clear();
+    return;
+  }
+  if (stages_.empty())
+    throw Exception("Pipeline does not have any stages");
+  // Types of the input and of the outputs of all stages
+  std::vector<int> types = {_I.type()};
+  for (const auto& stage : stages_)
+    types.push_back(stage->getOutputType(types.back()));
+  auto I = _I.getMat();
+  _O.create(I.size(), types.back());
+  auto O = _O.getMat();
+  auto tile_size = getTileSize(I.size(), I.type());
+  const int num_tiles = ((I.cols + tile_size.width - 1) / tile_size.width) *
+                        ((I.rows + tile_size.height - 1) / tile_size.height);
+  cv::parallel_for_(cv::Range(0, num_tiles), TileBody(I, stages_, types, tile_size, O));
+}
+
+InverseMapStage::InverseMapStage(std::shared_ptr<const RadiometricResponse> radiometric_response)
+: radiometric_response_(radiometric_response) {
+  if (!radiometric_response_)
+    throw Exception("Inverse mapping stage requires radiometric response");
+}
+
+int InverseMapStage::getOutputType(int input_type) const {
+  const int type = radiometric_response_->getBitDepth() == 8 ? CV_8UC3 : CV_16UC3;
+  if (input_type != type)
+    throw MatTypeException("Input of inverse mapping stage", type, input_type);
+  return CV_32FC3;
+}
+
+void InverseMapStage::process(const cv::Mat& in, cv::Mat& out, const cv::Rect&, cv::Size) const {
+  const auto& lut = radiometric_response_->response_lut_;
+  for (int row = 0; row < in.rows; ++row)
+    if (in.depth() == CV_8U)
+      kernels::inverseMap(in.ptr<uint8_t>(row), out.ptr<float>(row), in.cols * 3, lut.ptr<float>(), lut.cols);
+    else
+      kernels::inverseMap(in.ptr<uint16_t>(row), out.ptr<float>(row), in.cols * 3, lut.ptr<float>(), lut.cols);
+}
+
+ScaleStage::ScaleStage(float scale)
+: scale_(scale) {}
+
+int ScaleStage::getOutputType(int input_type) const {
+  if (input_type != CV_32FC3)
+    throw MatTypeException("Input of scaling stage", CV_32FC3, input_type);
+  return CV_32FC3;
+}
+
+void ScaleStage::process(const cv::Mat& in, cv::Mat& out, const cv::Rect&, cv::Size) const {
+  const int n = in.cols * 3;
+  for (int row = 0; row < in.rows; ++row) {
+    auto src = in.ptr<float>(row);
+    auto dst = out.ptr<float>(row);
+    for (int i = 0; i < n; ++i)
+      dst[i] = src[i] * scale_;
+  }
+}
+
+RemoveVignettingStage::RemoveVignettingStage(std::shared_ptr<const VignettingResponse> vignetting_response)
+: vignetting_response_(vignetting_response) {
+  if (!vignetting_response_)
+    throw Exception("Vignetting removal stage requires vignetting response");
+}
+
+int RemoveVignettingStage::getOutputType(int input_type) const {
+  if (input_type != CV_32FC3)
+    throw MatTypeException("Input of vignetting removal stage", CV_32FC3, input_type);
+  return CV_32FC3;
+}
+
+void RemoveVignettingStage::process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile,
+                                    cv::Size image_size) const {
+  const int n = in.cols * 3;
+  if (vignetting_response_->getEvaluation() == VignettingResponse::Evaluation::OnTheFly) {
+    const auto& model = *vignetting_response_->getModel();
+    const float scale = model.getScale(image_size);
+    std::vector<float> gain(n);
+    for (int row = 0; row < in.rows; ++row) {
+      model.evaluateRow(tile.y + row, tile.x, in.cols, scale, gain.data(), true);
+      auto src = in.ptr<float>(row);
+      auto dst = out.ptr<float>(row);
+      for (int i = 0; i < n; ++i)
+        dst[i] = src[i] * gain[i];
+    }
+    return;
+  }
+  // Lookup in the response cache is lock-free, the full-frame gain is computed once for every image size
+  auto gain = vignetting_response_->getReciprocalResponse(image_size);
+  for (int row = 0; row < in.rows; ++row) {
+    auto src = in.ptr<float>(row);
+    auto g = gain.ptr<float>(tile.y + row) + tile.x * 3;
+    auto dst = out.ptr<float>(row);
+    for (int i = 0; i < n; ++i)
+      dst[i] = src[i] * g[i];
+  }
+}
+
+DirectMapStage::DirectMapStage(std::shared_ptr<const RadiometricResponse> radiometric_response)
+: radiometric_response_(radiometric_response) {
+  if (!radiometric_response_)
+    throw Exception("Direct mapping stage requires radiometric response");
+}
+
+int DirectMapStage::getOutputType(int input_type) const {
+  if (input_type != CV_32FC3)
+    throw MatTypeException("Input of direct mapping stage", CV_32FC3, input_type);
+  return radiometric_response_->getBitDepth() == 8 ? CV_8UC3 : CV_16UC3;
+}
+
+void DirectMapStage::process(const cv::Mat& in, cv::Mat& out, const cv::Rect&, cv::Size) const {
+  const auto& table = *radiometric_response_->forward_table_;
+  for (int row = 0; row < in.rows; ++row)
+    if (out.depth() == CV_8U)
+      kernels::directMap(in.ptr<float>(row), out.ptr<uint8_t>(row), in.cols * 3, table);
+    else
+      kernels::directMap(in.ptr<float>(row), out.ptr<uint16_t>(row), in.cols * 3, table);
+}
+
+}  // namespace radical
@@ -29,6 +29,26 @@
 #include <radical/mat_io.h>
 #include <radical/polynomial_vignetting_model.h>
 
+namespace {
+
+/** Evaluate polynomial with coefficients stored with a given stride using Horner's scheme.
+  * Recursion over the number of coefficients is resolved at compile time, so the evaluation is fully unrolled. */
+template <unsigned int N, typename T>
+struct Horner {
+  static T evaluate(const T* coefficients, size_t stride, T x) {
+    return coefficients[0] + x * Horner<N - 1, T>::evaluate(coefficients + stride, stride, x);
+  }
+};
+
+template <typename T>
+struct Horner<1, T> {
+  static T evaluate(const T* coefficients, size_t, T) {
+    return coefficients[0];
+  }
+};
+
+}  // anonymous namespace
+
 namespace radical {
 
 template <unsigned int Degree>
@@ -74,10 +94,8 @@ void PolynomialVignettingModel<Degree>::save(const std::string& filename) const
   std::ofstream file(filename, std::ios::out | std::ios::binary);
   if (file.is_open()) {
     std::stringstream header;
-    header << "PolynomialVignettingModel " << Degree << " " << image_size_.width << " " << image_size_.height << "\n";
-    auto str = header.str();
-    file.write(str.c_str(), str.size());
-    writeMat(file, coefficients_);
+    header << "PolynomialVignettingModel " << Degree << " " << image_size_.width << " " << image_size_.height;
+    writeMat(file, header.str(), coefficients_);
     file.close();
   } else {
     throw SerializationException("Unable to open file to save vignetting model", filename);
@@ -92,15 +110,36 @@ cv::Vec3f PolynomialVignettingModel<Degree>::operator()(const cv::Vec2f& p) cons
     auto dx = coeff[0][i] - p[0];
     auto dy = coeff[1][i] - p[1];
     double radius_sqr = dx * dx + dy * dy;
-    double r = radius_sqr;
-    for (unsigned int j = 2; j < Degree + 2; ++j) {
-      result[i] += r * coeff[j][i];
-      r *= radius_sqr;
-    }
+    // Betas of the channel are interleaved with the betas of the other channels, hence the stride
+    result[i] += radius_sqr * Horner<Degree, double>::evaluate(&coeff[2][i], 3, radius_sqr);
   }
   return result;
 }
 
+template <unsigned int Degree>
+void PolynomialVignettingModel<Degree>::evaluateRow(int row, int col, int width, float scale, float* response,
+                                                    bool reciprocal) const {
+  auto coeff = coefficients_.ptr<cv::Vec3d>();
+  for (int c = 0; c < 3; ++c) {
+    // Evaluation is in double precision: at full resolution squared radius reaches millions and the high order betas
+    // are far below the smallest normal float
+    const double cx = coeff[0][c];
+    const double dy = coeff[1][c] - static_cast<double>(scale) * row;
+    const double dy_sqr = dy * dy;
+    double beta[Degree];
+    for (unsigned int j = 0; j < Degree; ++j)
+      beta[j] = coeff[j + 2][c];
+    float* out = response + c;
+    for (int x = 0; x < width; ++x) {
+      const double dx = static_cast<double>(scale) * (col + x) - cx;
+      const double radius_sqr = dx * dx + dy_sqr;
+      const float v = static_cast<float>(1.0 + radius_sqr * Horner<Degree, double>::evaluate(beta, 1, radius_sqr));
+      // Only the polynomial needs double precision, the reciprocal of the result is taken in float (cheaper divide)
+      out[3 * x] = reciprocal ? 1.0f / v : v;
+    }
+  }
+}
+
 template <unsigned int Degree>
 cv::Size PolynomialVignettingModel<Degree>::getImageSize() const {
   return image_size_;
@@ -111,6 +150,41 @@ cv::Mat PolynomialVignettingModel<Degree>::getModelCoefficients() const {
   return coefficients_;
 }
 
+template class PolynomialVignettingModel<1>;
+template class PolynomialVignettingModel<2>;
 template class PolynomialVignettingModel<3>;
+template class PolynomialVignettingModel<4>;
+template class PolynomialVignettingModel<5>;
+template class PolynomialVignettingModel<6>;
+
+VignettingModel::Ptr createPolynomialVignettingModel(unsigned int degree, cv::InputArray coefficients,
+                                                     cv::Size image_size) {
+  switch (degree) {
+    case 1:
+      return std::make_shared<PolynomialVignettingModel<1>>(coefficients, image_size);
+    case 2:
+      return std::make_shared<PolynomialVignettingModel<2>>(coefficients, image_size);
+    case 3:
+      return std::make_shared<PolynomialVignettingModel<3>>(coefficients, image_size);
+    case 4:
+      return std::make_shared<PolynomialVignettingModel<4>>(coefficients, image_size);
+    case 5:
+      return std::make_shared<PolynomialVignettingModel<5>>(coefficients, image_size);
+    case 6:
+      return std::make_shared<PolynomialVignettingModel<6>>(coefficients, image_size);
+    default:
+      throw Exception("Unsupported degree of polynomial vignetting model");
+  }
+}
+
+VignettingModel::Ptr readPolynomialVignettingModel(const std::string&, std::ifstream& file,
+                                                   const std::string& header) {
+  std::string name;
+  unsigned int degree = 0, width = 0, height = 0;
+  std::stringstream(header) >> name >> degree >> width >> height;
+  if (degree < 1 || degree > 6)
+    throw SerializationException("Unsupported degree of polynomial vignetting model");
+  return createPolynomialVignettingModel(degree, readMat(file), cv::Size(width, height));
+}
 
 }  // namespace radical
@@ -0,0 +1,239 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <radical/check.h>
+#include <radical/exceptions.h>
+#include <radical/radial_vignetting_model.h>
+
+#include "vignetting_model_io.h"
+
+namespace {
+
+/// First token of the file header.
+const char* const TOKEN = "RadialVignettingModel";
+
+/** Find the profile segment that contains a given (non-negative) index and the position within the segment.
+  * Indices beyond the end of the profile are clamped. */
+inline void locate(float u, int size, int& index, float& t) {
+  u = std::min(u, static_cast<float>(size - 1));
+  index = std::min(static_cast<int>(u), size - 2);
+  t = u - index;
+}
+
+/** Squared distance from a given point to the farthest corner of an image. */
+float computeMaxRadiusSqr(const cv::Point2f& center, cv::Size image_size) {
+  float max_radius_sqr = 0;
+  for (float x : {0.0f, image_size.width - 1.0f})
+    for (float y : {0.0f, image_size.height - 1.0f})
+      max_radius_sqr = std::max(max_radius_sqr, (x - center.x) * (x - center.x) + (y - center.y) * (y - center.y));
+  return std::max(max_radius_sqr, 1.0f);
+}
+
+/** Fit radial profiles with a given center to every \a step-th pixel (along both dimensions) of a dense response.
+  * The profiles are the least-squares solution, with a weak second-difference regularization that keeps the problem
+  * well-posed when some profile segments do not have any pixels.
+  * \param[out] profiles fitted profiles (size x 3, CV_64FC1), may be \c nullptr
+  * \returns sum of squared residuals */
+double fitProfiles(const cv::Mat& response, int step, const cv::Point2f& center, int size, cv::Mat* profiles) {
+  const float index_scale = (size - 1) / computeMaxRadiusSqr(center, response.size());
+  cv::Mat normal = cv::Mat::zeros(size, size, CV_64FC1);
+  cv::Mat rhs = cv::Mat::zeros(size, 3, CV_64FC1);
+  size_t count = 0;
+  for (int y = 0; y < response.rows; y += step) {
+    auto in = response.ptr<cv::Vec3f>(y);
+    const float dy = y - center.y;
+    for (int x = 0; x < response.cols; x += step, ++count) {
+      const float dx = x - center.x;
+      int i;
+      float t;
+      locate((dx * dx + dy * dy) * index_scale, size, i, t);
+      normal.at<double>(i, i) += (1.0 - t) * (1.0 - t);
+      normal.at<double>(i, i + 1) += (1.0 - t) * t;
+      normal.at<double>(i + 1, i) += (1.0 - t) * t;
+      normal.at<double>(i + 1, i + 1) += t * t;
+      for (int c = 0; c < 3; ++c) {
+        rhs.at<double>(i, c) += (1.0 - t) * in[x][c];
+        rhs.at<double>(i + 1, c) += t * in[x][c];
+      }
+    }
+  }
+  const double lambda = 1e-4 * count / size;
+  for (int j = 1; j + 1 < size; ++j) {
+    const int index[3] = {j - 1, j, j + 1};
+    const double weight[3] = {1, -2, 1};
+    for (int a = 0; a < 3; ++a)
+      for (int b = 0; b < 3; ++b)
+        normal.at<double>(index[a], index[b]) += lambda * weight[a] * weight[b];
+  }
+  cv::Mat solution;
+  cv::solve(normal, rhs, solution, cv::DECOMP_CHOLESKY);
+
+  double residual = 0;
+  for (int y = 0; y < response.rows; y += step) {
+    auto in = response.ptr<cv::Vec3f>(y);
+    const float dy = y - center.y;
+    for (int x = 0; x < response.cols; x += step) {
+      const float dx = x - center.x;
+      int i;
+      float t;
+      locate((dx * dx + dy * dy) * index_scale, size, i, t);
+      for (int c = 0; c < 3; ++c) {
+        const double v = (1.0 - t) * solution.at<double>(i, c) + t * solution.at<double>(i + 1, c);
+        residual += (v - in[x][c]) * (v - in[x][c]);
+      }
+    }
+  }
+  if (profiles)
+    *profiles = solution;
+  return residual;
+}
+
+}  // anonymous namespace
+
+namespace radical {
+
+const unsigned int RadialVignettingModel::DEFAULT_PROFILE_SIZE;
+
+RadialVignettingModel::RadialVignettingModel(cv::InputArray _coefficients, cv::Size image_size) {
+  setCoefficients(_coefficients, image_size);
+}
+
+RadialVignettingModel::RadialVignettingModel(const std::string& filename)
+: RadialVignettingModel(static_cast<const RadialVignettingModel&>(*readModelFile(filename, TOKEN, &read))) {}
+
+RadialVignettingModel::Ptr RadialVignettingModel::fromDense(cv::InputArray _response, unsigned int profile_size) {
+  Check("Dense vignetting response", _response).notEmpty().hasType(CV_32FC3);
+  if (profile_size < 2)
+    throw Exception("Radial vignetting model should have at least 2 profile samples");
+  auto response = _response.getMat();
+  const int size = static_cast<int>(profile_size);
+
+  // Pattern search for the center on a subset of about 40000 pixels, starting from the image center
+  const int step = std::max(1, static_cast<int>(std::sqrt(response.total() / 40000.0)));
+  cv::Point2f center(0.5f * (response.cols - 1), 0.5f * (response.rows - 1));
+  double best = fitProfiles(response, step, center, size, nullptr);
+  const cv::Point2f directions[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  for (float delta = std::max(response.cols, response.rows) / 16.0f; delta > 0.1f;) {
+    bool improved = false;
+    for (const auto& direction : directions) {
+      const cv::Point2f candidate(center.x + direction.x * delta, center.y + direction.y * delta);
+      if (candidate.x < 0 || candidate.y < 0 || candidate.x > response.cols - 1 || candidate.y > response.rows - 1)
+        continue;
+      const double residual = fitProfiles(response, step, candidate, size, nullptr);
+      if (residual < best) {
+        best = residual;
+        center = candidate;
+        improved = true;
+        break;
+      }
+    }
+    if (!improved)
+      delta *= 0.5f;
+  }
+
+  cv::Mat profiles;
+  fitProfiles(response, 1, center, size, &profiles);
+  cv::Mat coefficients(1, size + 2, CV_32FC3);
+  auto coeff = coefficients.ptr<cv::Vec3f>();
+  coeff[0] = cv::Vec3f::all(center.x);
+  coeff[1] = cv::Vec3f::all(center.y);
+  for (int j = 0; j < size; ++j)
+    for (int c = 0; c < 3; ++c)
+      coeff[j + 2][c] = static_cast<float>(profiles.at<double>(j, c));
+  return std::make_shared<RadialVignettingModel>(coefficients, response.size());
+}
+
+VignettingModel::Ptr RadialVignettingModel::read(const std::string& filename, std::ifstream& file,
+                                                 const std::string& header) {
+  return std::make_shared<RadialVignettingModel>(mapCoefficients(filename, file), parseImageSize(header));
+}
+
+std::string RadialVignettingModel::getName() const {
+  return "radial";
+}
+
+void RadialVignettingModel::save(const std::string& filename) const {
+  writeModelFile(filename, TOKEN, image_size_, coefficients_);
+}
+
+cv::Vec3f RadialVignettingModel::operator()(const cv::Vec2f& p) const {
+  auto coeff = coefficients_.ptr<cv::Vec3f>();
+  const int size = coefficients_.cols - 2;
+  cv::Vec3f result;
+  for (int c = 0; c < 3; ++c) {
+    const float dx = p[0] - coeff[0][c];
+    const float dy = p[1] - coeff[1][c];
+    int i;
+    float t;
+    locate((dx * dx + dy * dy) * index_scale_[c], size, i, t);
+    result[c] = coeff[i + 2][c] + t * (coeff[i + 3][c] - coeff[i + 2][c]);
+  }
+  return result;
+}
+
+void RadialVignettingModel::evaluateRow(int row, int col, int width, float scale, float* response,
+                                        bool reciprocal) const {
+  auto coeff = coefficients_.ptr<cv::Vec3f>();
+  const int size = coefficients_.cols - 2;
+  for (int c = 0; c < 3; ++c) {
+    const float cx = coeff[0][c];
+    const float dy = scale * row - coeff[1][c];
+    const float dy_sqr = dy * dy;
+    const float k = index_scale_[c];
+    // Profile samples of the channel are interleaved with the samples of the other channels, hence the stride
+    const float* profile = &coeff[2][c];
+    float* out = response + c;
+    for (int x = 0; x < width; ++x) {
+      const float dx = scale * (col + x) - cx;
+      int i;
+      float t;
+      locate((dx * dx + dy_sqr) * k, size, i, t);
+      const float v = profile[3 * i] + t * (profile[3 * i + 3] - profile[3 * i]);
+      out[3 * x] = reciprocal ? 1.0f / v : v;
+    }
+  }
+}
+
+void RadialVignettingModel::setCoefficients(cv::InputArray coefficients, cv::Size image_size) {
+  image_size_ = image_size;
+  Check("Radial vignetting model", coefficients).notEmpty().hasType(CV_32FC3);
+  coefficients_ = coefficients.getMat();
+  if (coefficients_.rows != 1 || coefficients_.cols < 4)
+    throw Exception("Radial vignetting model should have 1xN coefficients with N at least 4");
+  auto coeff = coefficients_.ptr<cv::Vec3f>();
+  for (int c = 0; c < 3; ++c)
+    index_scale_[c] = (coefficients_.cols - 3) / computeMaxRadiusSqr({coeff[0][c], coeff[1][c]}, image_size_);
+}
+
+cv::Size RadialVignettingModel::getImageSize() const {
+  return image_size_;
+}
+
+cv::Mat RadialVignettingModel::getModelCoefficients() const {
+  return coefficients_;
+}
+
+}  // namespace radical
@@ -19,50 +19,159 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  ******************************************************************************/
-
 #include <algorithm>
+#include <limits>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <radical/check.h>
+#include <radical/exceptions.h>
 #include <radical/mat_io.h>
 #include <radical/radiometric_response.h>
 
-/** Helper function for inverse look-up in a table (cv::Vec3f → Vec3b). */
-inline cv::Vec3b inverseLUT(const std::vector<cv::Mat>& lut, const cv::Vec3f& in) {
-  cv::Vec3b out;
-  for (int c = 0; c < 3; ++c) {
-    auto begin = &lut[c].at<float>(0);
-    auto p = std::lower_bound(begin, &lut[c].at<float>(255), in[c]);
-    out[c] = std::distance(begin, p);
+#include "forward_table.h"
+#include "kernels.h"
+
+namespace {
+
+/** Parallel loop body that performs direct mapping of a range of image rows using forward table. */
+template <typename T>
+class DirectMapBody : public cv::ParallelLoopBody {
+ public:
+  DirectMapBody(const cv::Mat& E, const radical::ForwardTable& table, cv::Mat& I)
+  : E_(E)
+  , table_(table)
+  , I_(I) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    for (int row = range.start; row < range.end; ++row)
+      radical::kernels::directMap(E_.ptr<float>(row), I_.ptr<T>(row), E_.cols * 3, table_);
+  }
+
+ private:
+  const cv::Mat& E_;
+  const radical::ForwardTable& table_;
+  cv::Mat& I_;
+};
+
+/** Parallel loop body that performs inverse mapping of a range of image rows using lookup table. */
+template <typename T>
+class InverseMapBody : public cv::ParallelLoopBody {
+ public:
+  InverseMapBody(const cv::Mat& I, const cv::Mat& lut, cv::Mat& E)
+  : I_(I)
+  , lut_(lut)
+  , E_(E) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    for (int row = range.start; row < range.end; ++row)
+      radical::kernels::inverseMap(I_.ptr<T>(row), E_.ptr<float>(row), I_.cols * 3, lut_.ptr<float>(), lut_.cols);
+  }
+
+ private:
+  const cv::Mat& I_;
+  const cv::Mat& lut_;
+  cv::Mat& E_;
+};
+
+/** Rearrange a 3-channel lookup table into a 3 x N single-channel table (channel by channel). */
+cv::Mat toPlanar(const cv::Mat& lut) {
+  cv::Mat planar = lut.reshape(1, static_cast<int>(lut.total())).t();
+  return planar.clone();
+}
+
+/** Look up a pixel in a given planar lookup table, clamping out of range brightness values. */
+template <typename T>
+cv::Vec3f lookup(const cv::Mat& lut, const cv::Vec<T, 3>& I) {
+  const int max_level = lut.cols - 1;
+  return {lut.ptr<float>(0)[std::min<int>(I[0], max_level)], lut.ptr<float>(1)[std::min<int>(I[1], max_level)],
+          lut.ptr<float>(2)[std::min<int>(I[2], max_level)]};
+}
+
+/** Apply inverse mapping to an image using a given planar lookup table. */
+void inverseMapImage(cv::InputArray _I, cv::OutputArray _E, const cv::Mat& lut, int bit_depth) {
+  if (_I.empty()) {
+    _E.clear();
+    return;
   }
-  return out;
+  radical::Check("Brightness image", _I).hasType(bit_depth == 8 ? CV_8UC3 : CV_16UC3);
+  // Input should be obtained before the output is (re)allocated because they may refer to the same matrix
+  auto I = _I.getMat();
+  _E.create(I.size(), CV_32FC3);
+  auto E = _E.getMat();
+  if (bit_depth == 8)
+    cv::parallel_for_(cv::Range(0, I.rows), InverseMapBody<uint8_t>(I, lut, E));
+  else
+    cv::parallel_for_(cv::Range(0, I.rows), InverseMapBody<uint16_t>(I, lut, E));
+}
+
+/** Look up pixels at given image locations in a given planar lookup table. */
+template <typename T>
+void lookupPoints(const cv::Mat& lut, const cv::Mat& I, const cv::Point* points, cv::Vec3f* E, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    E[i] = lookup(lut, I.ptr<cv::Vec<T, 3>>(points[i].y)[points[i].x]);
+}
+
+/** Apply inverse mapping to pixels at given image locations using a given planar lookup table. */
+void inverseMapPoints(cv::InputArray _I, const cv::Point* points, cv::Vec3f* E, size_t n, const cv::Mat& lut,
+                      int bit_depth) {
+  if (n == 0)
+    return;
+  radical::Check("Brightness image", _I).hasType(bit_depth == 8 ? CV_8UC3 : CV_16UC3);
+  auto I = _I.getMat();
+  if (bit_depth == 8)
+    lookupPoints<uint8_t>(lut, I, points, E, n);
+  else
+    lookupPoints<uint16_t>(lut, I, points, E, n);
+}
+
+/** Get bit depth that corresponds to a given number of elements in the inverse response (zero if invalid). */
+int bitDepthFromSize(size_t num_elements) {
+  for (int bits = 8; bits <= 16; ++bits)
+    if (num_elements == (size_t(1) << bits))
+      return bits;
+  return 0;
+}
+
+/** Get the accepted number of elements in the inverse response that is closest to a given one. */
+size_t closestValidSize(size_t num_elements) {
+  int bits = 8;
+  while (bits < 16 && (size_t(1) << bits) < num_elements)
+    ++bits;
+  return size_t(1) << bits;
 }
 
+}  // anonymous namespace
+
 namespace radical {
 
-RadiometricResponse::RadiometricResponse(cv::InputArray _response) {
-  Check("Radiometric response", _response).hasSize(256).hasType(CV_32FC3);
+RadiometricResponse::RadiometricResponse(cv::InputArray _response, unsigned int forward_table_size)
+: bit_depth_(bitDepthFromSize(_response.total())) {
+  if (bit_depth_ == 0)
+    throw MatSizeException("Radiometric response", "2^N elements, N from 8 to 16",
+                           {static_cast<int>(closestValidSize(_response.total())), 1}, _response.size());
+  Check("Radiometric response", _response).hasType(CV_32FC3);
   response_ = _response.getMat();
-  cv::split(response_, response_channels_);
-  cv::log(response_, log_response_);
+  response_lut_ = toPlanar(response_);
+  forward_table_ = std::make_shared<ForwardTable>(response_lut_, forward_table_size);
+  cv::log(response_lut_, log_response_lut_);
   // Logarithm is only defined for positive numbers, everything else should map to -Inf
   const auto Inf = std::numeric_limits<float>::infinity();
-  cv::Mat_<bool> positive = (response_.reshape(1) > 0.0f) & (response_.reshape(1) != Inf);
+  cv::Mat_<bool> positive = (response_lut_ > 0.0f) & (response_lut_ != Inf);
   // We used the following code to assign all masked values to -Inf:
   //
-  //     log_response_.reshape(1).setTo(-Inf, ~positive);
+  //     log_response_lut_.setTo(-Inf, ~positive);
   //
   // However, it turned out that with certain compilers and OpenCV versions this assigns very large values, which are
   // not exactly Inf and thus don't pass std::isinf() test. The code below is more verbose, but works consistently.
-  cv::Mat_<float> log_response_flat = log_response_.reshape(1);
+  cv::Mat_<float> log_response_flat = log_response_lut_;
   for (size_t i = 0; i < log_response_flat.total(); ++i)
     if (!positive(i))
       log_response_flat(i) = -Inf;
 }
 
-RadiometricResponse::RadiometricResponse(const std::string& filename)
-: RadiometricResponse(readMat(filename)) {}
+RadiometricResponse::RadiometricResponse(const std::string& filename, unsigned int forward_table_size)
+: RadiometricResponse(readMat(filename), forward_table_size) {}
 
 RadiometricResponse::~RadiometricResponse() = default;
 
@@ -70,12 +179,24 @@ cv::Mat RadiometricResponse::getInverseResponse() const {
   return response_;
 }
 
+int RadiometricResponse::getBitDepth() const {
+  return bit_depth_;
+}
+
 void RadiometricResponse::save(const std::string& filename) const {
   writeMat(filename, response_);
 }
 
 cv::Vec3b RadiometricResponse::directMap(const cv::Vec3f& E) const {
-  return inverseLUT(response_channels_, E);
+  const auto& table = *forward_table_;
+  return {cv::saturate_cast<uint8_t>(table(0, E[0])), cv::saturate_cast<uint8_t>(table(1, E[1])),
+          cv::saturate_cast<uint8_t>(table(2, E[2]))};
+}
+
+cv::Vec3w RadiometricResponse::directMap16(const cv::Vec3f& E) const {
+  const auto& table = *forward_table_;
+  return {static_cast<uint16_t>(table(0, E[0])), static_cast<uint16_t>(table(1, E[1])),
+          static_cast<uint16_t>(table(2, E[2]))};
 }
 
 void RadiometricResponse::directMap(cv::InputArray _E, cv::OutputArray _I) const {
@@ -85,50 +206,64 @@ void RadiometricResponse::directMap(cv::InputArray _E, cv::OutputArray _I) const
   }
   Check("Irradiance image", _E).hasType(CV_32FC3);
   auto E = _E.getMat();
-  _I.create(_E.size(), CV_8UC3);
+  _I.create(_E.size(), bit_depth_ == 8 ? CV_8UC3 : CV_16UC3);
   auto I = _I.getMat();
-#if CV_MAJOR_VERSION > 2
-  E.forEach<cv::Vec3f>(
-      [&I, this](cv::Vec3f& v, const int* p) { I.at<cv::Vec3b>(p[0], p[1]) = inverseLUT(response_channels_, v); });
-#else
-  for (int i = 0; i < E.rows; i++)
-    for (int j = 0; j < E.cols; j++)
-      I.at<cv::Vec3b>(i, j) = inverseLUT(response_channels_, E.at<cv::Vec3f>(i, j));
-#endif
+  if (bit_depth_ == 8)
+    cv::parallel_for_(cv::Range(0, E.rows), DirectMapBody<uint8_t>(E, *forward_table_, I));
+  else
+    cv::parallel_for_(cv::Range(0, E.rows), DirectMapBody<uint16_t>(E, *forward_table_, I));
+}
+
+cv::Vec3f RadiometricResponse::inverseMap(const cv::Vec3b& I) const {
+  return lookup(response_lut_, I);
 }
 
-cv::Vec3f RadiometricResponse::inverseMap(const cv::Vec3b& _I) const {
-  cv::Mat I(1, 1, CV_8UC3);
-  I.at<cv::Vec3b>(0, 0) = _I;
-  cv::Mat E;
-  cv::LUT(I, response_, E);
-  return E.at<cv::Vec3f>(0, 0);
+cv::Vec3f RadiometricResponse::inverseMap(const cv::Vec3w& I) const {
+  return lookup(response_lut_, I);
 }
 
 void RadiometricResponse::inverseMap(cv::InputArray _I, cv::OutputArray _E) const {
-  if (_I.empty()) {
-    _E.clear();
-    return;
-  }
-  Check("Brightness image", _I).hasType(CV_8UC3);
-  cv::LUT(_I, response_, _E);
+  inverseMapImage(_I, _E, response_lut_, bit_depth_);
+}
+
+void RadiometricResponse::inverseMap(const cv::Vec3b* I, cv::Vec3f* E, size_t n) const {
+  kernels::inverseMap(reinterpret_cast<const uint8_t*>(I), reinterpret_cast<float*>(E), n * 3,
+                      response_lut_.ptr<float>(), response_lut_.cols);
+}
+
+void RadiometricResponse::inverseMap(const cv::Vec3w* I, cv::Vec3f* E, size_t n) const {
+  kernels::inverseMap(reinterpret_cast<const uint16_t*>(I), reinterpret_cast<float*>(E), n * 3,
+                      response_lut_.ptr<float>(), response_lut_.cols);
 }
 
-cv::Vec3f RadiometricResponse::inverseLogMap(const cv::Vec3b& _I) const {
-  cv::Mat I(1, 1, CV_8UC3);
-  I.at<cv::Vec3b>(0, 0) = _I;
-  cv::Mat E;
-  cv::LUT(I, log_response_, E);
-  return E.at<cv::Vec3f>(0, 0);
+void RadiometricResponse::inverseMap(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, size_t n) const {
+  inverseMapPoints(I, points, E, n, response_lut_, bit_depth_);
+}
+
+cv::Vec3f RadiometricResponse::inverseLogMap(const cv::Vec3b& I) const {
+  return lookup(log_response_lut_, I);
+}
+
+cv::Vec3f RadiometricResponse::inverseLogMap(const cv::Vec3w& I) const {
+  return lookup(log_response_lut_, I);
 }
 
 void RadiometricResponse::inverseLogMap(cv::InputArray _I, cv::OutputArray _E) const {
-  if (_I.empty()) {
-    _E.clear();
-    return;
-  }
-  Check("Brightness image", _I).hasType(CV_8UC3);
-  cv::LUT(_I, log_response_, _E);
+  inverseMapImage(_I, _E, log_response_lut_, bit_depth_);
+}
+
+void RadiometricResponse::inverseLogMap(const cv::Vec3b* I, cv::Vec3f* E, size_t n) const {
+  kernels::inverseMap(reinterpret_cast<const uint8_t*>(I), reinterpret_cast<float*>(E), n * 3,
+                      log_response_lut_.ptr<float>(), log_response_lut_.cols);
+}
+
+void RadiometricResponse::inverseLogMap(const cv::Vec3w* I, cv::Vec3f* E, size_t n) const {
+  kernels::inverseMap(reinterpret_cast<const uint16_t*>(I), reinterpret_cast<float*>(E), n * 3,
+                      log_response_lut_.ptr<float>(), log_response_lut_.cols);
+}
+
+void RadiometricResponse::inverseLogMap(cv::InputArray I, const cv::Point* points, cv::Vec3f* E, size_t n) const {
+  inverseMapPoints(I, points, E, n, log_response_lut_, bit_depth_);
 }
 
 }  // namespace radical
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "separable_fit.h"
+
+namespace {
+
+/** Normal matrix A^T A of a basis matrix A (banded, with bandwidth given by the support of the basis). */
+cv::Mat computeNormalMatrix(const radical::SeparableBasis& basis) {
+  cv::Mat normal = cv::Mat::zeros(basis.num_nodes, basis.num_nodes, CV_64FC1);
+  const int k = basis.support;
+  for (size_t p = 0; p < basis.indices.size(); ++p) {
+    const int i = basis.indices[p];
+    const float* w = &basis.weights[k * p];
+    for (int a = 0; a < k; ++a)
+      for (int b = 0; b < k; ++b)
+        normal.at<double>(i + a, i + b) += static_cast<double>(w[a]) * w[b];
+  }
+  return normal;
+}
+
+}  // anonymous namespace
+
+namespace radical {
+
+cv::Mat fitSeparable(const cv::Mat& response, const SeparableBasis& bx, const SeparableBasis& by) {
+  const int cols = bx.num_nodes, rows = by.num_nodes;
+  // Projection Ay^T F Ax, each pixel row is projected onto the columns of the grid and accumulated into grid rows
+  cv::Mat projection = cv::Mat::zeros(rows, cols * 3, CV_64FC1);
+  std::vector<double> projected_row(cols * 3);
+  for (int y = 0; y < response.rows; ++y) {
+    std::fill(projected_row.begin(), projected_row.end(), 0.0);
+    auto in = response.ptr<float>(y);
+    for (int x = 0; x < response.cols; ++x) {
+      double* out = &projected_row[3 * bx.indices[x]];
+      const float* w = &bx.weights[bx.support * x];
+      for (int k = 0; k < bx.support; ++k)
+        for (int c = 0; c < 3; ++c)
+          out[3 * k + c] += static_cast<double>(w[k]) * in[3 * x + c];
+    }
+    for (int k = 0; k < by.support; ++k) {
+      auto out = projection.ptr<double>(by.indices[y] + k);
+      const double w = by.weights[by.support * y + k];
+      for (int i = 0; i < cols * 3; ++i)
+        out[i] += w * projected_row[i];
+    }
+  }
+  // Solve along columns, then transpose (keeping channels interleaved) and solve along rows
+  cv::Mat solved_y, solved_x, nodes;
+  cv::solve(computeNormalMatrix(by), projection, solved_y, cv::DECOMP_CHOLESKY);
+  cv::Mat transposed = solved_y.reshape(3, rows).t();
+  cv::solve(computeNormalMatrix(bx), transposed.reshape(1, cols), solved_x, cv::DECOMP_CHOLESKY);
+  cv::Mat(solved_x.reshape(3, cols).t()).convertTo(nodes, CV_32F);
+  return nodes;
+}
+
+}  // namespace radical
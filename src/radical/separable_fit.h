@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace radical {
+
+/** Sparse basis matrix of a grid model along one dimension.
+  * Each pixel is a weighted sum of \c support consecutive grid nodes, starting with the node \c indices[p]. */
+struct SeparableBasis {
+  int num_nodes;
+  int support;
+  std::vector<int> indices;
+  std::vector<float> weights;  ///< \c support weights per pixel
+
+  SeparableBasis(int num_pixels, int num_nodes, int support)
+  : num_nodes(num_nodes), support(support), indices(num_pixels), weights(num_pixels * support) {}
+};
+
+/** Fit grid nodes to a dense response in the least-squares sense.
+  * The model surface is Ay G Ax^T, where Ax and Ay are the basis matrices along each dimension, so the nodes are
+  * G = (Ay^T Ay)^-1 Ay^T F Ax (Ax^T Ax)^-1, where F is the dense response. This averages out noise without biasing the
+  * result.
+  * \param[in] response dense response (CV_32FC3, one basis row per pixel in each dimension)
+  * \param[in] bx basis along columns
+  * \param[in] by basis along rows
+  * \returns grid nodes (CV_32FC3, \c by.num_nodes rows and \c bx.num_nodes columns) */
+cv::Mat fitSeparable(const cv::Mat& response, const SeparableBasis& bx, const SeparableBasis& by);
+
+}  // namespace radical
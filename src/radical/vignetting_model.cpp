@@ -20,27 +20,179 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include <radical/bspline_vignetting_model.h>
+#include <radical/compact_nonparametric_vignetting_model.h>
 #include <radical/exceptions.h>
 #include <radical/nonparametric_vignetting_model.h>
 #include <radical/polynomial_vignetting_model.h>
+#include <radical/radial_vignetting_model.h>
 #include <radical/vignetting_model.h>
 
+namespace {
+
+/** Parallel loop body that evaluates a vignetting model on a range of rows of a grid. */
+class GridEvaluationBody : public cv::ParallelLoopBody {
+ public:
+  GridEvaluationBody(const radical::VignettingModel& model, const cv::Rect& roi, float scale, cv::Mat& response)
+  : model_(model), roi_(roi), scale_(scale), response_(response) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    for (int row = range.start; row < range.end; ++row)
+      model_.evaluateRow(roi_.y + row, roi_.x, roi_.width, scale_, response_.ptr<float>(row), false);
+  }
+
+ private:
+  const radical::VignettingModel& model_;
+  cv::Rect roi_;
+  float scale_;
+  cv::Mat& response_;
+};
+
+}  // anonymous namespace
+
 namespace radical {
 
-#define TRY_LOAD(Model)                 \
-  if (!model)                           \
-    try {                               \
-      model.reset(new Model(filename)); \
-    } catch (SerializationException&) { \
-    }
+namespace {
+
+/** Create a model whose constructor takes coefficients and image size. */
+template <typename Model>
+VignettingModel::Ptr createModel(const std::string&, cv::InputArray coefficients, cv::Size image_size) {
+  return std::make_shared<Model>(coefficients, image_size);
+}
+
+/** Nonparametric model is a per-pixel map, so the image size is given by the coefficients. */
+VignettingModel::Ptr createNonparametricModel(const std::string&, cv::InputArray coefficients, cv::Size) {
+  return std::make_shared<NonparametricVignettingModel>(coefficients);
+}
+
+/** Polynomial model has the degree in its name (\sa PolynomialVignettingModel::getName()). */
+VignettingModel::Ptr createPolynomialModel(const std::string& name, cv::InputArray coefficients,
+                                           cv::Size image_size) {
+  std::string type;
+  unsigned int degree = 0;
+  std::stringstream(name) >> type >> degree;
+  return createPolynomialVignettingModel(degree, coefficients, image_size);
+}
+
+/** Registry of vignetting model readers keyed on the first token of the file header, and of vignetting model
+  * factories keyed on the first token of the model name. */
+class Registry {
+ public:
+  static Registry& get() {
+    static Registry registry;
+    return registry;
+  }
+
+  void addReader(const std::string& token, const VignettingModel::Reader& reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    readers_[token] = reader;
+  }
+
+  void addFactory(const std::string& token, const VignettingModel::Factory& factory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    factories_[token] = factory;
+  }
+
+  VignettingModel::Reader findReader(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto reader = readers_.find(token);
+    return reader != readers_.end() ? reader->second : nullptr;
+  }
+
+  VignettingModel::Factory findFactory(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto factory = factories_.find(token);
+    return factory != factories_.end() ? factory->second : nullptr;
+  }
+
+ private:
+  Registry() {
+    addBuiltin("NonparametricVignettingModel", "nonparametric", &NonparametricVignettingModel::read,
+               &createNonparametricModel);
+    addBuiltin("CompactNonparametricVignettingModel", "compact_nonparametric",
+               &CompactNonparametricVignettingModel::read, &createModel<CompactNonparametricVignettingModel>);
+    addBuiltin("PolynomialVignettingModel", "polynomial", &readPolynomialVignettingModel, &createPolynomialModel);
+    addBuiltin("RadialVignettingModel", "radial", &RadialVignettingModel::read, &createModel<RadialVignettingModel>);
+    addBuiltin("BSplineVignettingModel", "bspline", &BSplineVignettingModel::read,
+               &createModel<BSplineVignettingModel>);
+  }
+
+  void addBuiltin(const std::string& header_token, const std::string& name_token, VignettingModel::Reader reader,
+                  VignettingModel::Factory factory) {
+    readers_[header_token] = reader;
+    factories_[name_token] = factory;
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, VignettingModel::Reader> readers_;
+  std::unordered_map<std::string, VignettingModel::Factory> factories_;
+};
+
+}  // anonymous namespace
+
+float VignettingModel::getScale(cv::Size image_size) const {
+  auto x_scale = static_cast<float>(getImageSize().width) / image_size.width;
+  auto y_scale = static_cast<float>(getImageSize().height) / image_size.height;
+  if (std::abs(x_scale - y_scale) > std::numeric_limits<float>::epsilon())
+    throw Exception("Unable to compute vignetting response on the given image size (different aspect ratio)");
+  return x_scale;
+}
+
+void VignettingModel::evaluateRow(int row, int col, int width, float scale, float* response, bool reciprocal) const {
+  for (int x = col; x < col + width; ++x, response += 3) {
+    auto v = operator()(scale * x, scale * row);
+    for (int c = 0; c < 3; ++c)
+      response[c] = reciprocal ? 1.0f / v[c] : v[c];
+  }
+}
+
+void VignettingModel::evaluateGrid(const cv::Rect& roi, float scale, cv::OutputArray _response) const {
+  _response.create(roi.size(), CV_32FC3);
+  auto response = _response.getMat();
+  cv::parallel_for_(cv::Range(0, roi.height), GridEvaluationBody(*this, roi, scale, response));
+}
 
 VignettingModel::Ptr VignettingModel::load(const std::string& filename) {
-  VignettingModel::Ptr model = nullptr;
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    return nullptr;
+  std::string header, token;
+  std::getline(file, header);
+  std::stringstream(header) >> token;
+  auto reader = Registry::get().findReader(token);
+  if (!reader)
+    return nullptr;
+  try {
+    return reader(filename, file, header);
+  } catch (Exception&) {
+    // Header matched, but the file is malformed
+    return nullptr;
+  }
+}
 
-  TRY_LOAD(NonparametricVignettingModel);
-  TRY_LOAD(PolynomialVignettingModel<3>);
+void VignettingModel::registerReader(const std::string& token, Reader reader) {
+  Registry::get().addReader(token, reader);
+}
+
+VignettingModel::Ptr VignettingModel::create(const std::string& name, cv::InputArray coefficients,
+                                             cv::Size image_size) {
+  std::string token;
+  std::stringstream(name) >> token;
+  auto factory = Registry::get().findFactory(token);
+  if (!factory)
+    return nullptr;
+  return factory(name, coefficients, image_size);
+}
 
-  return model;
+void VignettingModel::registerFactory(const std::string& token, Factory factory) {
+  Registry::get().addFactory(token, factory);
 }
 
 }  // namespace radical
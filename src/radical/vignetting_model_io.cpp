@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <fstream>
+#include <sstream>
+
+#include <radical/exceptions.h>
+#include <radical/mat_io.h>
+
+#include "mapped_file.h"
+#include "vignetting_model_io.h"
+
+namespace radical {
+
+VignettingModel::Ptr readModelFile(const std::string& filename, const std::string& token,
+                                   const VignettingModel::Reader& reader) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    throw SerializationException("Unable to open vignetting model file", filename);
+  std::string header, name;
+  std::getline(file, header);
+  std::stringstream(header) >> name;
+  if (name != token)
+    throw SerializationException("Vignetting model stored in the file is not " + token, filename);
+  return reader(filename, file, header);
+}
+
+cv::Size parseImageSize(const std::string& header) {
+  std::string name;
+  int width = 0, height = 0;
+  std::stringstream(header) >> name >> width >> height;
+  return {width, height};
+}
+
+cv::Mat mapCoefficients(const std::string& filename, std::ifstream& file) {
+  return mapMat(filename, static_cast<size_t>(file.tellg()));
+}
+
+void writeModelFile(const std::string& filename, const std::string& token, cv::Size image_size,
+                    const cv::Mat& coefficients) {
+  ReplacementFile file(filename);
+  if (!file.is_open())
+    throw SerializationException("Unable to open file to save vignetting model", filename);
+  std::stringstream header;
+  header << token;
+  if (image_size.area() > 0)
+    header << " " << image_size.width << " " << image_size.height;
+  writeMat(file.stream(), header.str(), coefficients);
+  if (!file.commit())
+    throw SerializationException("Failed to save vignetting model", filename);
+}
+
+}  // namespace radical
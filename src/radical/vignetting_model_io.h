@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include <radical/vignetting_model.h>
+
+namespace radical {
+
+// File format shared by the vignetting models with memory-mapped coefficients: a header line with the model token and
+// (optionally) the image size, followed by the coefficients serialized with writeMat().
+
+/** Open a vignetting model file, check that its header starts with a given token, and read the model with a given
+  * reader. This is what filename constructors of the models do.
+  * SerializationException is thrown if the file can not be opened or stores a different model. */
+VignettingModel::Ptr readModelFile(const std::string& filename, const std::string& token,
+                                   const VignettingModel::Reader& reader);
+
+/** Parse image size that follows the token in a header line. */
+cv::Size parseImageSize(const std::string& header);
+
+/** Map coefficients that follow the header in a model file (\sa mapMat()).
+  * \param[in] filename path to the file
+  * \param[in] file stream positioned right after the header line */
+cv::Mat mapCoefficients(const std::string& filename, std::ifstream& file);
+
+/** Write a vignetting model file with a given token, image size (omitted if empty), and coefficients.
+  * The file is replaced only once it has been completely written (\sa ReplacementFile), so coefficients of a model
+  * loaded from the same file stay valid. SerializationException is thrown if writing fails. */
+void writeModelFile(const std::string& filename, const std::string& token, cv::Size image_size,
+                    const cv::Mat& coefficients);
+
+}  // namespace radical
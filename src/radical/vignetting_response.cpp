@@ -20,75 +20,405 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <radical/check.h>
 #include <radical/exceptions.h>
+#include <radical/mat_io.h>
 #include <radical/vignetting_model.h>
 #include <radical/vignetting_response.h>
 
-// Custom hasher to allow unordered map with cv::Size keys.
-namespace std {
-template <>
-struct hash<cv::Size> {
-  using argument_type = cv::Size;
-  using result_type = std::size_t;
-  result_type operator()(argument_type const& s) const {
-    result_type const h1(std::hash<int>()(s.width));
-    result_type const h2(std::hash<int>()(s.height));
-    return h1 ^ (h2 << 1);
+#include "mapped_file.h"
+
+namespace {
+
+/** Parallel loop body that multiplies image rows by the vignetting model (or its reciprocal) evaluated on the fly. */
+class RowEvaluationBody : public cv::ParallelLoopBody {
+ public:
+  RowEvaluationBody(const cv::Mat& I, const radical::VignettingModel& model, cv::Point offset, float scale,
+                    bool reciprocal, cv::Mat& O)
+  : I_(I), model_(model), offset_(offset), scale_(scale), reciprocal_(reciprocal), O_(O) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    const int n = I_.cols * 3;
+    std::vector<float> gain(n);
+    for (int row = range.start; row < range.end; ++row) {
+      model_.evaluateRow(offset_.y + row, offset_.x, I_.cols, scale_, gain.data(), reciprocal_);
+      auto in = I_.ptr<float>(row);
+      auto out = O_.ptr<float>(row);
+      for (int i = 0; i < n; ++i)
+        out[i] = in[i] * gain[i];
+    }
+  }
+
+ private:
+  const cv::Mat& I_;
+  const radical::VignettingModel& model_;
+  cv::Point offset_;
+  float scale_;
+  bool reciprocal_;
+  cv::Mat& O_;
+};
+
+/** Incremental 64-bit FNV-1a hash. */
+class FNV1a {
+ public:
+  void update(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+      hash_ = (hash_ ^ bytes[i]) * 0x100000001B3ULL;
   }
+
+  void update(const std::string& s) {
+    update(s.data(), s.size() + 1);
+  }
+
+  void update(int value) {
+    update(&value, sizeof(value));
+  }
+
+  uint64_t digest() const {
+    return hash_;
+  }
+
+ private:
+  uint64_t hash_ = 0xCBF29CE484222325ULL;
 };
-}  // namespace std
+
+}  // anonymous namespace
 
 namespace radical {
 
+/** Region \a rect of the pixel grid of the model image resampled with \a scale, i.e. image pixel (x, y) corresponds to
+  * model coordinates (scale * (rect.x + x), scale * (rect.y + y)). Full frames of any size and sensor windows map to
+  * regions, so that frames covering the same pixels share cached responses. */
+struct VignettingResponse::Region {
+  cv::Rect rect;
+  float scale;
+
+  bool operator==(const Region& other) const {
+    return rect == other.rect && scale == other.scale;
+  }
+
+  struct Hash {
+    size_t operator()(const Region& region) const {
+      size_t hash = std::hash<float>()(region.scale);
+      for (int value : {region.rect.x, region.rect.y, region.rect.width, region.rect.height})
+        hash = hash * 31 + std::hash<int>()(value);
+      return hash;
+    }
+  };
+};
+
+/** Cache of vignetting responses (and maps derived from them) for different image regions.
+  *
+  * Lookups do not take any locks. The cached responses are stored in an immutable map that is published through an
+  * atomic pointer. On a miss the response is computed under a mutex, a copy of the map with the new entry is created,
+  * and the pointer is swapped. Readers may still hold the previous map, therefore replaced maps are retired and only
+  * destroyed once no lookups are in progress.
+  *
+  * The total size of the cached responses is limited by a byte budget. When it is exceeded, the least recently used
+  * responses are evicted. Recency is tracked with an atomic timestamp in each entry, so hits stay lock-free. */
 struct VignettingResponse::ResponseCache {
-  std::unordered_map<cv::Size, cv::Mat> precomputed_responses_;
-  std::unordered_map<cv::Size, cv::Mat> precomputed_log_responses_;
+  /// Maps that are cached for each region, derived maps are computed lazily.
+  enum Kind { RESPONSE = 0, LOG_RESPONSE, RECIPROCAL_RESPONSE, NUM_KINDS };
+
+  /// Version of the maps stored in the cache directory, bump when the way maps are computed changes.
+  static const int DISK_FORMAT_VERSION = 2;
+
+  struct Entry {
+    cv::Mat maps[NUM_KINDS];
+    mutable std::atomic<uint64_t> last_used;
+
+    size_t bytes() const {
+      size_t bytes = 0;
+      for (const auto& map : maps)
+        bytes += map.total() * map.elemSize();
+      return bytes;
+    }
+  };
+
+  using Map = std::unordered_map<Region, std::shared_ptr<const Entry>, Region::Hash>;
+
+  std::atomic<const Map*> map_;
+  std::unique_ptr<const Map> current_map_;
+  std::vector<std::unique_ptr<const Map>> retired_maps_;
+  std::atomic<int> active_readers_;
+  std::atomic<bool> has_retired_maps_;
+  std::mutex mutex_;  // guards the slow path and the members above
   const VignettingModel& model_;
 
-  ResponseCache(const VignettingModel& model)
-  : model_(model) {}
-
-  cv::Mat get(const cv::Size& image_size) {
-    if (precomputed_responses_.count(image_size) == 0) {
-      auto x_scale = static_cast<float>(model_.getImageSize().width) / image_size.width;
-      auto y_scale = static_cast<float>(model_.getImageSize().height) / image_size.height;
-      if (std::abs(x_scale - y_scale) > std::numeric_limits<float>::epsilon())
-        throw Exception("Unable to compute vignetting response on the given image size (different aspect ratio)");
-      cv::Mat response(image_size, CV_32FC3);
-#if CV_MAJOR_VERSION > 2
-      response.forEach<cv::Vec3f>(
-          [x_scale, y_scale, this](cv::Vec3f& v, const int* p) { v = model_(x_scale * p[1], y_scale * p[0]); });
-#else
-      for (int i = 0; i < response.rows; i++)
-        for (int j = 0; j < response.cols; j++)
-          response.at<cv::Vec3f>(i, j) = model_(x_scale * j, y_scale * i);
-#endif
-      precomputed_responses_.insert({image_size, response});
+  std::atomic<size_t> budget_;
+  std::atomic<size_t> footprint_;
+  std::atomic<uint64_t> clock_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> evictions_;
+  std::atomic<uint64_t> disk_hits_;
+  std::string directory_;  // guarded by mutex_
+  std::string model_key_;  // content hash of the model, computed when the directory is set
+
+  ResponseCache(const VignettingModel& model, size_t budget)
+  : map_(nullptr)
+  , current_map_(new Map)
+  , active_readers_(0)
+  , has_retired_maps_(false)
+  , model_(model)
+  , budget_(budget)
+  , footprint_(0)
+  , clock_(0)
+  , hits_(0)
+  , misses_(0)
+  , evictions_(0)
+  , disk_hits_(0) {
+    map_.store(current_map_.get());
+  }
+
+  cv::Mat get(const Region& region, Kind kind) {
+    cv::Mat map;
+    if (lookup(region, kind, map))
+      return map;
+    return insert(region, kind)->maps[kind];
+  }
+
+  void setBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    publish(std::unique_ptr<Map>(new Map(*current_map_)), nullptr);
+  }
+
+  void setDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!directory.empty() && model_key_.empty())
+      model_key_ = computeModelKey();
+    directory_ = directory;
+  }
+
+  std::string getDirectory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_;
+  }
+
+  CacheStats getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CacheStats stats;
+    stats.budget = budget_;
+    stats.footprint = footprint_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.disk_hits = disk_hits_;
+    for (const auto& entry : *current_map_)
+      stats.sizes.push_back(entry.first.rect.size());
+    return stats;
+  }
+
+ private:
+  /** Fast path, looks up the map of a given kind in the currently published map. */
+  bool lookup(const Region& region, Kind kind, cv::Mat& result) {
+    // Announce the read before loading the map pointer, see reclaim()
+    active_readers_.fetch_add(1);
+    auto map = map_.load();
+    auto entry = map->find(region);
+    if (entry != map->end()) {
+      result = entry->second->maps[kind];
+      if (!result.empty())
+        entry->second->last_used.store(++clock_, std::memory_order_relaxed);
     }
-    return precomputed_responses_[image_size];
+    if (active_readers_.fetch_sub(1) == 1 && has_retired_maps_.load(std::memory_order_relaxed)) {
+      // The last reader to leave frees retired maps, unless a writer is busy (it will do this itself)
+      std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+      if (lock)
+        reclaim();
+    }
+    if (result.empty())
+      return false;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
   }
 
-  cv::Mat getLog(const cv::Size& image_size) {
-    if (precomputed_log_responses_.count(image_size) == 0) {
-      cv::Mat log;
-      cv::log(get(image_size), log);
-      precomputed_log_responses_.insert({image_size, log});
+  /** Slow path, computes the map of a given kind (and the response it is derived from) and publishes an updated map. */
+  std::shared_ptr<const Entry> insert(const Region& region, Kind kind) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<Entry> entry(new Entry);
+    // Another thread might have computed the map while we were waiting for the lock
+    auto existing = current_map_->find(region);
+    if (existing != current_map_->end()) {
+      if (!existing->second->maps[kind].empty()) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return existing->second;
+      }
+      for (int k = 0; k < NUM_KINDS; ++k)
+        entry->maps[k] = existing->second->maps[k];
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    if (!read(region, kind, entry->maps[kind])) {
+      // Derived maps are computed from the response, which is only retained in the entry if it was requested itself
+      cv::Mat response = entry->maps[RESPONSE];
+      if (response.empty() && (kind == RESPONSE || !read(region, RESPONSE, response))) {
+        response = compute(region);
+        write(region, RESPONSE, response);
+      }
+      if (kind == RESPONSE)
+        entry->maps[RESPONSE] = response;
+      else if (kind == LOG_RESPONSE)
+        cv::log(response, entry->maps[LOG_RESPONSE]);
+      else if (kind == RECIPROCAL_RESPONSE)
+        cv::divide(1.0, response, entry->maps[RECIPROCAL_RESPONSE]);
+      if (kind != RESPONSE)
+        write(region, kind, entry->maps[kind]);
+    }
+    entry->last_used = ++clock_;
+    std::unique_ptr<Map> map(new Map(*current_map_));
+    (*map)[region] = entry;
+    publish(std::move(map), entry.get());
+    return entry;
+  }
+
+  /** Evict least recently used entries (except for \a keep) until the budget is met and publish the map. */
+  void publish(std::unique_ptr<Map> map, const Entry* keep) {
+    size_t footprint = 0;
+    for (const auto& entry : *map)
+      footprint += entry.second->bytes();
+    while (footprint > budget_) {
+      auto lru = map->end();
+      for (auto entry = map->begin(); entry != map->end(); ++entry)
+        if (entry->second.get() != keep &&
+            (lru == map->end() || entry->second->last_used < lru->second->last_used))
+          lru = entry;
+      if (lru == map->end())
+        break;
+      footprint -= lru->second->bytes();
+      map->erase(lru);
+      ++evictions_;
+    }
+    footprint_ = footprint;
+    retired_maps_.push_back(std::move(current_map_));
+    has_retired_maps_ = true;
+    current_map_ = std::move(map);
+    map_.store(current_map_.get());
+    reclaim();
+  }
+
+  /** Destroy retired maps if no lookups are in progress.
+    * A lookup that starts after this check is guaranteed to load the current map, because the check is sequenced
+    * after the store of the map pointer and the lookup increments the counter before loading it. */
+  void reclaim() {
+    if (active_readers_.load() == 0) {
+      retired_maps_.clear();
+      has_retired_maps_ = false;
+    }
+  }
+
+  cv::Mat compute(const Region& region) const {
+    cv::Mat response;
+    model_.evaluateGrid(region.rect, region.scale, response);
+    return response;
+  }
+
+  /** Identify the model by its name, image size, and coefficients. */
+  std::string computeModelKey() const {
+    FNV1a hash;
+    hash.update(DISK_FORMAT_VERSION);
+    hash.update(model_.getName());
+    hash.update(model_.getImageSize().width);
+    hash.update(model_.getImageSize().height);
+    auto coefficients = model_.getModelCoefficients();
+    hash.update(coefficients.type());
+    hash.update(coefficients.rows);
+    hash.update(coefficients.cols);
+    for (int row = 0; row < coefficients.rows; ++row)
+      hash.update(coefficients.ptr(row), coefficients.cols * coefficients.elemSize());
+    std::stringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash.digest();
+    return key.str();
+  }
+
+  /** Header line of a map stored in the cache directory, also used to validate the file. */
+  std::string getHeader(const Region& region, Kind kind) const {
+    std::stringstream header;
+    header << "VignettingResponseMap " << model_key_ << " " << region.rect.x << " " << region.rect.y << " "
+           << region.rect.width << " " << region.rect.height << " " << std::setprecision(9) << region.scale << " "
+           << kind;
+    return header.str();
+  }
+
+  std::string getPath(const Region& region, Kind kind) const {
+    static const char* const names[NUM_KINDS] = {"response", "log", "reciprocal"};
+    std::stringstream path;
+    path << directory_ << "/" << model_key_ << "_" << region.rect.width << "x" << region.rect.height << "+"
+         << region.rect.x << "+" << region.rect.y << "@" << std::setprecision(9) << region.scale << "_" << names[kind]
+         << ".vrm";
+    return path.str();
+  }
+
+  /** Map a map of a given kind from the cache directory (if enabled and the file is valid). */
+  bool read(const Region& region, Kind kind, cv::Mat& map) {
+    if (directory_.empty())
+      return false;
+    const auto path = getPath(region, kind);
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    std::string header;
+    if (!file.is_open() || !std::getline(file, header))
+      return false;
+    // Header line is padded with spaces to align the data
+    header.erase(header.find_last_not_of(' ') + 1);
+    if (header != getHeader(region, kind))
+      return false;
+    try {
+      map = mapMat(path, static_cast<size_t>(file.tellg()));
+    } catch (Exception&) {
+      map.release();
+      return false;
+    }
+    if (map.size() != region.rect.size() || map.type() != CV_32FC3) {
+      map.release();
+      return false;
+    }
+    disk_hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /** Store a map of a given kind in the cache directory (if enabled).
+    * The file is written under a temporary name and renamed, so concurrent readers (possibly in other processes) never
+    * see partially written maps. Failures are ignored, the directory is merely a cache. */
+  void write(const Region& region, Kind kind, const cv::Mat& map) {
+    if (directory_.empty())
+      return;
+    ReplacementFile file(getPath(region, kind));
+    if (file.is_open()) {
+      writeMat(file.stream(), getHeader(region, kind), map);
+      file.commit();
     }
-    return precomputed_log_responses_[image_size];
   }
 };
 
-VignettingResponse::VignettingResponse(const std::string& filename) {
+constexpr size_t VignettingResponse::DEFAULT_CACHE_BUDGET;
+
+VignettingResponse::VignettingResponse(const std::string& filename, size_t cache_budget) {
   model_ = VignettingModel::load(filename);
   if (!model_)
     throw SerializationException("File does not contain any valid vignetting model", filename);
 
-  response_cache_.reset(new ResponseCache(*model_));
+  response_cache_.reset(new ResponseCache(*model_, cache_budget));
+  evaluation_ = Evaluation::Precomputed;
+}
+
+VignettingResponse::VignettingResponse(VignettingModel::ConstPtr model, size_t cache_budget)
+: model_(model) {
+  if (!model_)
+    throw Exception("Vignetting model is not set");
+
+  response_cache_.reset(new ResponseCache(*model_, cache_budget));
+  evaluation_ = Evaluation::Precomputed;
 }
 
 VignettingResponse::~VignettingResponse() = default;
@@ -98,19 +428,61 @@ VignettingModel::ConstPtr VignettingResponse::getModel() const {
 }
 
 cv::Mat VignettingResponse::getResponse() const {
-  return response_cache_->get(model_->getImageSize());
+  return getResponse(model_->getImageSize());
 }
 
 cv::Mat VignettingResponse::getResponse(cv::Size image_size) const {
-  return response_cache_->get(image_size);
+  return response_cache_->get(getRegion(image_size), ResponseCache::RESPONSE);
 }
 
 cv::Mat VignettingResponse::getLogResponse() const {
-  return response_cache_->getLog(model_->getImageSize());
+  return getLogResponse(model_->getImageSize());
 }
 
 cv::Mat VignettingResponse::getLogResponse(cv::Size image_size) const {
-  return response_cache_->getLog(image_size);
+  return response_cache_->get(getRegion(image_size), ResponseCache::LOG_RESPONSE);
+}
+
+cv::Mat VignettingResponse::getReciprocalResponse(cv::Size image_size) const {
+  return response_cache_->get(getRegion(image_size), ResponseCache::RECIPROCAL_RESPONSE);
+}
+
+cv::Mat VignettingResponse::getResponse(const SensorWindow& window) const {
+  return response_cache_->get(getRegion(window), ResponseCache::RESPONSE);
+}
+
+cv::Mat VignettingResponse::getLogResponse(const SensorWindow& window) const {
+  return response_cache_->get(getRegion(window), ResponseCache::LOG_RESPONSE);
+}
+
+cv::Mat VignettingResponse::getReciprocalResponse(const SensorWindow& window) const {
+  return response_cache_->get(getRegion(window), ResponseCache::RECIPROCAL_RESPONSE);
+}
+
+void VignettingResponse::setEvaluation(Evaluation evaluation) {
+  if (evaluation == Evaluation::OnTheFly && !model_->supportsRowEvaluation())
+    throw Exception("Vignetting model does not support evaluation on the fly");
+  evaluation_ = evaluation;
+}
+
+VignettingResponse::Evaluation VignettingResponse::getEvaluation() const {
+  return evaluation_;
+}
+
+void VignettingResponse::setCacheBudget(size_t bytes) {
+  response_cache_->setBudget(bytes);
+}
+
+void VignettingResponse::setCacheDirectory(const std::string& directory) {
+  response_cache_->setDirectory(directory);
+}
+
+std::string VignettingResponse::getCacheDirectory() const {
+  return response_cache_->getDirectory();
+}
+
+VignettingResponse::CacheStats VignettingResponse::getCacheStats() const {
+  return response_cache_->getStats();
 }
 
 void VignettingResponse::remove(cv::InputArray _E, cv::OutputArray _L) const {
@@ -119,7 +491,30 @@ void VignettingResponse::remove(cv::InputArray _E, cv::OutputArray _L) const {
     return;
   }
   Check("Irradiance image", _E).hasType(CV_32FC3);
-  cv::divide(_E, getResponse(_E.size()), _L);
+  multiply(_E, _L, getRegion(_E.size()), true);
+}
+
+void VignettingResponse::remove(cv::InputArray _E, cv::OutputArray _L, const SensorWindow& window) const {
+  auto region = getRegion(window);
+  Check("Irradiance image", _E).hasSize(region.rect.size()).hasType(CV_32FC3);
+  multiply(_E, _L, region, true);
+}
+
+void VignettingResponse::remove(cv::Size image_size, const cv::Point* points, const cv::Vec3f* E, cv::Vec3f* L,
+                                size_t n) const {
+  if (n == 0)
+    return;
+  if (evaluation_ == Evaluation::OnTheFly) {
+    auto scale = model_->getScale(image_size);
+    for (size_t i = 0; i < n; ++i) {
+      auto v = (*model_)(scale * points[i].x, scale * points[i].y);
+      L[i] = cv::Vec3f(E[i][0] / v[0], E[i][1] / v[1], E[i][2] / v[2]);
+    }
+    return;
+  }
+  auto gain = getReciprocalResponse(image_size);
+  for (size_t i = 0; i < n; ++i)
+    L[i] = E[i].mul(gain.at<cv::Vec3f>(points[i]));
 }
 
 void VignettingResponse::removeLog(cv::InputArray _E, cv::OutputArray _L) const {
@@ -131,13 +526,34 @@ void VignettingResponse::removeLog(cv::InputArray _E, cv::OutputArray _L) const
   cv::subtract(_E, getLogResponse(_E.size()), _L);
 }
 
+void VignettingResponse::removeLog(cv::InputArray _E, cv::OutputArray _L, const SensorWindow& window) const {
+  auto region = getRegion(window);
+  Check("Irradiance image", _E).hasSize(region.rect.size()).hasType(CV_32FC3);
+  cv::subtract(_E, response_cache_->get(region, ResponseCache::LOG_RESPONSE), _L);
+}
+
+void VignettingResponse::removeLog(cv::Size image_size, const cv::Point* points, const cv::Vec3f* E, cv::Vec3f* L,
+                                   size_t n) const {
+  if (n == 0)
+    return;
+  auto response = getLogResponse(image_size);
+  for (size_t i = 0; i < n; ++i)
+    L[i] = E[i] - response.at<cv::Vec3f>(points[i]);
+}
+
 void VignettingResponse::add(cv::InputArray _L, cv::OutputArray _E) const {
   if (_L.empty()) {
     _E.clear();
     return;
   }
   Check("Radiance image", _L).hasType(CV_32FC3);
-  cv::multiply(_L, getResponse(_L.size()), _E);
+  multiply(_L, _E, getRegion(_L.size()), false);
+}
+
+void VignettingResponse::add(cv::InputArray _L, cv::OutputArray _E, const SensorWindow& window) const {
+  auto region = getRegion(window);
+  Check("Radiance image", _L).hasSize(region.rect.size()).hasType(CV_32FC3);
+  multiply(_L, _E, region, false);
 }
 
 void VignettingResponse::addLog(cv::InputArray _L, cv::OutputArray _E) const {
@@ -149,4 +565,48 @@ void VignettingResponse::addLog(cv::InputArray _L, cv::OutputArray _E) const {
   cv::add(_L, getLogResponse(_L.size()), _E);
 }
 
+void VignettingResponse::addLog(cv::InputArray _L, cv::OutputArray _E, const SensorWindow& window) const {
+  auto region = getRegion(window);
+  Check("Radiance image", _L).hasSize(region.rect.size()).hasType(CV_32FC3);
+  cv::add(_L, response_cache_->get(region, ResponseCache::LOG_RESPONSE), _E);
+}
+
+VignettingResponse::Region VignettingResponse::getRegion(cv::Size image_size) const {
+  return {cv::Rect(cv::Point(0, 0), image_size), model_->getScale(image_size)};
+}
+
+VignettingResponse::Region VignettingResponse::getRegion(const SensorWindow& window) const {
+  const auto& roi = window.roi;
+  const int binning = window.binning;
+  if (binning < 1)
+    throw Exception("Binning factor of sensor window should be positive");
+  if (roi.width < binning || roi.height < binning)
+    throw Exception("Sensor window should contain at least one binned pixel");
+  if ((roi & cv::Rect(cv::Point(0, 0), model_->getImageSize())) != roi)
+    throw Exception("Sensor window should be inside of the sensor");
+  // Otherwise binned pixels would not be aligned with the pixel grid of the model image scaled by the binning factor
+  if (roi.x % binning != 0 || roi.y % binning != 0)
+    throw Exception("Origin of sensor window should be a multiple of the binning factor");
+  auto size = window.getImageSize();
+  return {cv::Rect(roi.x / binning, roi.y / binning, size.width, size.height), static_cast<float>(binning)};
+}
+
+void VignettingResponse::multiply(cv::InputArray _I, cv::OutputArray _O, const Region& region, bool reciprocal) const {
+  if (evaluation_ == Evaluation::OnTheFly)
+    applyOnTheFly(_I, _O, region, reciprocal);
+  else {
+    auto kind = reciprocal ? ResponseCache::RECIPROCAL_RESPONSE : ResponseCache::RESPONSE;
+    cv::multiply(_I, response_cache_->get(region, kind), _O);
+  }
+}
+
+void VignettingResponse::applyOnTheFly(cv::InputArray _I, cv::OutputArray _O, const Region& region,
+                                       bool reciprocal) const {
+  auto I = _I.getMat();
+  _O.create(I.size(), CV_32FC3);
+  auto O = _O.getMat();
+  cv::parallel_for_(cv::Range(0, I.rows),
+                    RowEvaluationBody(I, *model_, region.rect.tl(), region.scale, reciprocal, O));
+}
+
 }  // namespace radical
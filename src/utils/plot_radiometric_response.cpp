@@ -20,6 +20,7 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <cassert>
 
 #include <opencv2/imgproc/imgproc.hpp>
@@ -34,20 +35,24 @@ namespace utils {
 using radical::Check;
 
 void plotRadiometricResponse(const cv::Mat& response, cv::Mat& canvas, const cv::Scalar& color) {
-  Check("Radiometric response", response).hasDepth(CV_32F).hasSize(256);
+  Check("Radiometric response", response).notEmpty().hasDepth(CV_32F);
   Check("Canvas", canvas).notEmpty().hasType(CV_8UC3);
 
-  auto x_scale = static_cast<float>(canvas.cols) / 256.0f;
+  // Response may have more brightness levels than there are pixels in the canvas, plot at most one point per column
+  const int levels = static_cast<int>(response.total());
+  const int step = std::max(1, levels / canvas.cols);
+  auto x_scale = static_cast<float>(canvas.cols) / levels;
+  auto radius = static_cast<int>(std::ceil(x_scale * step));
   double min, max;
   cv::minMaxIdx(response, &min, &max);
   // auto y_scale = static_cast<float>(canvas.rows) / 1.2;
   auto y_scale = static_cast<float>(canvas.rows) / max;
 
-  auto circle = [&canvas, x_scale, y_scale](float x, float y, const cv::Scalar& color) {
-    cv::circle(canvas, cv::Point(x * x_scale, canvas.size().height - y * y_scale), std::ceil(x_scale), color, -1);
+  auto circle = [&canvas, x_scale, y_scale, radius](float x, float y, const cv::Scalar& color) {
+    cv::circle(canvas, cv::Point(x * x_scale, canvas.size().height - y * y_scale), radius, color, -1);
   };
 
-  for (int i = 0; i < 256; ++i) {
+  for (int i = 0; i < levels; i += step) {
     if (response.channels() == 1)
       circle(i, response.at<float>(i), color);
     else
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+
+#include "test.h"
+
+#include <radical/bspline_vignetting_model.h>
+#include <radical/exceptions.h>
+#include <radical/vignetting_model.h>
+
+using namespace radical;
+
+/** Off-center, non-symmetric response that is a cubic polynomial along each dimension. */
+cv::Mat createDenseResponse(cv::Size size) {
+  cv::Mat m(size, CV_32FC3);
+  for (int row = 0; row < size.height; ++row)
+    for (int col = 0; col < size.width; ++col) {
+      const float x = static_cast<float>(col) / size.width - 0.6f;
+      const float y = static_cast<float>(row) / size.height - 0.4f;
+      const float v = 1.0f - 0.8f * x * x - 0.5f * y * y + 0.2f * x * x * x + 0.1f * x * y;
+      m.at<cv::Vec3f>(row, col) = cv::Vec3f(v, 0.9f * v, 0.8f * v);
+    }
+  return m;
+}
+
+BOOST_AUTO_TEST_CASE(MatConstructor) {
+  cv::Mat m;
+  BOOST_CHECK_THROW(BSplineVignettingModel vm(m, {64, 48}), MatException);
+  m.create(4, 4, CV_64FC3);
+  BOOST_CHECK_THROW(BSplineVignettingModel vm(m, {64, 48}), MatTypeException);
+  m.create(3, 4, CV_32FC3);
+  BOOST_CHECK_THROW(BSplineVignettingModel vm(m, {64, 48}), Exception);
+  m.create(4, 5, CV_32FC3);
+  m.setTo(0.7f);
+  BOOST_CHECK_THROW(BSplineVignettingModel vm(m, {1, 48}), Exception);
+  BSplineVignettingModel vm(m, {64, 48});
+  BOOST_CHECK_EQUAL(vm.getName(), "bspline");
+  BOOST_CHECK_EQUAL(vm.getImageSize(), cv::Size(64, 48));
+  BOOST_CHECK_EQUAL_MAT(vm.getModelCoefficients(), m, cv::Vec3f);
+  // Basis functions sum up to one
+  for (float x : {0.0f, 10.3f, 31.5f, 63.0f})
+    for (float y : {0.0f, 7.7f, 47.0f})
+      for (int c = 0; c < 3; ++c)
+        BOOST_CHECK_CLOSE(vm(x, y)[c], 0.7f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(FromDense) {
+  const cv::Size size(96, 72);
+  auto dense = createDenseResponse(size);
+  BOOST_CHECK_THROW(BSplineVignettingModel::fromDense(dense, {3, 6}), Exception);
+  BOOST_CHECK_THROW(BSplineVignettingModel::fromDense(dense, {8, 100}), Exception);
+  // Cubic polynomials are reproduced exactly (up to rounding)
+  auto vm = BSplineVignettingModel::fromDense(dense, {8, 6});
+  BOOST_CHECK_EQUAL(vm->getModelCoefficients().size(), cv::Size(8, 6));
+  cv::Mat response;
+  vm->evaluateGrid(size, 1.0f, response);
+  BOOST_CHECK_LT(cv::norm(response, dense, cv::NORM_INF), 1e-4);
+  // Noise is smoothed out
+  setRNGSeed(1);
+  cv::Mat noise(size, CV_32FC3), noisy;
+  cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(0.02));
+  noisy = dense + noise;
+  vm = BSplineVignettingModel::fromDense(noisy, {16, 12});
+  vm->evaluateGrid(size, 1.0f, response);
+  BOOST_CHECK_LT(cv::norm(response, dense, cv::NORM_INF), 0.5 * cv::norm(noisy, dense, cv::NORM_INF));
+}
+
+BOOST_AUTO_TEST_CASE(EvaluateRowAndGrid) {
+  auto vm = BSplineVignettingModel::fromDense(createDenseResponse({64, 48}), {9, 7});
+  BOOST_CHECK(vm->supportsRowEvaluation());
+  for (const auto& size : {cv::Size(64, 48), cv::Size(128, 96), cv::Size(16, 12)}) {
+    const float scale = vm->getScale(size);
+    const cv::Rect roi(3, 5, size.width / 2, size.height / 3);
+    cv::Mat response;
+    vm->evaluateGrid(roi, scale, response);
+    BOOST_REQUIRE_EQUAL(response.size(), roi.size());
+    BOOST_REQUIRE_EQUAL(response.type(), CV_32FC3);
+    std::vector<float> row_response(3 * roi.width), row_reciprocal(3 * roi.width);
+    for (int row = 0; row < roi.height; ++row) {
+      vm->evaluateRow(roi.y + row, roi.x, roi.width, scale, row_response.data(), false);
+      vm->evaluateRow(roi.y + row, roi.x, roi.width, scale, row_reciprocal.data(), true);
+      for (int col = 0; col < roi.width; ++col) {
+        const auto expected = (*vm)(scale * (roi.x + col), scale * (roi.y + row));
+        for (int c = 0; c < 3; ++c) {
+          BOOST_CHECK_SMALL(response.at<cv::Vec3f>(row, col)[c] - expected[c], 1e-5f);
+          BOOST_CHECK_SMALL(row_response[3 * col + c] - expected[c], 1e-5f);
+          BOOST_CHECK_SMALL(row_reciprocal[3 * col + c] - 1.0f / expected[c], 1e-5f);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SaveLoad) {
+  auto vm = BSplineVignettingModel::fromDense(createDenseResponse({64, 48}), {9, 7});
+  auto f = getTemporaryFilename();
+  vm->save(f);
+  BSplineVignettingModel loaded(f);
+  BOOST_CHECK_EQUAL(loaded.getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(loaded.getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  auto model = VignettingModel::load(f);
+  BOOST_REQUIRE(std::dynamic_pointer_cast<BSplineVignettingModel>(model) != nullptr);
+  BOOST_CHECK_EQUAL(model->getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(model->getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  BOOST_CHECK_THROW(BSplineVignettingModel(getTestFilename("nonparametric_vignetting_model_identity.vgn")),
+                    SerializationException);
+}
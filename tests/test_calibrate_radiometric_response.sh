@@ -11,7 +11,8 @@ function fle() {
 exe="$1"
 dir="$2/radiometric_response_calibration"
 
-methods=("debevec" "engel")
+methods=("debevec" "engel" "engel --subsample 20000" "engel --subsample 20000 --no-refine" "engel --anderson 5"
+         "engel --subsample 20000 --anderson 5" "engel --subsample 20000 --no-refine --anderson 5")
 for method in "${methods[@]}"; do
   crf=$($exe $dir --verbosity 0 --no-visualization --print --method $method -o /tmp/crf)
   if [[ $? -ne 0 ]]; then
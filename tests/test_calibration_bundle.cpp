@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "test.h"
+
+#include <radical/calibration_bundle.h>
+#include <radical/exceptions.h>
+#include <radical/polynomial_vignetting_model.h>
+
+using namespace radical;
+
+/** Overwrite a byte at a given position in a file. */
+void corrupt(const std::string& filename, size_t position) {
+  std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekg(position);
+  char c = static_cast<char>(file.get());
+  file.seekp(position);
+  file.put(static_cast<char>(c ^ 0x5A));
+}
+
+BOOST_AUTO_TEST_CASE(SaveLoad) {
+  setRNGSeed(1);
+  CalibrationBundle bundle;
+  BOOST_CHECK(bundle.getSectionNames().empty());
+  cv::Mat m1(7, 13, CV_64FC3), m2(1, 3, CV_16UC1), m3(5, 5, CV_8UC1);
+  cv::randu(m1, cv::Scalar::all(-100), cv::Scalar::all(100));
+  cv::randu(m2, cv::Scalar::all(0), cv::Scalar::all(60000));
+  cv::randu(m3, cv::Scalar::all(0), cv::Scalar::all(255));
+  bundle.setMat("m1", m1);
+  bundle.setMat("m2", m2);
+  bundle.setMat("m3", m3);
+  bundle.setString("note", "calibrated in the lab");
+  bundle.setString("empty", "");
+  bundle.setCameraUID("1234-ABCD");
+  bundle.setResolution({640, 480});
+  BOOST_CHECK_THROW(bundle.setString("", "x"), Exception);
+  BOOST_CHECK_THROW(bundle.setString(std::string(32, 'x'), "x"), Exception);
+
+  auto f = getTemporaryFilename();
+  bundle.save(f);
+  CalibrationBundle loaded(f);
+  BOOST_CHECK(loaded.getSectionNames() == bundle.getSectionNames());
+  BOOST_CHECK_EQUAL_MAT(loaded.getMat("m1"), m1, cv::Vec3d);
+  BOOST_CHECK_EQUAL_MAT(loaded.getMat("m2"), m2, uint16_t);
+  BOOST_CHECK_EQUAL_MAT(loaded.getMat("m3"), m3, uint8_t);
+  BOOST_CHECK_EQUAL(loaded.getString("note"), "calibrated in the lab");
+  BOOST_CHECK_EQUAL(loaded.getString("empty"), "");
+  BOOST_CHECK_EQUAL(loaded.getCameraUID(), "1234-ABCD");
+  BOOST_CHECK_EQUAL(loaded.getResolution(), cv::Size(640, 480));
+  BOOST_CHECK(!loaded.has("m4"));
+  BOOST_CHECK_THROW(loaded.getMat("m4"), Exception);
+  BOOST_CHECK_THROW(loaded.getMat("note"), Exception);
+  BOOST_CHECK_THROW(loaded.getString("m1"), Exception);
+  BOOST_CHECK(loaded.getRadiometricResponse() == nullptr);
+  BOOST_CHECK(loaded.getVignettingModel() == nullptr);
+
+  loaded.remove("m1");
+  BOOST_CHECK(!loaded.has("m1"));
+}
+
+BOOST_AUTO_TEST_CASE(Alignment) {
+  CalibrationBundle bundle;
+  bundle.setString("a", "odd");
+  bundle.setMat("b", cv::Mat(3, 7, CV_8UC3, cv::Scalar::all(1)));
+  bundle.setMat("c", cv::Mat(5, 5, CV_32FC3, cv::Scalar::all(2)));
+  auto f = getTemporaryFilename();
+  bundle.save(f);
+#if CV_MAJOR_VERSION > 2
+  // Data is mapped in place and is aligned
+  CalibrationBundle loaded(f);
+  for (const char* name : {"b", "c"})
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(loaded.getMat(name).data) % CalibrationBundle::ALIGNMENT, 0);
+#endif
+  // Loaded data stays valid after the bundle is destroyed
+  cv::Mat c;
+  {
+    CalibrationBundle other(f);
+    c = other.getMat("c");
+  }
+  BOOST_CHECK_EQUAL_MAT(c, cv::Vec3f(2, 2, 2), cv::Vec3f);
+}
+
+BOOST_AUTO_TEST_CASE(Corruption) {
+  CalibrationBundle bundle;
+  bundle.setMat("data", cv::Mat(16, 16, CV_32FC1, cv::Scalar(1)));
+  auto f = getTemporaryFilename();
+  bundle.save(f);
+  // Payload of the only section starts right after the file header and the section table
+  corrupt(f, 2 * 64 + 100);
+  BOOST_CHECK_THROW(CalibrationBundle{f}, SerializationException);
+  bundle.save(f);
+  // Section table
+  corrupt(f, 64 + 2);
+  BOOST_CHECK_THROW(CalibrationBundle{f}, SerializationException);
+  bundle.save(f);
+  // Version from the future
+  corrupt(f, 10);
+  BOOST_CHECK_THROW(CalibrationBundle{f}, SerializationException);
+  bundle.save(f);
+  BOOST_CHECK_NO_THROW(CalibrationBundle{f});
+}
+
+BOOST_AUTO_TEST_CASE(Invalid) {
+  BOOST_CHECK_THROW(CalibrationBundle(getTestFilename("file_that_does_not_exist.calib")), SerializationException);
+  BOOST_CHECK_THROW(CalibrationBundle(getTestFilename("vignetting_model_empty.vgn")), SerializationException);
+  BOOST_CHECK_THROW(CalibrationBundle(getTestFilename("radiometric_response_identity.crf")), SerializationException);
+}
+
+BOOST_AUTO_TEST_CASE(Models) {
+  RadiometricResponse rr(getTestFilename("radiometric_response_scaling.crf"));
+  auto polynomial = VignettingModel::load(getTestFilename("polynomial_vignetting_model_identity.vgn"));
+  auto nonparametric = VignettingModel::load(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  for (const auto& model : {polynomial, nonparametric}) {
+    CalibrationBundle bundle;
+    bundle.setRadiometricResponse(rr);
+    bundle.setVignettingModel(*model);
+    auto f = getTemporaryFilename();
+    bundle.save(f);
+
+    CalibrationBundle loaded(f);
+    BOOST_CHECK(loaded.getResolution().area() == 0);
+    auto loaded_rr = loaded.getRadiometricResponse();
+    BOOST_REQUIRE(loaded_rr != nullptr);
+    BOOST_CHECK_EQUAL_MAT(loaded_rr->getInverseResponse(), rr.getInverseResponse(), cv::Vec3f);
+    auto loaded_model = loaded.getVignettingModel();
+    BOOST_REQUIRE(loaded_model != nullptr);
+    BOOST_CHECK_EQUAL(loaded_model->getName(), model->getName());
+    BOOST_CHECK_EQUAL(loaded_model->getImageSize(), model->getImageSize());
+    cv::Mat expected, actual;
+    model->evaluateGrid(model->getImageSize(), 1.0f, expected);
+    loaded_model->evaluateGrid(model->getImageSize(), 1.0f, actual);
+    BOOST_CHECK_EQUAL_MAT(actual, expected, cv::Vec3f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ResolutionIndependentOfModel) {
+  // Camera resolution may differ from the image size of the vignetting model (e.g. model calibrated on binned images)
+  auto model = VignettingModel::load(getTestFilename("polynomial_vignetting_model_identity.vgn"));
+  const cv::Size resolution(model->getImageSize().width * 2, model->getImageSize().height * 2);
+  CalibrationBundle bundle;
+  bundle.setVignettingModel(*model);
+  bundle.setResolution(resolution);
+  auto f = getTemporaryFilename();
+  bundle.save(f);
+  CalibrationBundle loaded(f);
+  BOOST_CHECK_EQUAL(loaded.getResolution(), resolution);
+  auto loaded_model = loaded.getVignettingModel();
+  BOOST_REQUIRE(loaded_model != nullptr);
+  BOOST_CHECK_EQUAL(loaded_model->getImageSize(), model->getImageSize());
+  BOOST_CHECK_EQUAL(loaded_model->getName(), model->getName());
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include "test.h"
+
+#include <radical/compact_nonparametric_vignetting_model.h>
+#include <radical/exceptions.h>
+#include <radical/vignetting_model.h>
+
+using namespace radical;
+
+/** Smooth radial falloff, similar to real vignetting. */
+cv::Mat createDenseResponse(cv::Size size) {
+  cv::Mat m(size, CV_32FC3);
+  const float cx = 0.5f * (size.width - 1), cy = 0.5f * (size.height - 1);
+  const float r2_max = cx * cx + cy * cy;
+  for (int row = 0; row < size.height; ++row)
+    for (int col = 0; col < size.width; ++col) {
+      const float r2 = ((col - cx) * (col - cx) + (row - cy) * (row - cy)) / r2_max;
+      m.at<cv::Vec3f>(row, col) = cv::Vec3f(1.0f - 0.3f * r2, 1.0f - 0.4f * r2, 1.0f - 0.5f * r2);
+    }
+  return m;
+}
+
+BOOST_AUTO_TEST_CASE(MatConstructor) {
+  cv::Mat m;
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel vm(m, {10, 10}), MatException);
+  m.create(3, 3, CV_8UC3);
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel vm(m, {10, 10}), MatTypeException);
+  m.create(1, 3, CV_32FC3);
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel vm(m, {10, 10}), Exception);
+  m.create(3, 3, CV_32FC3);
+  m.setTo(1.0f);
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel vm(m, {1, 10}), Exception);
+  CompactNonparametricVignettingModel vm(m, {10, 10});
+  BOOST_CHECK_EQUAL(vm.getImageSize(), cv::Size(10, 10));
+  BOOST_CHECK_EQUAL(vm.getName(), "compact_nonparametric");
+  BOOST_CHECK_EQUAL_MAT(vm.getModelCoefficients(), m, cv::Vec3f);
+}
+
+BOOST_AUTO_TEST_CASE(ModelEvaluation) {
+  // Grid nodes at 0, 4.5, and 9 pixels
+  cv::Mat m(3, 3, CV_32FC3);
+  for (int row = 0; row < 3; ++row)
+    for (int col = 0; col < 3; ++col)
+      m.at<cv::Vec3f>(row, col) = cv::Vec3f(col, row, col + row);
+  CompactNonparametricVignettingModel vm(m, {10, 10});
+  // At nodes
+  BOOST_CHECK_EQUAL(vm(0, 0), cv::Vec3f(0, 0, 0));
+  BOOST_CHECK_EQUAL(vm(9, 0), cv::Vec3f(2, 0, 2));
+  BOOST_CHECK_EQUAL(vm(4.5, 9), cv::Vec3f(1, 2, 3));
+  // Between nodes the function is linear in each direction
+  auto v = vm(2.25, 6.75);
+  BOOST_CHECK_CLOSE(v[0], 0.5f, 1e-4);
+  BOOST_CHECK_CLOSE(v[1], 1.5f, 1e-4);
+  BOOST_CHECK_CLOSE(v[2], 2.0f, 1e-4);
+  // Clamped outside
+  BOOST_CHECK_EQUAL(vm(-1, 20), cv::Vec3f(0, 2, 2));
+}
+
+BOOST_AUTO_TEST_CASE(FromDense) {
+  const cv::Size size(97, 61);
+  auto dense = createDenseResponse(size);
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel::fromDense(dense, 0), Exception);
+  // Bilinear response is reproduced exactly (up to rounding)
+  {
+    cv::Mat bilinear(size, CV_32FC3);
+    for (int row = 0; row < size.height; ++row)
+      for (int col = 0; col < size.width; ++col)
+        bilinear.at<cv::Vec3f>(row, col) = cv::Vec3f(0.5f + 0.005f * col, 0.5f + 0.008f * row, 0.5f);
+    auto vm = CompactNonparametricVignettingModel::fromDense(bilinear, 8);
+    cv::Mat response;
+    vm->evaluateGrid(size, 1.0f, response);
+    BOOST_CHECK_LT(cv::norm(response, bilinear, cv::NORM_INF), 1e-5);
+  }
+  for (unsigned int stride : {1, 4, 8, 16}) {
+    auto vm = CompactNonparametricVignettingModel::fromDense(dense, stride);
+    BOOST_CHECK_EQUAL(vm->getImageSize(), size);
+    auto coefficients = vm->getModelCoefficients();
+    BOOST_CHECK_LE((size.width - 1.0) / (coefficients.cols - 1), stride);
+    BOOST_CHECK_LE((size.height - 1.0) / (coefficients.rows - 1), stride);
+    BOOST_CHECK_GT((size.width - 1.0) / (coefficients.cols - 2), stride);
+    // Smooth response is reproduced closely
+    cv::Mat response;
+    vm->evaluateGrid(size, 1.0f, response);
+    BOOST_CHECK_LT(cv::norm(response, dense, cv::NORM_INF), 0.02);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EvaluateRowAndGrid) {
+  auto vm = CompactNonparametricVignettingModel::fromDense(createDenseResponse({64, 48}), 8);
+  BOOST_CHECK(vm->supportsRowEvaluation());
+  for (const auto& size : {cv::Size(64, 48), cv::Size(128, 96), cv::Size(16, 12)}) {
+    const float scale = vm->getScale(size);
+    const cv::Rect roi(3, 5, size.width / 2, size.height / 3);
+    cv::Mat response;
+    vm->evaluateGrid(roi, scale, response);
+    BOOST_REQUIRE_EQUAL(response.size(), roi.size());
+    BOOST_REQUIRE_EQUAL(response.type(), CV_32FC3);
+    std::vector<float> row_response(3 * roi.width), row_reciprocal(3 * roi.width);
+    for (int row = 0; row < roi.height; ++row) {
+      vm->evaluateRow(roi.y + row, roi.x, roi.width, scale, row_response.data(), false);
+      vm->evaluateRow(roi.y + row, roi.x, roi.width, scale, row_reciprocal.data(), true);
+      for (int col = 0; col < roi.width; ++col) {
+        const auto expected = (*vm)(scale * (roi.x + col), scale * (roi.y + row));
+        for (int c = 0; c < 3; ++c) {
+          BOOST_CHECK_SMALL(response.at<cv::Vec3f>(row, col)[c] - expected[c], 1e-5f);
+          BOOST_CHECK_SMALL(row_response[3 * col + c] - expected[c], 1e-5f);
+          BOOST_CHECK_SMALL(row_reciprocal[3 * col + c] - 1.0f / expected[c], 1e-5f);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SaveLoad) {
+  auto vm = CompactNonparametricVignettingModel::fromDense(createDenseResponse({97, 61}), 8);
+  auto f = getTemporaryFilename();
+  vm->save(f);
+  CompactNonparametricVignettingModel loaded(f);
+  BOOST_CHECK_EQUAL(loaded.getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(loaded.getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  auto model = VignettingModel::load(f);
+  BOOST_REQUIRE(std::dynamic_pointer_cast<CompactNonparametricVignettingModel>(model) != nullptr);
+  BOOST_CHECK_EQUAL(model->getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(model->getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  BOOST_CHECK_THROW(CompactNonparametricVignettingModel(getTestFilename("nonparametric_vignetting_model_identity.vgn")),
+                    SerializationException);
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "test.h"
+
+#include "forward_table.h"
+#include "kernels.h"
+
+using namespace radical;
+
+// Each instruction set specific implementation is called directly and compared against the scalar one. Only the kernels
+// that are compiled in (see RADICAL_HAVE_* definitions) and supported by the CPU are tested.
+
+namespace {
+
+template <typename T>
+struct Kernels {
+  using InverseMap = void (*)(const T*, float*, size_t, const float*, int);
+  using DirectMap = void (*)(const float*, T*, size_t, const ForwardTable&);
+  const char* name;
+  InverseMap inverse_map;
+  DirectMap direct_map;
+};
+
+template <typename T>
+std::vector<Kernels<T>> getAvailableKernels() {
+  std::vector<Kernels<T>> kernels;
+#ifdef RADICAL_HAVE_SSE4_1
+  if (kernels::isAvailable(kernels::ISA::SSE4_1))
+    kernels.push_back({"SSE4.1", &kernels::sse41::inverseMap, &kernels::sse41::directMap});
+#endif
+#ifdef RADICAL_HAVE_AVX2
+  if (kernels::isAvailable(kernels::ISA::AVX2))
+    kernels.push_back({"AVX2", &kernels::avx2::inverseMap, &kernels::avx2::directMap});
+#endif
+#ifdef RADICAL_HAVE_AVX512
+  if (kernels::isAvailable(kernels::ISA::AVX512))
+    kernels.push_back({"AVX-512", &kernels::avx512::inverseMap, &kernels::avx512::directMap});
+#endif
+  return kernels;
+}
+
+/** Inverse response with a given number of levels (3 rows, channel by channel) that has dense and sparse regions. */
+cv::Mat createResponse(int num_levels) {
+  cv::Mat_<float> response(3, num_levels);
+  const float last = static_cast<float>(num_levels - 1);
+  for (int k = 0; k < num_levels; ++k) {
+    response(0, k) = k;
+    response(1, k) = std::pow(k / last, 3.0f);
+    response(2, k) = std::round(k / 10.0f);
+  }
+  return response;
+}
+
+/** Irradiance values for all channels: random values plus response values, their neighbors, and special values. */
+std::vector<float> createIrradiance(const cv::Mat& response) {
+  auto E = generateRandomVector<float>(3 * 1000, -10.0f, 1.2f * response.cols);
+  for (int k = 0; k < response.cols; ++k)
+    for (int c = 0; c < 3; ++c) {
+      float r = response.at<float>(c, k);
+      E.push_back(r);
+      E.push_back(std::nextafter(r, std::numeric_limits<float>::infinity()));
+      E.push_back(std::nextafter(r, -std::numeric_limits<float>::infinity()));
+    }
+  for (float e : {std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                  std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::lowest(), 0.0f, -0.0f})
+    for (int c = 0; c < 3; ++c)
+      E.push_back(e);
+  return E;
+}
+
+template <typename T>
+void checkDirectMap() {
+  setRNGSeed(1);
+  // Responses with more levels than the output type can represent exercise saturation
+  for (int num_levels : {256, 1024, 65536}) {
+    cv::Mat response = createResponse(num_levels);
+    auto E = createIrradiance(response);
+    for (unsigned int num_bins : {1, 16, 4096}) {
+      ForwardTable table(response, num_bins);
+      // Odd number of pixels so that the scalar tail of vectorized kernels is exercised
+      for (size_t n : {size_t(3), size_t(3 * 37), E.size()}) {
+        std::vector<T> expected(n), actual(n);
+        kernels::scalar::directMap(E.data(), expected.data(), n, table);
+        for (const auto& k : getAvailableKernels<T>()) {
+          std::fill(actual.begin(), actual.end(), 0);
+          k.direct_map(E.data(), actual.data(), n, table);
+          BOOST_CHECK_MESSAGE(actual == expected, k.name << " differs from scalar with " << num_levels << " levels, "
+                                                         << num_bins << " bins, " << n << " elements");
+        }
+      }
+    }
+  }
+}
+
+template <typename T>
+void checkInverseMap() {
+  setRNGSeed(2);
+  // Input with all values of the type (and more) so that clamping to the last table element is exercised
+  std::vector<T> I;
+  for (int v = 0; v <= std::numeric_limits<T>::max(); ++v)
+    I.push_back(static_cast<T>(v));
+  while (I.size() % 3 != 0 || I.size() % 2 == 0)
+    I.push_back(std::numeric_limits<T>::max());
+  for (int num_levels : {1, 100, 256, 65536}) {
+    auto lut = generateRandomVector<float>(3 * num_levels, -1.0f, 1.0f);
+    std::vector<float> expected(I.size()), actual(I.size());
+    kernels::scalar::inverseMap(I.data(), expected.data(), I.size(), lut.data(), num_levels);
+    for (const auto& k : getAvailableKernels<T>()) {
+      std::fill(actual.begin(), actual.end(), 0.0f);
+      k.inverse_map(I.data(), actual.data(), I.size(), lut.data(), num_levels);
+      BOOST_CHECK_MESSAGE(actual == expected, k.name << " differs from scalar with " << num_levels << " levels");
+    }
+  }
+}
+
+}  // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(ScalarAvailable) {
+  BOOST_CHECK(kernels::isAvailable(kernels::ISA::Scalar));
+}
+
+BOOST_AUTO_TEST_CASE(DirectMap8) {
+  checkDirectMap<uint8_t>();
+}
+
+BOOST_AUTO_TEST_CASE(DirectMap16) {
+  checkDirectMap<uint16_t>();
+}
+
+BOOST_AUTO_TEST_CASE(DirectMapSaturates) {
+  // Brightness that does not fit into 8 bits saturates in all implementations
+  cv::Mat response = createResponse(1024);
+  ForwardTable table(response, 4096);
+  std::vector<float> E(3 * 101, 1000.0f);
+  std::vector<uint8_t> I(E.size());
+  kernels::scalar::directMap(E.data(), I.data(), E.size(), table);
+  for (auto i : I)
+    BOOST_REQUIRE_EQUAL(static_cast<int>(i), 255);
+  for (const auto& k : getAvailableKernels<uint8_t>()) {
+    std::fill(I.begin(), I.end(), 0);
+    k.direct_map(E.data(), I.data(), E.size(), table);
+    for (auto i : I)
+      BOOST_REQUIRE_EQUAL(static_cast<int>(i), 255);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InverseMap8) {
+  checkInverseMap<uint8_t>();
+}
+
+BOOST_AUTO_TEST_CASE(InverseMap16) {
+  checkInverseMap<uint16_t>();
+}
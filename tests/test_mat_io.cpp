@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <cstdint>
+#include <fstream>
+
+#include "test.h"
+
+#include <radical/exceptions.h>
+#include <radical/mat_io.h>
+
+#include "mapped_file.h"
+
+using namespace radical;
+
+BOOST_AUTO_TEST_CASE(WriteRead) {
+  setRNGSeed(1);
+  for (int type : {CV_8UC3, CV_16UC1, CV_32FC3, CV_64FC3}) {
+    cv::Mat m(17, 23, type);
+    cv::randu(m, cv::Scalar::all(0), cv::Scalar::all(100));
+    auto f = getTemporaryFilename();
+    writeMat(f, m);
+    BOOST_CHECK_EQUAL(cv::norm(readMat(f), m, cv::NORM_INF), 0);
+    BOOST_CHECK_EQUAL(cv::norm(mapMat(f), m, cv::NORM_INF), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MapWithHeader) {
+  setRNGSeed(2);
+  cv::Mat m(10, 12, CV_64FC3);
+  cv::randu(m, cv::Scalar::all(0), cv::Scalar::all(1));
+  for (const char* h : {"", "H", "SomeModel 1 2 3"}) {
+    const std::string header(h);
+    auto f = getTemporaryFilename();
+    {
+      std::ofstream file(f, std::ios::out | std::ios::binary);
+      writeMat(file, header, m);
+    }
+    std::ifstream file(f, std::ios::in | std::ios::binary);
+    std::string line;
+    std::getline(file, line);
+    BOOST_CHECK_EQUAL(line.substr(0, header.size()), header);
+    auto mapped = mapMat(f, static_cast<size_t>(file.tellg()));
+    BOOST_CHECK_EQUAL(cv::norm(mapped, m, cv::NORM_INF), 0);
+#if CV_MAJOR_VERSION > 2
+    // Data is mapped in place and is aligned
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(mapped.data) % MAT_DATA_ALIGNMENT, 0);
+#endif
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MapLifetime) {
+  cv::Mat m(64, 64, CV_32FC1, cv::Scalar(3));
+  auto f = getTemporaryFilename();
+  writeMat(f, m);
+  cv::Mat copy;
+  {
+    auto mapped = mapMat(f);
+    copy = mapped;
+  }
+  // Mapping is kept alive by the remaining reference
+  BOOST_CHECK_EQUAL(cv::norm(copy, m, cv::NORM_INF), 0);
+  // Modifications are not written back to the file
+  copy.setTo(5);
+  BOOST_CHECK_EQUAL(cv::norm(mapMat(f), m, cv::NORM_INF), 0);
+  copy.release();
+  // Re-creating with a different size allocates new memory
+  auto mapped = mapMat(f);
+  mapped.create(10, 10, CV_8UC1);
+  mapped.setTo(1);
+  BOOST_CHECK_EQUAL(cv::norm(mapMat(f), m, cv::NORM_INF), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReplaceMapped) {
+  // Data mapped from a file is written back to the same file, the mapping should stay valid
+  setRNGSeed(3);
+  cv::Mat m(200, 300, CV_32FC3);
+  cv::randu(m, cv::Scalar::all(0), cv::Scalar::all(1));
+  auto f = getTemporaryFilename();
+  writeMat(f, m);
+  auto mapped = mapMat(f);
+  auto check = [&f, &m](const std::string& header) {
+    std::ifstream file(f, std::ios::in | std::ios::binary);
+    std::string line;
+    std::getline(file, line);
+    BOOST_CHECK_EQUAL(line.substr(0, header.size()), header);
+    BOOST_CHECK_EQUAL(cv::norm(mapMat(f, static_cast<size_t>(file.tellg())), m, cv::NORM_INF), 0);
+  };
+  {
+    ReplacementFile output(f);
+    BOOST_REQUIRE(output.is_open());
+    writeMat(output.stream(), "Replaced", mapped);
+    BOOST_REQUIRE(output.commit());
+  }
+  BOOST_CHECK_EQUAL(cv::norm(mapped, m, cv::NORM_INF), 0);
+  check("Replaced");
+  // Target is not touched unless the replacement is committed
+  {
+    ReplacementFile output(f);
+    BOOST_REQUIRE(output.is_open());
+    output.stream() << "Garbage";
+  }
+  BOOST_CHECK_EQUAL(cv::norm(mapped, m, cv::NORM_INF), 0);
+  check("Replaced");
+}
+
+BOOST_AUTO_TEST_CASE(MapInvalid) {
+  BOOST_CHECK_THROW(mapMat(getTestFilename("file_that_does_not_exist.mat")), SerializationException);
+  BOOST_CHECK_THROW(mapMat(getTestFilename("vignetting_model_empty.vgn")), SerializationException);
+  // Truncated data
+  cv::Mat m(64, 64, CV_32FC1, cv::Scalar(3));
+  auto f = getTemporaryFilename();
+  writeMat(f, m);
+  {
+    std::ifstream in(f, std::ios::in | std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out(f, std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size() / 2);
+  }
+  BOOST_CHECK_THROW(mapMat(f), SerializationException);
+}
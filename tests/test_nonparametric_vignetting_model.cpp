@@ -101,3 +101,26 @@ BOOST_AUTO_TEST_CASE(SaveLoad) {
   NonparametricVignettingModel vm(f);
   BOOST_CHECK_EQUAL_MAT(vm.getModelCoefficients(), m, cv::Vec3f);
 }
+
+BOOST_AUTO_TEST_CASE(EvaluateGrid) {
+  setRNGSeed(1);
+  cv::Mat m(24, 32, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  NonparametricVignettingModel vm(m);
+  // Same size as the model
+  cv::Mat response;
+  vm.evaluateGrid(vm.getImageSize(), vm.getScale(vm.getImageSize()), response);
+  BOOST_CHECK_EQUAL_MAT(response, m, cv::Vec3f);
+  // Larger image size and region of interest
+  for (const auto& size : {cv::Size(64, 48), cv::Size(16, 12)}) {
+    const float scale = vm.getScale(size);
+    const cv::Rect roi(3, 5, size.width / 2, size.height / 3);
+    vm.evaluateGrid(roi, scale, response);
+    BOOST_REQUIRE_EQUAL(response.size(), roi.size());
+    BOOST_REQUIRE_EQUAL(response.type(), CV_32FC3);
+    for (int row = 0; row < roi.height; ++row)
+      for (int col = 0; col < roi.width; ++col)
+        BOOST_CHECK_EQUAL(response.at<cv::Vec3f>(row, col), vm(scale * (roi.x + col), scale * (roi.y + row)));
+  }
+}
+
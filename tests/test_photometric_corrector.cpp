@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include "test.h"
+
+#include <radical/exceptions.h>
+#include <radical/nonparametric_vignetting_model.h>
+#include <radical/photometric_corrector.h>
+#include <radical/polynomial_vignetting_model.h>
+#include <radical/radiometric_response.h>
+#include <radical/vignetting_response.h>
+
+using namespace radical;
+
+/** Reference implementation that goes through the intermediate irradiance and radiance images. */
+cv::Mat correctReference(const RadiometricResponse& rr, const VignettingResponse& vr, const cv::Mat& I, float scale) {
+  cv::Mat E, L, O;
+  rr.inverseMap(I, E);
+  cv::multiply(E, cv::Scalar::all(scale), E);
+  vr.remove(E, L);
+  rr.directMap(L, O);
+  return O;
+}
+
+VignettingResponse::Ptr createRandomVignettingResponse(int width, int height) {
+  cv::Mat m(height, width, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  auto f = getTemporaryFilename();
+  NonparametricVignettingModel(m).save(f);
+  return std::make_shared<VignettingResponse>(f);
+}
+
+BOOST_AUTO_TEST_CASE(Constructor) {
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = std::make_shared<VignettingResponse>(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  BOOST_CHECK_THROW(PhotometricCorrector pc(nullptr, vr), Exception);
+  BOOST_CHECK_THROW(PhotometricCorrector pc(rr, nullptr), Exception);
+  BOOST_CHECK_NO_THROW(PhotometricCorrector pc(rr, vr));
+  PhotometricCorrector pc(rr, vr, 0.5f);
+  BOOST_CHECK_EQUAL(pc.getScale(), 0.5f);
+  pc.setScale(2.0f);
+  BOOST_CHECK_EQUAL(pc.getScale(), 2.0f);
+}
+
+BOOST_AUTO_TEST_CASE(CorrectInvalid) {
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = std::make_shared<VignettingResponse>(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  PhotometricCorrector pc(rr, vr);
+  cv::Mat I, O;
+  pc.correct(I, O);
+  BOOST_CHECK(O.empty());
+  I.create(10, 10, CV_32FC3);
+  BOOST_CHECK_THROW(pc.correct(I, O), MatTypeException);
+  I.create(20, 10, CV_8UC3);
+  BOOST_CHECK_THROW(pc.correct(I, O), Exception);  // invalid aspect ratio
+}
+
+BOOST_AUTO_TEST_CASE(CorrectIdentity) {
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = std::make_shared<VignettingResponse>(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  PhotometricCorrector pc(rr, vr);
+  for (const auto& size : {cv::Size(10, 10), cv::Size(4, 4), cv::Size(53, 53)}) {
+    auto I = generateRandomImage(size);
+    cv::Mat O;
+    pc.correct(I, O);
+    BOOST_CHECK_EQUAL_MAT(O, I, cv::Vec3b);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CorrectMatchesReference) {
+  setRNGSeed(1);
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = createRandomVignettingResponse(64, 48);
+  for (float scale : {0.5f, 1.0f, 1.3f}) {
+    PhotometricCorrector pc(rr, vr, scale);
+    auto I = generateRandomImage(96, 128);
+    cv::Mat O;
+    pc.correct(I, O);
+    auto O_expected = correctReference(*rr, *vr, I, scale);
+    BOOST_REQUIRE_EQUAL(O.type(), CV_8UC3);
+    // Gain is applied as a multiplication by the reciprocal, so values exactly on a bin edge may round differently
+    BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CorrectOnTheFly) {
+  setRNGSeed(5);
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(64, 62, 66);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(48, 50, 47);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-2e-5, -3e-5, -1e-5);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-9, -2e-9, 0);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(0, 1e-14, 0);
+  auto f = getTemporaryFilename();
+  PolynomialVignettingModel<3>(m, cv::Size(128, 96)).save(f);
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = std::make_shared<VignettingResponse>(f);
+  vr->setEvaluation(VignettingResponse::Evaluation::OnTheFly);
+  PhotometricCorrector pc(rr, vr, 1.2f);
+  for (const auto& size : {cv::Size(128, 96), cv::Size(64, 48)}) {
+    auto I = generateRandomImage(size.height, size.width);
+    cv::Mat O;
+    pc.correct(I, O);
+    auto O_expected = correctReference(*rr, *vr, I, 1.2f);
+    BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+  }
+  BOOST_CHECK(vr->getCacheStats().sizes.empty());
+}
+
+BOOST_AUTO_TEST_CASE(CorrectHighBitDepth) {
+  setRNGSeed(2);
+  cv::Mat_<cv::Vec3f> response(4096, 1);
+  for (int k = 0; k < 4096; ++k)
+    response(k) = cv::Vec3f::all(std::pow(k / 4095.0f, 2.2f));
+  auto rr = std::make_shared<RadiometricResponse>(response, 4096);
+  auto vr = createRandomVignettingResponse(64, 48);
+  PhotometricCorrector pc(rr, vr, 1.2f);
+  cv::Mat I(96, 128, CV_16UC3);
+  cv::randu(I, 0, 4096);
+  cv::Mat O;
+  BOOST_CHECK_THROW(pc.correct(generateRandomImage(96, 128), O), MatTypeException);
+  pc.correct(I, O);
+  auto O_expected = correctReference(*rr, *vr, I, 1.2f);
+  BOOST_REQUIRE_EQUAL(O.type(), CV_16UC3);
+  BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(Sample) {
+  setRNGSeed(3);
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_scaling.crf"));
+  auto vr = createRandomVignettingResponse(64, 48);
+  PhotometricCorrector pc(rr, vr, 2.0f);
+  auto I = generateRandomImage(96, 128);
+  cv::Mat E, L;
+  rr->inverseMap(I, E);
+  vr->remove(E, L);
+  std::vector<cv::Point> points = {{0, 0}, {127, 95}, {64, 48}, {3, 90}};
+  std::vector<cv::Vec3f> E_samples(points.size()), L_samples(points.size());
+  pc.sample(I, points.data(), E_samples.data(), nullptr, points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    BOOST_CHECK_EQUAL(E_samples[i], E.at<cv::Vec3f>(points[i]));
+  pc.sample(I, points.data(), E_samples.data(), L_samples.data(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    BOOST_CHECK_EQUAL(E_samples[i], E.at<cv::Vec3f>(points[i]));
+    // Gain is applied as a multiplication by the reciprocal
+    for (int c = 0; c < 3; ++c)
+      BOOST_CHECK_CLOSE(L_samples[i][c], L.at<cv::Vec3f>(points[i])[c], 1e-3);
+  }
+}
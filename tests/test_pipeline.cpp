@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include "test.h"
+
+#include <radical/exceptions.h>
+#include <radical/nonparametric_vignetting_model.h>
+#include <radical/photometric_corrector.h>
+#include <radical/pipeline.h>
+#include <radical/polynomial_vignetting_model.h>
+#include <radical/radiometric_response.h>
+#include <radical/vignetting_response.h>
+
+using namespace radical;
+
+/** Stage that writes image coordinates of each pixel, used to check that tiles cover the image exactly once. */
+class CoordinatesStage : public PipelineStage {
+ public:
+  virtual int getOutputType(int) const override {
+    return CV_32SC2;
+  }
+
+  virtual void process(const cv::Mat& in, cv::Mat& out, const cv::Rect& tile, cv::Size) const override {
+    BOOST_REQUIRE_EQUAL(in.size(), tile.size());
+    for (int row = 0; row < out.rows; ++row)
+      for (int col = 0; col < out.cols; ++col)
+        out.at<cv::Vec2i>(row, col) += cv::Vec2i(tile.x + col, tile.y + row);
+  }
+};
+
+Pipeline createCorrectionPipeline(RadiometricResponse::Ptr rr, VignettingResponse::Ptr vr, float scale,
+                                  size_t tile_bytes = Pipeline::DEFAULT_TILE_BYTES) {
+  Pipeline pipeline(tile_bytes);
+  pipeline.addStage(std::make_shared<InverseMapStage>(rr))
+      .addStage(std::make_shared<ScaleStage>(scale))
+      .addStage(std::make_shared<RemoveVignettingStage>(vr))
+      .addStage(std::make_shared<DirectMapStage>(rr));
+  return pipeline;
+}
+
+VignettingResponse::Ptr createRandomVignettingResponse(int width, int height) {
+  cv::Mat m(height, width, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  auto f = getTemporaryFilename();
+  NonparametricVignettingModel(m).save(f);
+  return std::make_shared<VignettingResponse>(f);
+}
+
+BOOST_AUTO_TEST_CASE(Invalid) {
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  Pipeline pipeline;
+  BOOST_CHECK_THROW(pipeline.addStage(nullptr), Exception);
+  BOOST_CHECK_THROW(InverseMapStage stage(nullptr), Exception);
+  BOOST_CHECK_THROW(RemoveVignettingStage stage(nullptr), Exception);
+  cv::Mat I = generateRandomImage(10, 10), O;
+  BOOST_CHECK_THROW(pipeline.run(I, O), Exception);
+  pipeline.run(cv::Mat(), O);
+  BOOST_CHECK(O.empty());
+  // Stages do not fit together
+  pipeline.addStage(std::make_shared<DirectMapStage>(rr));
+  BOOST_CHECK_THROW(pipeline.run(I, O), MatTypeException);
+  BOOST_CHECK_THROW(pipeline.getOutputType(CV_8UC3), MatTypeException);
+  BOOST_CHECK_EQUAL(pipeline.getOutputType(CV_32FC3), CV_8UC3);
+}
+
+BOOST_AUTO_TEST_CASE(TileSize) {
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  Pipeline pipeline(16 * 1000);
+  pipeline.addStage(std::make_shared<InverseMapStage>(rr)).addStage(std::make_shared<DirectMapStage>(rr));
+  BOOST_CHECK_EQUAL(pipeline.getTileBytes(), 16 * 1000);
+  // Largest stage working set is 3 + 12 bytes per pixel
+  BOOST_CHECK_EQUAL(pipeline.getTileSize({100, 100}, CV_8UC3), cv::Size(100, 10));
+  BOOST_CHECK_EQUAL(pipeline.getTileSize({100, 5}, CV_8UC3), cv::Size(100, 5));
+  BOOST_CHECK_EQUAL(pipeline.getTileSize({5000, 100}, CV_8UC3), cv::Size(1066, 1));
+  pipeline.setTileBytes(0);
+  BOOST_CHECK_EQUAL(pipeline.getTileSize({100, 100}, CV_8UC3), cv::Size(1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(TilesCoverImage) {
+  Pipeline pipeline;
+  pipeline.addStage(std::make_shared<CoordinatesStage>());
+  for (size_t tile_bytes : {8, 100, 1000, 100000}) {
+    pipeline.setTileBytes(tile_bytes);
+    cv::Mat I(37, 53, CV_8UC1), O(37, 53, CV_32SC2, cv::Scalar::all(0));
+    pipeline.run(I, O);
+    for (int row = 0; row < O.rows; ++row)
+      for (int col = 0; col < O.cols; ++col)
+        BOOST_REQUIRE(O.at<cv::Vec2i>(row, col) == cv::Vec2i(col, row));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MatchesPhotometricCorrector) {
+  setRNGSeed(1);
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = createRandomVignettingResponse(64, 48);
+  PhotometricCorrector pc(rr, vr, 1.3f);
+  auto I = generateRandomImage(96, 128);
+  cv::Mat O_expected;
+  pc.correct(I, O_expected);
+  for (size_t tile_bytes : {size_t(100), size_t(4096), Pipeline::DEFAULT_TILE_BYTES}) {
+    auto pipeline = createCorrectionPipeline(rr, vr, 1.3f, tile_bytes);
+    cv::Mat O;
+    pipeline.run(I, O);
+    BOOST_REQUIRE_EQUAL(O.type(), CV_8UC3);
+    // Scale is folded into the lookup table by the corrector, so values on a bin edge may round differently
+    BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(OnTheFly) {
+  setRNGSeed(5);
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(64, 62, 66);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(48, 50, 47);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-2e-5, -3e-5, -1e-5);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-9, -2e-9, 0);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(0, 1e-14, 0);
+  auto f = getTemporaryFilename();
+  PolynomialVignettingModel<3>(m, cv::Size(128, 96)).save(f);
+  auto rr = std::make_shared<RadiometricResponse>(getTestFilename("radiometric_response_identity.crf"));
+  auto vr = std::make_shared<VignettingResponse>(f);
+  vr->setEvaluation(VignettingResponse::Evaluation::OnTheFly);
+  PhotometricCorrector pc(rr, vr);
+  auto pipeline = createCorrectionPipeline(rr, vr, 1.0f, 1000);
+  for (const auto& size : {cv::Size(128, 96), cv::Size(64, 48)}) {
+    auto I = generateRandomImage(size);
+    cv::Mat O, O_expected;
+    pipeline.run(I, O);
+    pc.correct(I, O_expected);
+    BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+  }
+  BOOST_CHECK(vr->getCacheStats().sizes.empty());
+}
+
+BOOST_AUTO_TEST_CASE(HighBitDepth) {
+  setRNGSeed(2);
+  cv::Mat_<cv::Vec3f> response(4096, 1);
+  for (int k = 0; k < 4096; ++k)
+    response(k) = cv::Vec3f::all(std::pow(k / 4095.0f, 2.2f));
+  auto rr = std::make_shared<RadiometricResponse>(response, 4096);
+  auto vr = createRandomVignettingResponse(64, 48);
+  auto pipeline = createCorrectionPipeline(rr, vr, 1.0f, 2000);
+  cv::Mat I(96, 128, CV_16UC3);
+  cv::randu(I, 0, 4096);
+  cv::Mat O, O_expected;
+  BOOST_CHECK_THROW(pipeline.run(generateRandomImage(96, 128), O), MatTypeException);
+  pipeline.run(I, O);
+  PhotometricCorrector(rr, vr).correct(I, O_expected);
+  BOOST_REQUIRE_EQUAL(O.type(), CV_16UC3);
+  BOOST_CHECK_LE(cv::norm(O, O_expected, cv::NORM_INF), 1.0);
+}
@@ -24,6 +24,7 @@
 
 #include <radical/exceptions.h>
 #include <radical/polynomial_vignetting_model.h>
+#include <radical/vignetting_model.h>
 
 using namespace radical;
 
@@ -96,3 +97,120 @@ BOOST_AUTO_TEST_CASE(SaveLoad) {
   BOOST_CHECK_EQUAL_MAT(vm.getModelCoefficients(), m, cv::Vec3d);
   BOOST_CHECK_EQUAL(vm.getImageSize(), cv::Size(640, 480));
 }
+
+BOOST_AUTO_TEST_CASE(EvaluateRow) {
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(320, 310, 330);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(240, 250, 235);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-1e-6, -1.2e-6, -0.8e-6);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-12, -0.5e-12, -2e-12);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(1e-19, 2e-19, 0);
+  PolynomialVignettingModel<3> vm(m, cv::Size(640, 480));
+  BOOST_CHECK(vm.supportsRowEvaluation());
+  // Full resolution and downscaled by two
+  for (float scale : {1.0f, 2.0f}) {
+    const int width = static_cast<int>(640 / scale);
+    std::vector<float> response(width * 3), reciprocal(width * 3);
+    for (int row : {0, 17, static_cast<int>(479 / scale)}) {
+      vm.evaluateRow(row, 0, width, scale, response.data(), false);
+      vm.evaluateRow(row, 0, width, scale, reciprocal.data(), true);
+      for (int x = 0; x < width; ++x) {
+        auto expected = vm(scale * x, scale * row);
+        for (int c = 0; c < 3; ++c) {
+          BOOST_CHECK_CLOSE(response[x * 3 + c], expected[c], 1e-4);
+          BOOST_CHECK_CLOSE(reciprocal[x * 3 + c], 1.0f / expected[c], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EvaluateGrid) {
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(32, 31, 33);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(24, 25, 23);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-1e-4, -1.2e-4, -0.8e-4);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-8, -0.5e-8, -2e-8);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(1e-12, 2e-12, 0);
+  PolynomialVignettingModel<3> vm(m, cv::Size(64, 48));
+  for (const auto& size : {cv::Size(64, 48), cv::Size(128, 96)}) {
+    const float scale = vm.getScale(size);
+    cv::Mat response;
+    vm.evaluateGrid(size, scale, response);
+    BOOST_REQUIRE_EQUAL(response.size(), size);
+    BOOST_REQUIRE_EQUAL(response.type(), CV_32FC3);
+    for (int row = 0; row < size.height; ++row)
+      for (int col = 0; col < size.width; ++col)
+        for (int c = 0; c < 3; ++c)
+          BOOST_CHECK_CLOSE(response.at<cv::Vec3f>(row, col)[c], vm(scale * col, scale * row)[c], 1e-4);
+    // Region of interest matches the corresponding part of the full grid
+    const cv::Rect roi(7, 3, size.width / 2, size.height / 4);
+    cv::Mat response_roi;
+    vm.evaluateGrid(roi, scale, response_roi);
+    BOOST_CHECK_EQUAL_MAT(response_roi, response(roi), cv::Vec3f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EvaluateGridFullResolution) {
+  // Degree 6 model of a 4K camera, the terms contribute 3 to 30 percent at the corners. The highest order betas are
+  // below the smallest normal float.
+  const cv::Size size(3840, 2160);
+  const double r_sqr = 1920.0 * 1920.0 + 1080.0 * 1080.0;
+  cv::Mat m(1, 8, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(1920, 1915, 1925);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(1080, 1085, 1075);
+  for (int j = 0; j < 6; ++j)
+    m.at<cv::Vec3d>(j + 2) = cv::Vec3d(-0.3, -0.2, -0.25) * ((j % 2 ? -0.1 : 1.0) / std::pow(r_sqr, j + 1));
+  PolynomialVignettingModel<6> vm(m, size);
+  cv::Mat response;
+  vm.evaluateGrid(size, 1.0f, response);
+  BOOST_REQUIRE_EQUAL(response.size(), size);
+  for (int row = 0; row < size.height; row += 37)
+    for (int col = 0; col < size.width; col += 41)
+      for (int c = 0; c < 3; ++c)
+        BOOST_CHECK_CLOSE(response.at<cv::Vec3f>(row, col)[c], vm(col, row)[c], 1e-4);
+  // Corners are where the high order terms matter most
+  for (const auto& p : {cv::Point(0, 0), cv::Point(size.width - 1, size.height - 1)})
+    for (int c = 0; c < 3; ++c)
+      BOOST_CHECK_CLOSE(response.at<cv::Vec3f>(p)[c], vm(p.x, p.y)[c], 1e-4);
+}
+
+template <unsigned int Degree>
+void checkDegree() {
+  cv::Mat m(1, Degree + 2, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(32, 31, 33);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(24, 25, 23);
+  for (unsigned int j = 0; j < Degree; ++j)
+    m.at<cv::Vec3d>(j + 2) = cv::Vec3d(-1e-4, 2e-4, -3e-4) * std::pow(1e-3, j);
+  auto f = getTemporaryFilename();
+  PolynomialVignettingModel<Degree>(m, cv::Size(64, 48)).save(f);
+  // Degree is dispatched from the file header
+  auto vm = VignettingModel::load(f);
+  BOOST_REQUIRE(vm != nullptr);
+  BOOST_REQUIRE(std::dynamic_pointer_cast<PolynomialVignettingModel<Degree>>(vm) != nullptr);
+  BOOST_CHECK_EQUAL(vm->getName(), "polynomial " + std::to_string(Degree));
+  BOOST_CHECK_EQUAL_MAT(vm->getModelCoefficients(), m, cv::Vec3d);
+  // Compare with direct evaluation of the polynomial
+  for (const auto& p : {cv::Vec2f(0, 0), cv::Vec2f(63, 47), cv::Vec2f(10, 40)}) {
+    auto v = (*vm)(p);
+    for (int c = 0; c < 3; ++c) {
+      double dx = m.at<cv::Vec3d>(0)[c] - p[0];
+      double dy = m.at<cv::Vec3d>(1)[c] - p[1];
+      double r = dx * dx + dy * dy;
+      double expected = 1.0;
+      for (unsigned int j = 0; j < Degree; ++j)
+        expected += m.at<cv::Vec3d>(j + 2)[c] * std::pow(r, j + 1);
+      BOOST_CHECK_CLOSE(v[c], expected, 1e-3);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Degrees) {
+  checkDegree<1>();
+  checkDegree<2>();
+  checkDegree<3>();
+  checkDegree<4>();
+  checkDegree<5>();
+  checkDegree<6>();
+}
+
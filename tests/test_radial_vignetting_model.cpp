@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <vector>
+
+#include "test.h"
+
+#include <radical/exceptions.h>
+#include <radical/radial_vignetting_model.h>
+#include <radical/vignetting_model.h>
+
+using namespace radical;
+
+/** Radially symmetric response with a given center that falls off with the squared radius. */
+cv::Mat createDenseResponse(cv::Size size, const cv::Point2f& center) {
+  cv::Mat m(size, CV_32FC3);
+  for (int row = 0; row < size.height; ++row)
+    for (int col = 0; col < size.width; ++col) {
+      const float r2 = ((col - center.x) * (col - center.x) + (row - center.y) * (row - center.y)) / 10000.0f;
+      m.at<cv::Vec3f>(row, col) = cv::Vec3f(1.0f - 0.3f * r2, 1.0f - 0.4f * r2 + 0.05f * r2 * r2, 1.0f - 0.5f * r2);
+    }
+  return m;
+}
+
+BOOST_AUTO_TEST_CASE(MatConstructor) {
+  cv::Mat m;
+  BOOST_CHECK_THROW(RadialVignettingModel vm(m, {9, 7}), MatException);
+  m.create(1, 4, CV_64FC3);
+  BOOST_CHECK_THROW(RadialVignettingModel vm(m, {9, 7}), MatTypeException);
+  m.create(1, 3, CV_32FC3);
+  BOOST_CHECK_THROW(RadialVignettingModel vm(m, {9, 7}), Exception);
+  m.create(2, 4, CV_32FC3);
+  BOOST_CHECK_THROW(RadialVignettingModel vm(m, {9, 7}), Exception);
+  m.create(1, 4, CV_32FC3);
+  m.setTo(1.0f);
+  RadialVignettingModel vm(m, {9, 7});
+  BOOST_CHECK_EQUAL(vm.getName(), "radial");
+  BOOST_CHECK_EQUAL(vm.getImageSize(), cv::Size(9, 7));
+  BOOST_CHECK_EQUAL_MAT(vm.getModelCoefficients(), m, cv::Vec3f);
+}
+
+BOOST_AUTO_TEST_CASE(ModelEvaluation) {
+  // Center at (4, 3), farthest corner at squared distance 25, profile falls linearly from 1 to 0.5
+  cv::Mat m(1, 4, CV_32FC3);
+  m.at<cv::Vec3f>(0) = cv::Vec3f(4, 4, 4);
+  m.at<cv::Vec3f>(1) = cv::Vec3f(3, 3, 3);
+  m.at<cv::Vec3f>(2) = cv::Vec3f(1, 1, 1);
+  m.at<cv::Vec3f>(3) = cv::Vec3f(0.5, 0.6, 0.7);
+  RadialVignettingModel vm(m, {9, 7});
+  BOOST_CHECK_EQUAL(vm(4, 3), cv::Vec3f(1, 1, 1));
+  auto corner = vm(0, 0);
+  BOOST_CHECK_CLOSE(corner[0], 0.5f, 1e-4);
+  BOOST_CHECK_CLOSE(corner[1], 0.6f, 1e-4);
+  BOOST_CHECK_CLOSE(corner[2], 0.7f, 1e-4);
+  auto v = vm(7, 3);
+  BOOST_CHECK_CLOSE(v[0], 1.0f - 0.5f * 9 / 25, 1e-4);
+  // Clamped beyond the farthest corner
+  BOOST_CHECK_EQUAL(vm(100, 100), vm(0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(FromDense) {
+  const cv::Size size(128, 96);
+  const cv::Point2f center(55.3f, 38.7f);
+  auto dense = createDenseResponse(size, center);
+  BOOST_CHECK_THROW(RadialVignettingModel::fromDense(dense, 1), Exception);
+  auto vm = RadialVignettingModel::fromDense(dense, 64);
+  auto coefficients = vm->getModelCoefficients();
+  BOOST_CHECK_EQUAL(coefficients.cols, 66);
+  for (int c = 0; c < 3; ++c) {
+    BOOST_CHECK_SMALL(coefficients.at<cv::Vec3f>(0)[c] - center.x, 0.5f);
+    BOOST_CHECK_SMALL(coefficients.at<cv::Vec3f>(1)[c] - center.y, 0.5f);
+  }
+  cv::Mat response;
+  vm->evaluateGrid(size, 1.0f, response);
+  BOOST_CHECK_LT(cv::norm(response, dense, cv::NORM_INF), 2e-3);
+}
+
+BOOST_AUTO_TEST_CASE(EvaluateRow) {
+  auto vm = RadialVignettingModel::fromDense(createDenseResponse({64, 48}, {30.0f, 20.0f}), 32);
+  BOOST_CHECK(vm->supportsRowEvaluation());
+  for (const auto& size : {cv::Size(64, 48), cv::Size(128, 96), cv::Size(16, 12)}) {
+    const float scale = vm->getScale(size);
+    std::vector<float> response(3 * size.width), reciprocal(3 * size.width);
+    for (int row = 0; row < size.height; ++row) {
+      vm->evaluateRow(row, 0, size.width, scale, response.data(), false);
+      vm->evaluateRow(row, 0, size.width, scale, reciprocal.data(), true);
+      for (int col = 0; col < size.width; ++col) {
+        const auto expected = (*vm)(scale * col, scale * row);
+        for (int c = 0; c < 3; ++c) {
+          BOOST_CHECK_SMALL(response[3 * col + c] - expected[c], 1e-5f);
+          BOOST_CHECK_SMALL(reciprocal[3 * col + c] - 1.0f / expected[c], 1e-5f);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SaveLoad) {
+  auto vm = RadialVignettingModel::fromDense(createDenseResponse({64, 48}, {30.0f, 20.0f}), 32);
+  auto f = getTemporaryFilename();
+  vm->save(f);
+  RadialVignettingModel loaded(f);
+  BOOST_CHECK_EQUAL(loaded.getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(loaded.getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  auto model = VignettingModel::load(f);
+  BOOST_REQUIRE(std::dynamic_pointer_cast<RadialVignettingModel>(model) != nullptr);
+  BOOST_CHECK_EQUAL(model->getImageSize(), vm->getImageSize());
+  BOOST_CHECK_EQUAL_MAT(model->getModelCoefficients(), vm->getModelCoefficients(), cv::Vec3f);
+  BOOST_CHECK_THROW(RadialVignettingModel(getTestFilename("nonparametric_vignetting_model_identity.vgn")),
+                    SerializationException);
+}
@@ -20,6 +20,7 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <cmath>
 
 #include "test.h"
@@ -172,3 +173,172 @@ BOOST_AUTO_TEST_CASE(SaveLoad) {
   RadiometricResponse rr(f);
   BOOST_CHECK_EQUAL_MAT(rr.getInverseResponse(), response, cv::Vec3f);
 }
+
+BOOST_AUTO_TEST_CASE(ForwardTableSize) {
+  cv::Mat response(256, 1, CV_32FC3);
+  response.setTo(1.0f);
+  BOOST_CHECK_THROW(RadiometricResponse rr(response, 0), Exception);
+  BOOST_CHECK_THROW(RadiometricResponse rr(response, 65537), Exception);
+  BOOST_CHECK_NO_THROW(RadiometricResponse rr(response, 1));
+  BOOST_CHECK_NO_THROW(RadiometricResponse rr(response, 65536));
+}
+
+BOOST_AUTO_TEST_CASE(DirectMapForwardTable) {
+  // Direct mapping through forward table should give exactly the same result as binary search in the inverse response,
+  // regardless of the table size. Test with a response that has both dense and sparse regions.
+  setRNGSeed(1);
+  cv::Mat_<cv::Vec3f> response(256, 1);
+  for (int k = 0; k < 256; ++k)
+    response(k) = cv::Vec3f(k, std::pow(k / 255.0f, 3.0f), std::round(k / 10.0f));
+  std::vector<cv::Mat> channels;
+  cv::split(response, channels);
+  auto E = generateRandomVector<float>(10000, -10.0f, 300.0f);
+  for (int k = 0; k < 256; ++k) {
+    E.push_back(k);
+    E.push_back(std::nextafter(static_cast<float>(k), 1000.0f));
+    E.push_back(std::nextafter(static_cast<float>(k), -1000.0f));
+    E.push_back(response(k)[1]);
+    E.push_back(std::nextafter(response(k)[1], 1000.0f));
+  }
+  E.push_back(std::numeric_limits<float>::infinity());
+  E.push_back(-std::numeric_limits<float>::infinity());
+  for (unsigned int size : {1, 16, 4096, 65536}) {
+    RadiometricResponse rr(response, size);
+    for (const auto& e : E) {
+      cv::Vec3f v(e, e / 255.0f, e / 10.0f);
+      auto I = rr.directMap(v);
+      for (int c = 0; c < 3; ++c) {
+        auto begin = channels[c].ptr<float>();
+        auto expected = std::distance(begin, std::lower_bound(begin, begin + 255, v[c]));
+        BOOST_REQUIRE_EQUAL(static_cast<int>(I[c]), expected);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MapImageMatchesPixel) {
+  // Image mapping goes through vectorized kernels, which process elements in blocks with a scalar tail. Check that the
+  // result is identical to the per-pixel mapping for a range of (odd) image widths and views with padded rows.
+  setRNGSeed(2);
+  cv::Mat_<cv::Vec3f> response(256, 1);
+  for (int k = 0; k < 256; ++k)
+    response(k) = cv::Vec3f(k, std::pow(k / 255.0f, 3.0f), std::round(k / 10.0f));
+  RadiometricResponse rr(response);
+  for (int cols : {1, 3, 7, 15, 17, 33, 101}) {
+    cv::Mat I(5, cols + 2, CV_8UC3);
+    cv::randu(I, 0, 256);
+    cv::Mat E(5, cols + 2, CV_32FC3);
+    cv::randu(E, -10.0f, 300.0f);
+    // Take views that are not continuous
+    I = I.colRange(1, cols + 1);
+    E = E.colRange(1, cols + 1);
+    cv::Mat Ei, Eil, Id;
+    rr.inverseMap(I, Ei);
+    rr.inverseLogMap(I, Eil);
+    rr.directMap(E, Id);
+    for (int r = 0; r < I.rows; ++r)
+      for (int c = 0; c < cols; ++c) {
+        BOOST_REQUIRE(Ei.at<cv::Vec3f>(r, c) == rr.inverseMap(I.at<cv::Vec3b>(r, c)));
+        BOOST_REQUIRE(Eil.at<cv::Vec3f>(r, c) == rr.inverseLogMap(I.at<cv::Vec3b>(r, c)));
+        BOOST_REQUIRE(Id.at<cv::Vec3b>(r, c) == rr.directMap(E.at<cv::Vec3f>(r, c)));
+      }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(BitDepth) {
+  for (int bits = 8; bits <= 16; ++bits) {
+    cv::Mat response(1 << bits, 1, CV_32FC3);
+    response.setTo(1.0f);
+    RadiometricResponse rr(response);
+    BOOST_CHECK_EQUAL(rr.getBitDepth(), bits);
+  }
+  // Number of elements should be a power of two between 256 and 65536
+  for (int size : {128, 300, 4095, 131072}) {
+    cv::Mat response(size, 1, CV_32FC3);
+    response.setTo(1.0f);
+    BOOST_CHECK_THROW(RadiometricResponse rr(response), MatSizeException);
+  }
+  // Exception should report the closest accepted size
+  try {
+    RadiometricResponse rr(cv::Mat(300, 1, CV_32FC3, cv::Scalar::all(1.0f)));
+    BOOST_FAIL("MatSizeException expected");
+  } catch (const MatSizeException& e) {
+    BOOST_CHECK_EQUAL(e.expected_size.area(), 512);
+    BOOST_CHECK_EQUAL(e.actual_size.area(), 300);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MapHighBitDepth) {
+  setRNGSeed(3);
+  const int levels = 4096;
+  cv::Mat_<cv::Vec3f> response(levels, 1);
+  for (int k = 0; k < levels; ++k)
+    response(k) = cv::Vec3f(k, std::pow(k / (levels - 1.0f), 2.2f), std::round(k / 10.0f));
+  std::vector<cv::Mat> channels;
+  cv::split(response, channels);
+  RadiometricResponse rr(response, levels);
+  BOOST_CHECK_EQUAL(rr.getBitDepth(), 12);
+
+  // Pixel versions, brightness values beyond the range are clamped
+  BOOST_CHECK_EQUAL(rr.inverseMap(cv::Vec3w(0, 100, 4095)), cv::Vec3f(0, response(100)[1], response(4095)[2]));
+  BOOST_CHECK_EQUAL(rr.inverseMap(cv::Vec3w(5000, 5000, 65535)), response(4095));
+  BOOST_CHECK_EQUAL(rr.directMap16(cv::Vec3f(1000, 1, 1000)), cv::Vec3w(1000, 4095, 4095));
+  BOOST_CHECK_EQUAL(rr.directMap(cv::Vec3f(1000, 0, 10)), cv::Vec3b(255, 0, 95));
+
+  // Image versions should match pixel versions
+  cv::Mat I(7, 33, CV_16UC3);
+  cv::randu(I, 0, levels + 100);
+  cv::Mat E(7, 33, CV_32FC3);
+  cv::randu(E, -10.0f, 5000.0f);
+  cv::Mat E_inverse, E_inverse_log, I_direct;
+  rr.inverseMap(I, E_inverse);
+  rr.inverseLogMap(I, E_inverse_log);
+  rr.directMap(E, I_direct);
+  BOOST_REQUIRE_EQUAL(E_inverse.type(), CV_32FC3);
+  BOOST_REQUIRE_EQUAL(I_direct.type(), CV_16UC3);
+  for (int r = 0; r < I.rows; ++r)
+    for (int c = 0; c < I.cols; ++c) {
+      BOOST_REQUIRE(E_inverse.at<cv::Vec3f>(r, c) == rr.inverseMap(I.at<cv::Vec3w>(r, c)));
+      BOOST_REQUIRE(E_inverse_log.at<cv::Vec3f>(r, c) == rr.inverseLogMap(I.at<cv::Vec3w>(r, c)));
+      auto I_pixel = rr.directMap16(E.at<cv::Vec3f>(r, c));
+      BOOST_REQUIRE(I_direct.at<cv::Vec3w>(r, c) == I_pixel);
+      // Direct mapping should be consistent with binary search in the inverse response
+      for (int k = 0; k < 3; ++k) {
+        auto begin = channels[k].ptr<float>();
+        auto expected = std::distance(begin, std::lower_bound(begin, begin + levels - 1, E.at<cv::Vec3f>(r, c)[k]));
+        BOOST_REQUIRE_EQUAL(static_cast<int>(I_pixel[k]), expected);
+      }
+    }
+
+  // 8-bit images are not accepted
+  cv::Mat I8(10, 10, CV_8UC3);
+  BOOST_CHECK_THROW(rr.inverseMap(I8, E_inverse), MatTypeException);
+}
+
+BOOST_AUTO_TEST_CASE(InverseMapBatch) {
+  setRNGSeed(4);
+  cv::Mat_<cv::Vec3f> response(256, 1);
+  for (int k = 0; k < 256; ++k)
+    response(k) = cv::Vec3f(k + 1, std::pow(k / 255.0f, 2.2f), k * 2);
+  RadiometricResponse rr(response);
+  // Arrays of pixel brightness (odd number of pixels to exercise the tail of vectorized kernels)
+  auto I = generateRandomImage(1, 37);
+  std::vector<cv::Vec3f> E(37), E_log(37);
+  rr.inverseMap(I[0], E.data(), E.size());
+  rr.inverseLogMap(I[0], E_log.data(), E_log.size());
+  for (int i = 0; i < 37; ++i) {
+    BOOST_CHECK_EQUAL(E[i], rr.inverseMap(I(0, i)));
+    BOOST_CHECK_EQUAL(E_log[i], rr.inverseLogMap(I(0, i)));
+  }
+  // Pixels at given locations of an image
+  auto image = generateRandomImage(20, 30);
+  std::vector<cv::Point> points = {{0, 0}, {29, 19}, {5, 7}, {5, 8}, {0, 19}};
+  rr.inverseMap(image, points.data(), E.data(), points.size());
+  rr.inverseLogMap(image, points.data(), E_log.data(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    BOOST_CHECK_EQUAL(E[i], rr.inverseMap(image.at<cv::Vec3b>(points[i])));
+    BOOST_CHECK_EQUAL(E_log[i], rr.inverseLogMap(image.at<cv::Vec3b>(points[i])));
+  }
+  cv::Mat image16(20, 30, CV_16UC3);
+  BOOST_CHECK_THROW(rr.inverseMap(image16, points.data(), E.data(), points.size()), MatTypeException);
+}
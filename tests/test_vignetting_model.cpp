@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (c) 2016-2017 Sergey Alexandrov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <fstream>
+#include <sstream>
+
+#include "test.h"
+
+#include <radical/exceptions.h>
+#include <radical/nonparametric_vignetting_model.h>
+#include <radical/polynomial_vignetting_model.h>
+#include <radical/vignetting_model.h>
+
+using namespace radical;
+
+BOOST_AUTO_TEST_CASE(Load) {
+  auto nonparametric = VignettingModel::load(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  BOOST_CHECK(std::dynamic_pointer_cast<NonparametricVignettingModel>(nonparametric) != nullptr);
+  auto polynomial = VignettingModel::load(getTestFilename("polynomial_vignetting_model_identity.vgn"));
+  BOOST_CHECK(std::dynamic_pointer_cast<PolynomialVignettingModel<3>>(polynomial) != nullptr);
+  // Invalid files
+  BOOST_CHECK(VignettingModel::load(getTestFilename("file_that_does_not_exist.vgn")) == nullptr);
+  BOOST_CHECK(VignettingModel::load(getTestFilename("vignetting_model_empty.vgn")) == nullptr);
+  BOOST_CHECK(VignettingModel::load(getTestFilename("radiometric_response_identity.crf")) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(LoadMalformed) {
+  // Known header token, but unsupported degree
+  auto f = getTemporaryFilename();
+  {
+    std::ofstream file(f);
+    file << "PolynomialVignettingModel 9 640 480\n";
+  }
+  BOOST_CHECK(VignettingModel::load(f) == nullptr);
+  // Known header token, but no data
+  {
+    std::ofstream file(f);
+    file << "NonparametricVignettingModel\n";
+  }
+  BOOST_CHECK(VignettingModel::load(f) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(RegisterReader) {
+  auto f = getTemporaryFilename();
+  {
+    std::ofstream file(f);
+    file << "ConstantVignettingModel 4 3 0.5\n";
+  }
+  BOOST_CHECK(VignettingModel::load(f) == nullptr);
+  VignettingModel::registerReader("ConstantVignettingModel",
+                                  [](const std::string&, std::ifstream&, const std::string& header) {
+                                    std::string name;
+                                    int width, height;
+                                    float value;
+                                    std::stringstream(header) >> name >> width >> height >> value;
+                                    cv::Mat coefficients(height, width, CV_32FC3, cv::Scalar::all(value));
+                                    return std::make_shared<NonparametricVignettingModel>(coefficients);
+                                  });
+  auto model = VignettingModel::load(f);
+  BOOST_REQUIRE(model != nullptr);
+  BOOST_CHECK_EQUAL(model->getImageSize(), cv::Size(4, 3));
+  BOOST_CHECK_EQUAL((*model)(1, 2), cv::Vec3f(0.5, 0.5, 0.5));
+}
+
+BOOST_AUTO_TEST_CASE(Create) {
+  // Models are re-created from their name, coefficients, and image size
+  auto polynomial = VignettingModel::load(getTestFilename("polynomial_vignetting_model_identity.vgn"));
+  auto nonparametric = VignettingModel::load(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  for (const auto& model : {polynomial, nonparametric}) {
+    auto created = VignettingModel::create(model->getName(), model->getModelCoefficients(), model->getImageSize());
+    BOOST_REQUIRE(created != nullptr);
+    BOOST_CHECK_EQUAL(created->getName(), model->getName());
+    BOOST_CHECK_EQUAL(created->getImageSize(), model->getImageSize());
+    BOOST_CHECK_EQUAL(cv::norm(created->getModelCoefficients(), model->getModelCoefficients(), cv::NORM_INF), 0);
+  }
+  BOOST_CHECK_THROW(VignettingModel::create("polynomial 9", polynomial->getModelCoefficients(), {640, 480}),
+                    Exception);
+  BOOST_CHECK(VignettingModel::create("constant", cv::Mat(), {4, 3}) == nullptr);
+  VignettingModel::registerFactory("constant", [](const std::string&, cv::InputArray coefficients, cv::Size size) {
+    cv::Scalar value = cv::Scalar::all(coefficients.getMat().at<float>(0));
+    return std::make_shared<NonparametricVignettingModel>(cv::Mat(size, CV_32FC3, value));
+  });
+  auto model = VignettingModel::create("constant", cv::Mat(1, 1, CV_32FC1, cv::Scalar(0.5)), {4, 3});
+  BOOST_REQUIRE(model != nullptr);
+  BOOST_CHECK_EQUAL(model->getImageSize(), cv::Size(4, 3));
+  BOOST_CHECK_EQUAL((*model)(1, 2), cv::Vec3f(0.5, 0.5, 0.5));
+}
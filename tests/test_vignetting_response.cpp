@@ -20,9 +20,16 @@
  * SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "test.h"
 
 #include <radical/exceptions.h>
+#include <radical/nonparametric_vignetting_model.h>
+#include <radical/polynomial_vignetting_model.h>
 #include <radical/vignetting_response.h>
 
 using namespace radical;
@@ -138,3 +145,294 @@ BOOST_AUTO_TEST_CASE(AddIdentity) {
   vm.addLog(L, E);
   BOOST_CHECK_EQUAL_MAT(E, L, cv::Vec3f);
 }
+
+BOOST_AUTO_TEST_CASE(RemovePoints) {
+  setRNGSeed(1);
+  cv::Mat m(30, 40, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  auto f = getTemporaryFilename();
+  NonparametricVignettingModel(m).save(f);
+  VignettingResponse vr(f);
+  cv::Mat E(60, 80, CV_32FC3);
+  cv::randu(E, cv::Scalar(0, 0, 0), cv::Scalar(1, 1, 1));
+  cv::Mat L, L_log;
+  vr.remove(E, L);
+  vr.removeLog(E, L_log);
+  std::vector<cv::Point> points = {{0, 0}, {79, 59}, {13, 27}, {40, 30}, {79, 0}};
+  std::vector<cv::Vec3f> samples, radiance(points.size()), log_radiance(points.size());
+  for (const auto& p : points)
+    samples.push_back(E.at<cv::Vec3f>(p));
+  vr.remove(E.size(), points.data(), samples.data(), radiance.data(), points.size());
+  vr.removeLog(E.size(), points.data(), samples.data(), log_radiance.data(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    BOOST_CHECK_EQUAL(radiance[i], L.at<cv::Vec3f>(points[i]));
+    BOOST_CHECK_EQUAL(log_radiance[i], L_log.at<cv::Vec3f>(points[i]));
+  }
+  // In-place
+  vr.remove(E.size(), points.data(), samples.data(), samples.data(), points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    BOOST_CHECK_EQUAL(samples[i], radiance[i]);
+}
+
+BOOST_AUTO_TEST_CASE(RemoveReciprocal) {
+  setRNGSeed(3);
+  cv::Mat m(30, 40, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.2, 0.2, 0.2), cv::Scalar(1, 1, 1));
+  auto f = getTemporaryFilename();
+  NonparametricVignettingModel(m).save(f);
+  VignettingResponse vr(f);
+  auto reciprocal = vr.getReciprocalResponse({40, 30});
+  BOOST_CHECK_EQUAL(reciprocal.type(), CV_32FC3);
+  BOOST_CHECK_EQUAL(reciprocal.size(), cv::Size(40, 30));
+  // Removal multiplies by the reciprocal, this differs from division by at most a couple of ulps
+  cv::Mat E(30, 40, CV_32FC3);
+  cv::randu(E, cv::Scalar(0, 0, 0), cv::Scalar(1, 1, 1));
+  cv::Mat L, L_expected;
+  vr.remove(E, L);
+  cv::divide(E, vr.getResponse({40, 30}), L_expected);
+  BOOST_CHECK_LE(cv::norm(L, L_expected, cv::NORM_INF), 1e-6 * cv::norm(L_expected, cv::NORM_INF));
+}
+
+BOOST_AUTO_TEST_CASE(EvaluationOnTheFly) {
+  VignettingResponse vr_nonparametric(getTestFilename("nonparametric_vignetting_model_identity.vgn"));
+  BOOST_CHECK(vr_nonparametric.getEvaluation() == VignettingResponse::Evaluation::Precomputed);
+  BOOST_CHECK_THROW(vr_nonparametric.setEvaluation(VignettingResponse::Evaluation::OnTheFly), Exception);
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(320, 310, 330);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(240, 250, 235);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-1e-6, -1.2e-6, -0.8e-6);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-12, -0.5e-12, -2e-12);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(1e-19, 2e-19, 0);
+  auto f = getTemporaryFilename();
+  PolynomialVignettingModel<3>(m, cv::Size(640, 480)).save(f);
+  VignettingResponse vr(f);
+  VignettingResponse vr_reference(f);
+  vr.setEvaluation(VignettingResponse::Evaluation::OnTheFly);
+  BOOST_CHECK(vr.getEvaluation() == VignettingResponse::Evaluation::OnTheFly);
+  for (const auto& size : {cv::Size(640, 480), cv::Size(320, 240)}) {
+    cv::Mat E(size, CV_32FC3);
+    cv::randu(E, cv::Scalar(0, 0, 0), cv::Scalar(1, 1, 1));
+    cv::Mat L, L_expected, E_back, E_expected;
+    vr.remove(E, L);
+    vr_reference.remove(E, L_expected);
+    BOOST_CHECK_LE(cv::norm(L, L_expected, cv::NORM_INF), 1e-5);
+    vr.add(L, E_back);
+    vr_reference.add(L, E_expected);
+    BOOST_CHECK_LE(cv::norm(E_back, E_expected, cv::NORM_INF), 1e-5);
+    std::vector<cv::Point> points = {{0, 0}, {size.width - 1, size.height - 1}, {10, 20}};
+    std::vector<cv::Vec3f> samples, radiance(points.size());
+    for (const auto& p : points)
+      samples.push_back(E.at<cv::Vec3f>(p));
+    vr.remove(size, points.data(), samples.data(), radiance.data(), points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+      for (int c = 0; c < 3; ++c)
+        BOOST_CHECK_SMALL(radiance[i][c] - L_expected.at<cv::Vec3f>(points[i])[c], 1e-5f);
+  }
+  // No full-frame maps are stored
+  BOOST_CHECK(vr.getCacheStats().sizes.empty());
+  // Aspect ratio is still checked
+  cv::Mat E(100, 100, CV_32FC3), L;
+  BOOST_CHECK_THROW(vr.remove(E, L), Exception);
+}
+
+BOOST_AUTO_TEST_CASE(SensorWindows) {
+  cv::Mat m(5, 1, CV_64FC3);
+  m.at<cv::Vec3d>(0) = cv::Vec3d(320, 310, 330);
+  m.at<cv::Vec3d>(1) = cv::Vec3d(240, 250, 235);
+  m.at<cv::Vec3d>(2) = cv::Vec3d(-1e-6, -1.2e-6, -0.8e-6);
+  m.at<cv::Vec3d>(3) = cv::Vec3d(-1e-12, -0.5e-12, -2e-12);
+  m.at<cv::Vec3d>(4) = cv::Vec3d(1e-19, 2e-19, 0);
+  auto f = getTemporaryFilename();
+  PolynomialVignettingModel<3>(m, cv::Size(640, 480)).save(f);
+  VignettingResponse vr(f);
+  auto full = vr.getResponse();
+  // Window without binning is a crop of the full response, its aspect ratio does not matter
+  cv::Rect roi(100, 50, 300, 100);
+  auto response = vr.getResponse(SensorWindow(roi));
+  BOOST_CHECK_EQUAL(response.size(), roi.size());
+  BOOST_CHECK_LE(cv::norm(response, full(roi), cv::NORM_INF), 1e-5);
+  // Binned window samples every other pixel of the full response
+  SensorWindow binned(roi, 2);
+  BOOST_CHECK_EQUAL(binned.getImageSize(), cv::Size(150, 50));
+  response = vr.getResponse(binned);
+  BOOST_CHECK_EQUAL(response.size(), binned.getImageSize());
+  for (const auto& p : {cv::Point(0, 0), cv::Point(149, 49), cv::Point(70, 20)}) {
+    auto expected = full.at<cv::Vec3f>(roi.y + 2 * p.y, roi.x + 2 * p.x);
+    for (int c = 0; c < 3; ++c)
+      BOOST_CHECK_SMALL(response.at<cv::Vec3f>(p)[c] - expected[c], 1e-5f);
+  }
+  // Full sensor binned by two shares the cache entry with the half-size frame
+  auto misses = vr.getCacheStats().misses;
+  vr.getResponse({320, 240});
+  vr.getResponse(SensorWindow(cv::Rect(0, 0, 640, 480), 2));
+  BOOST_CHECK_EQUAL(vr.getCacheStats().misses, misses + 1);
+  // Removal and addition in windows
+  cv::Mat E(binned.getImageSize(), CV_32FC3);
+  cv::randu(E, cv::Scalar(0.1, 0.1, 0.1), cv::Scalar(1, 1, 1));
+  cv::Mat L, L_expected, E_back, logE, logL, logL_expected;
+  vr.remove(E, L, binned);
+  cv::divide(E, response, L_expected);
+  BOOST_CHECK_LE(cv::norm(L, L_expected, cv::NORM_INF), 1e-5);
+  vr.add(L, E_back, binned);
+  BOOST_CHECK_LE(cv::norm(E_back, E, cv::NORM_INF), 1e-5);
+  cv::log(E, logE);
+  vr.removeLog(logE, logL, binned);
+  cv::log(L_expected, logL_expected);
+  BOOST_CHECK_LE(cv::norm(logL, logL_expected, cv::NORM_INF), 1e-5);
+  vr.addLog(logL, E_back, binned);
+  BOOST_CHECK_LE(cv::norm(E_back, logE, cv::NORM_INF), 1e-5);
+  // Evaluation on the fly gives the same result
+  VignettingResponse vr_on_the_fly(f);
+  vr_on_the_fly.setEvaluation(VignettingResponse::Evaluation::OnTheFly);
+  vr_on_the_fly.remove(E, L, binned);
+  BOOST_CHECK_LE(cv::norm(L, L_expected, cv::NORM_INF), 1e-5);
+  BOOST_CHECK(vr_on_the_fly.getCacheStats().sizes.empty());
+  // Invalid windows
+  BOOST_CHECK_THROW(vr.getResponse(SensorWindow(cv::Rect(1, 0, 100, 100), 2)), Exception);
+  BOOST_CHECK_THROW(vr.getResponse(SensorWindow(cv::Rect(600, 0, 100, 100))), Exception);
+  BOOST_CHECK_THROW(vr.getResponse(SensorWindow(cv::Rect(0, 0, 100, 100), 0)), Exception);
+  BOOST_CHECK_THROW(vr.getResponse(SensorWindow(cv::Rect(0, 0, 1, 1), 2)), Exception);
+  BOOST_CHECK_THROW(vr.remove(E, L, SensorWindow(roi)), Exception);
+}
+
+BOOST_AUTO_TEST_CASE(Cache) {
+  // A CV_32FC3 response of size NxN takes N * N * 12 bytes
+  VignettingResponse vr(getTestFilename("nonparametric_vignetting_model_identity.vgn"), 8000);
+  auto stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.budget, 8000);
+  BOOST_CHECK_EQUAL(stats.footprint, 0);
+  BOOST_CHECK(stats.sizes.empty());
+  vr.getResponse({20, 20});
+  vr.getResponse({20, 20});
+  vr.getResponse({10, 10});
+  stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.footprint, 4800 + 1200);
+  BOOST_CHECK_EQUAL(stats.hits, 1);
+  BOOST_CHECK_EQUAL(stats.misses, 2);
+  BOOST_CHECK_EQUAL(stats.sizes.size(), 2);
+  // Use 20x20 so that 10x10 becomes the least recently used one and is evicted
+  vr.getResponse({20, 20});
+  vr.getResponse({15, 15});
+  stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.footprint, 4800 + 2700);
+  BOOST_CHECK_EQUAL(stats.hits, 2);
+  BOOST_CHECK_EQUAL(stats.misses, 3);
+  BOOST_CHECK_EQUAL(stats.evictions, 1);
+  BOOST_CHECK_EQUAL(stats.sizes.size(), 2);
+  BOOST_CHECK(std::count(stats.sizes.begin(), stats.sizes.end(), cv::Size(10, 10)) == 0);
+  // Log responses count towards the budget as well
+  vr.getLogResponse({15, 15});
+  stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.footprint, 2700 * 2);
+  BOOST_CHECK_EQUAL(stats.evictions, 2);
+  // Shrinking the budget evicts immediately
+  vr.setCacheBudget(3000);
+  stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.footprint, 0);
+  BOOST_CHECK(stats.sizes.empty());
+  // Response that exceeds the budget on its own is still cached
+  cv::Mat response_expected(40, 40, CV_32FC3);
+  response_expected.setTo(1.0);
+  BOOST_CHECK_EQUAL_MAT(vr.getResponse({40, 40}), response_expected, cv::Vec3f);
+  stats = vr.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.footprint, 19200);
+  BOOST_CHECK_EQUAL(stats.sizes.size(), 1);
+  // Evicted responses are computed again
+  cv::Mat response = vr.getResponse({20, 20});
+  BOOST_CHECK_EQUAL(response.size(), cv::Size(20, 20));
+  BOOST_CHECK_EQUAL(vr.getCacheStats().misses, 6);
+  // Response that a reciprocal response is derived from is not retained unless requested
+  VignettingResponse vr2(getTestFilename("nonparametric_vignetting_model_identity.vgn"), 8000);
+  vr2.getReciprocalResponse({20, 20});
+  BOOST_CHECK_EQUAL(vr2.getCacheStats().footprint, 4800);
+  vr2.getResponse({20, 20});
+  BOOST_CHECK_EQUAL(vr2.getCacheStats().footprint, 4800 * 2);
+}
+
+BOOST_AUTO_TEST_CASE(CacheDirectory) {
+  namespace fs = boost::filesystem;
+  setRNGSeed(3);
+  cv::Mat m1(12, 16, CV_32FC3), m2(12, 16, CV_32FC3);
+  cv::randu(m1, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  cv::randu(m2, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  auto model1 = std::make_shared<NonparametricVignettingModel>(m1);
+  auto model2 = std::make_shared<NonparametricVignettingModel>(m2);
+  auto directory = getTemporaryFilename();
+  fs::create_directories(directory);
+  const cv::Size size(32, 24);
+
+  VignettingResponse vr1(model1);
+  BOOST_CHECK_EQUAL(vr1.getCacheDirectory(), "");
+  vr1.setCacheDirectory(directory);
+  BOOST_CHECK_EQUAL(vr1.getCacheDirectory(), directory);
+  cv::Mat response = vr1.getResponse(size);
+  cv::Mat log_response = vr1.getLogResponse(size);
+  BOOST_CHECK_EQUAL(vr1.getCacheStats().disk_hits, 0);
+  // Response and log response are stored, no temporary files are left behind
+  BOOST_CHECK_EQUAL(std::distance(fs::directory_iterator(directory), fs::directory_iterator()), 2);
+
+  // Another instance with the same model picks up stored maps
+  VignettingResponse vr2(model1);
+  vr2.setCacheDirectory(directory);
+  BOOST_CHECK_EQUAL_MAT(vr2.getLogResponse(size), log_response, cv::Vec3f);
+  BOOST_CHECK_EQUAL_MAT(vr2.getResponse(size), response, cv::Vec3f);
+  auto stats = vr2.getCacheStats();
+  BOOST_CHECK_EQUAL(stats.misses, 2);
+  BOOST_CHECK_EQUAL(stats.disk_hits, 2);
+
+  // Different model does not use maps of the first one
+  VignettingResponse vr3(model2);
+  vr3.setCacheDirectory(directory);
+  VignettingResponse vr3_reference(model2);
+  BOOST_CHECK_EQUAL_MAT(vr3.getResponse(size), vr3_reference.getResponse(size), cv::Vec3f);
+  BOOST_CHECK_EQUAL(vr3.getCacheStats().disk_hits, 0);
+
+  // Truncated files are ignored and replaced
+  for (fs::directory_iterator file(directory); file != fs::directory_iterator(); ++file)
+    fs::resize_file(file->path(), 100);
+  VignettingResponse vr4(model1);
+  vr4.setCacheDirectory(directory);
+  BOOST_CHECK_EQUAL_MAT(vr4.getResponse(size), response, cv::Vec3f);
+  BOOST_CHECK_EQUAL(vr4.getCacheStats().disk_hits, 0);
+  VignettingResponse vr5(model1);
+  vr5.setCacheDirectory(directory);
+  BOOST_CHECK_EQUAL_MAT(vr5.getResponse(size), response, cv::Vec3f);
+  BOOST_CHECK_EQUAL(vr5.getCacheStats().disk_hits, 1);
+  fs::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentAccess) {
+  // Many threads request responses for overlapping sets of image sizes, so that cache misses race with each other and
+  // with lookups of already cached sizes. Build with WITH_TSAN to have data races reported.
+  setRNGSeed(2);
+  cv::Mat m(12, 16, CV_32FC3);
+  cv::randu(m, cv::Scalar(0.5, 0.5, 0.5), cv::Scalar(1, 1, 1));
+  auto f = getTemporaryFilename();
+  NonparametricVignettingModel(m).save(f);
+  // Small cache budget, so that responses are also evicted concurrently with lookups
+  VignettingResponse vr(f, 200000);
+  VignettingResponse vr_reference(f);
+  const std::vector<cv::Size> sizes = {{16, 12}, {32, 24}, {8, 6}, {64, 48}, {4, 3}, {80, 60}, {160, 120}, {24, 18}};
+  const int num_threads = 8;
+  std::atomic<int> mismatches(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t)
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i) {
+        const auto& size = sizes[(t + i) % sizes.size()];
+        cv::Mat E(size, CV_32FC3, cv::Scalar(1, 1, 1));
+        cv::Mat L, L_log;
+        vr.remove(E, L);
+        vr.removeLog(E, L_log);
+        if (L.size() != size || L_log.size() != size || vr.getResponse(size).size() != size)
+          ++mismatches;
+      }
+    });
+  for (auto& thread : threads)
+    thread.join();
+  BOOST_CHECK_EQUAL(mismatches.load(), 0);
+  for (const auto& size : sizes) {
+    BOOST_CHECK_EQUAL_MAT(vr.getResponse(size), vr_reference.getResponse(size), cv::Vec3f);
+    BOOST_CHECK_EQUAL_MAT(vr.getLogResponse(size), vr_reference.getLogResponse(size), cv::Vec3f);
+  }
+}